@@ -0,0 +1,339 @@
+/**
+ * @file
+ * @brief AST cache benchmark, cold parse vs warm cache load
+ *
+ * Usage: ./ast_cache_bench [file.c ...]
+ *
+ * Without arguments a synthetic translation unit is generated. Each round
+ * either lexes and parses every input into a fresh intern table (cold) or
+ * loads every input back from a cache directory filled by one cold pass
+ * (warm), the way --ast-cache does. The loaded ASTs are checked against
+ * the parsed ones, names included, before anything is timed, and so is
+ * that a damaged entry misses and is replaced by a reparse.
+ */
+
+#define MEMARENA_IMPLEMENTATION
+#include "memarena.h"
+#include "ast_cache.h"
+#include "parser.h"
+#include "file_map.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_ROUNDS		10
+#define CORPUS_FUNCTIONS	250
+#define CORPUS_STATEMENTS	300
+
+typedef struct {
+	FileMap			*files;
+	size_t			count;
+	size_t			bytes;
+	const char		*dir;
+	Ast				*asts;
+	AstCacheMap		*maps;
+	InternTable		interns;
+} BenchInput;
+
+static double	now_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+static FileMap	make_corpus(Arena *a)
+{
+	size_t	capacity = (size_t)CORPUS_FUNCTIONS * (CORPUS_STATEMENTS + 8) * 96;
+	char	*buf = arena_alloc(a, capacity);
+	size_t	len = 0;
+
+	for (int f = 0; f < CORPUS_FUNCTIONS; ++f)
+	{
+		len += snprintf(buf + len, capacity - len,
+				"int generated_function_%03d(int first_value, int second_value) {\n"
+				"\tint accumulated = first_value;\n", f);
+		for (int s = 0; s < CORPUS_STATEMENTS; ++s)
+			len += snprintf(buf + len, capacity - len,
+					"\taccumulated = accumulated + (second_value << %d) - %d * first_value;\n",
+					s % 7, s);
+		len += snprintf(buf + len, capacity - len,
+				"\twhile (accumulated > 1000) { accumulated = accumulated / 2; }\n"
+				"\treturn accumulated;\n}\n\n");
+	}
+	return ((FileMap){ .data = buf, .length = len, .name = "<corpus>" });
+}
+
+static size_t	load_files(Arena *a, int argc, char **argv, FileMap **files)
+{
+	*files = arena_alloc(a, (size_t)argc * sizeof(FileMap));
+	for (int i = 1; i < argc; ++i)
+	{
+		int fd = open(argv[i], O_RDONLY);
+		(*files)[i - 1] = (fd == -1) ? (FileMap){0} : map_input(fd);
+		if (!(*files)[i - 1].data)
+		{
+			fprintf(stderr, "ast_cache_bench: cannot map %s\n", argv[i]);
+			exit(1);
+		}
+		(*files)[i - 1].name = argv[i];
+	}
+	return ((size_t)argc - 1);
+}
+
+/* Lexes and parses every input into in->asts */
+static bool	parse_all(Arena *a, BenchInput *in)
+{
+	intern_init(&in->interns, a);
+	for (size_t i = 0; i < in->count; ++i)
+	{
+		ErrorContext	errors;
+		Lexer			lexer;
+
+		error_context_init(&errors, a);
+		if (!ast_init(&in->asts[i], a, &in->interns, in->files[i].length))
+			return (false);
+		lexer_init(&lexer, &in->files[i], &in->interns, &errors);
+		if (parser_parse(&lexer, &in->asts[i], &errors) == NODE_NONE || errors.head)
+		{
+			fprintf(stderr, "ast_cache_bench: %s does not parse cleanly\n",
+					in->files[i].name);
+			return (false);
+		}
+	}
+	return (true);
+}
+
+/* Loads every input from the cache into in->asts */
+static bool	load_all(Arena *a, BenchInput *in)
+{
+	intern_init(&in->interns, a);
+	for (size_t i = 0; i < in->count; ++i)
+	{
+		if (!ast_cache_load(in->dir, &in->files[i], &in->interns, a,
+					&in->asts[i], &in->maps[i]))
+			return (false);
+	}
+	return (true);
+}
+
+static void	release_all(BenchInput *in)
+{
+	for (size_t i = 0; i < in->count; ++i)
+		ast_cache_release(&in->maps[i]);
+}
+
+static bool	same_node(const ASTNode *x, const ASTNode *y)
+{
+	return (x->type == y->type && x->value_type == y->value_type
+		&& x->flags == y->flags && x->offset == y->offset
+		&& x->lhs == y->lhs && x->rhs == y->rhs);
+}
+
+static bool	same_ast(const Ast *x, const Ast *y)
+{
+	if (x->node_count != y->node_count || x->extra_count != y->extra_count
+			|| x->param_count != y->param_count || x->root != y->root
+			|| x->interns->count != y->interns->count)
+		return (false);
+	for (NodeId id = 0; id < x->node_count; ++id)
+	{
+		if (!same_node(&x->nodes[id], &y->nodes[id]))
+			return (false);
+	}
+	for (uint32_t i = 0; i < x->param_count; ++i)
+	{
+		if (x->params[i].atom != y->params[i].atom
+				|| x->params[i].type != y->params[i].type)
+			return (false);
+	}
+	for (Atom atom = 1; atom < x->interns->count; ++atom)
+	{
+		if (!sv_eq(atom_sv(x->interns, atom), atom_sv(y->interns, atom)))
+			return (false);
+	}
+	return (memcmp(x->extra, y->extra, x->extra_count * sizeof(uint32_t)) == 0);
+}
+
+/* Parses once, fills the cache and checks it loads back identically */
+static bool	prepare_cache(Arena *a, BenchInput *in, Ast *parsed)
+{
+	InternTable	parsed_interns;
+
+	if (!parse_all(a, in))
+		return (false);
+	for (size_t i = 0; i < in->count; ++i)
+	{
+		if (!ast_cache_store(in->dir, &in->files[i], &in->asts[i], a))
+		{
+			perror("ast_cache_bench: cannot write cache entry");
+			return (false);
+		}
+	}
+	parsed_interns = in->interns;
+	memcpy(parsed, in->asts, in->count * sizeof(Ast));
+	for (size_t i = 0; i < in->count; ++i)
+		parsed[i].interns = &parsed_interns;
+	bool ok = load_all(a, in);
+	for (size_t i = 0; ok && i < in->count; ++i)
+		ok = same_ast(&parsed[i], &in->asts[i]);
+	release_all(in);
+	if (!ok)
+		fprintf(stderr, "ast_cache_bench: cached and parsed ASTs differ\n");
+	return (ok);
+}
+
+/* Flips the last byte of every entry, in the spelling of a name */
+static bool	corrupt_cache(const char *dir)
+{
+	char			path[PATH_MAX];
+	DIR				*d = opendir(dir);
+	struct dirent	*entry;
+	bool			ok = (d != NULL);
+
+	while (ok && (entry = readdir(d)))
+	{
+		uint8_t	byte;
+		off_t	last;
+
+		if (entry->d_name[0] == '.')
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+		int fd = open(path, O_RDWR);
+		ok = fd != -1 && (last = lseek(fd, -1, SEEK_END)) > 0
+			&& pread(fd, &byte, 1, last) == 1;
+		byte ^= 0x20;
+		ok = ok && pwrite(fd, &byte, 1, last) == 1;
+		if (fd != -1)
+			close(fd);
+	}
+	if (d)
+		closedir(d);
+	return (ok);
+}
+
+/*
+ * Damages every entry where no bounds check looks, so that only the
+ * checksum can tell. Each must miss, and a reparse must fill the cache
+ * again as at first.
+ */
+static bool	check_corruption(Arena *a, BenchInput *in, Ast *parsed)
+{
+	bool	missed = true;
+
+	if (!corrupt_cache(in->dir))
+	{
+		perror("ast_cache_bench: cannot damage cache entries");
+		return (false);
+	}
+	intern_init(&in->interns, a);
+	for (size_t i = 0; i < in->count; ++i)
+	{
+		if (ast_cache_load(in->dir, &in->files[i], &in->interns, a,
+					&in->asts[i], &in->maps[i]))
+			missed = false;
+	}
+	release_all(in);
+	if (!missed)
+	{
+		fprintf(stderr, "ast_cache_bench: a damaged entry was loaded\n");
+		return (false);
+	}
+	return (prepare_cache(a, in, parsed));
+}
+
+static double	bench_pass(Arena *a, BenchInput *in, bool warm)
+{
+	double best = 1e30;
+
+	for (int i = 0; i < BENCH_ROUNDS; ++i)
+	{
+		ArenaTemp	temp = arena_temp_begin(a);
+		double		start = now_seconds();
+		bool		ok = warm ? load_all(a, in) : parse_all(a, in);
+		double		elapsed = now_seconds() - start;
+
+		if (warm)
+			release_all(in);
+		arena_temp_end(temp);
+		if (!ok)
+			return (-1.0);
+		if (elapsed < best)
+			best = elapsed;
+	}
+	return (best);
+}
+
+static void	remove_cache(const char *dir)
+{
+	char			path[PATH_MAX];
+	DIR				*d = opendir(dir);
+	struct dirent	*entry;
+
+	while (d && (entry = readdir(d)))
+	{
+		if (entry->d_name[0] == '.' && (entry->d_name[1] == '\0'
+				|| (entry->d_name[1] == '.' && entry->d_name[2] == '\0')))
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+		unlink(path);
+	}
+	if (d)
+		closedir(d);
+	rmdir(dir);
+}
+
+int	main(int argc, char **argv)
+{
+	Arena		arena = arena_init(PROT_READ | PROT_WRITE);
+	char		dir[] = "/tmp/ast_cache_bench.XXXXXX";
+	BenchInput	in = { .dir = mkdtemp(dir) };
+	int			status = 1;
+
+	if (!in.dir)
+	{
+		perror("ast_cache_bench: cannot create cache directory");
+		return (1);
+	}
+	if (argc > 1)
+		in.count = load_files(&arena, argc, argv, &in.files);
+	else
+	{
+		in.files = arena_alloc(&arena, sizeof(FileMap));
+		in.files[0] = make_corpus(&arena);
+		in.count = 1;
+	}
+	for (size_t i = 0; i < in.count; ++i)
+		in.bytes += in.files[i].length;
+	in.asts = arena_alloc(&arena, in.count * sizeof(Ast));
+	in.maps = arena_alloc_zeroed(&arena, in.count * sizeof(AstCacheMap));
+	Ast *parsed = arena_alloc(&arena, in.count * sizeof(Ast));
+
+	printf("ast_cache_bench: %zu file(s), %.2f MB, best of %d rounds\n",
+			in.count, in.bytes / (1024.0 * 1024.0), BENCH_ROUNDS);
+	if (prepare_cache(&arena, &in, parsed) && check_corruption(&arena, &in, parsed))
+	{
+		double cold = bench_pass(&arena, &in, false);
+		double warm = bench_pass(&arena, &in, true);
+		if (cold >= 0 && warm >= 0)
+		{
+			size_t nodes = 0;
+			for (size_t i = 0; i < in.count; ++i)
+				nodes += parsed[i].node_count;
+			printf("  cold parse : %9.2f ms (%zu nodes)\n", cold * 1e3, nodes);
+			printf("  warm load  : %9.2f ms\n", warm * 1e3);
+			printf("  speedup    : %9.2fx\n", cold / warm);
+			status = 0;
+		}
+		else
+			fprintf(stderr, "ast_cache_bench: a timed pass failed\n");
+	}
+	remove_cache(in.dir);
+	arena_free(&arena);
+	return (status);
+}
@@ -0,0 +1,217 @@
+/**
+ * @file
+ * @brief Lexer throughput benchmark, scalar vs SIMD scanning
+ *
+ * Usage: ./lexer_bench [file.c ...]
+ *
+ * Without arguments a synthetic corpus is generated (long identifiers,
+ * indentation runs, line and block comments). Both scan paths lex the same
+ * buffer; the token streams are checked to be identical before timing.
+ * lexer_tokenize_parallel is then timed against a one-job pass, and its
+ * token stream checked against it the same way.
+ */
+
+#define MEMARENA_IMPLEMENTATION
+#include "memarena.h"
+#include "lexer.h"
+#include "file_map.h"
+#include "parallel.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define CORPUS_SIZE		(8 * 1024 * 1024)
+#define BENCH_ROUNDS	10
+
+typedef struct {
+	size_t		tokens;
+	uint64_t	checksum;
+} LexStats;
+
+static double	now_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+static const char	*corpus_chunk =
+	"/* generated translation unit chunk\n"
+	" * with a multi-line block comment */\n"
+	"int generated_function_with_a_long_name_0001(int first_parameter_value, int second_parameter_value) {\n"
+	"        // accumulate both parameters into a local variable\n"
+	"        int accumulated_intermediate_result = first_parameter_value + second_parameter_value;\n"
+	"        while (accumulated_intermediate_result > 1234567890) {\n"
+	"                accumulated_intermediate_result = accumulated_intermediate_result - 987654321;\n"
+	"        }\n"
+	"        return accumulated_intermediate_result;\n"
+	"}\n\n";
+
+static FileMap	make_corpus(Arena *a)
+{
+	size_t	chunk_len = strlen(corpus_chunk);
+	size_t	count = CORPUS_SIZE / chunk_len;
+	char	*buf = arena_alloc(a, count * chunk_len);
+
+	for (size_t i = 0; i < count; ++i)
+		memcpy(buf + i * chunk_len, corpus_chunk, chunk_len);
+	return ((FileMap){ .data = buf, .length = count * chunk_len, .name = "<corpus>" });
+}
+
+static FileMap	load_files(Arena *a, int argc, char **argv)
+{
+	size_t	total = 0;
+	FileMap	maps[argc];
+
+	for (int i = 1; i < argc; ++i)
+	{
+		int fd = open(argv[i], O_RDONLY);
+		maps[i] = (fd == -1) ? (FileMap){0} : map_input(fd);
+		if (!maps[i].data)
+		{
+			fprintf(stderr, "lexer_bench: cannot map %s\n", argv[i]);
+			exit(1);
+		}
+		total += maps[i].length + 1;
+	}
+	char *buf = arena_alloc(a, total);
+	size_t off = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		memcpy(buf + off, maps[i].data, maps[i].length);
+		off += maps[i].length;
+		buf[off++] = '\n';
+		munmap((void *)maps[i].data, maps[i].length);
+	}
+	return ((FileMap){ .data = buf, .length = total, .name = "<files>" });
+}
+
+static LexStats	lex_all(Arena *a, FileMap *file, bool use_simd)
+{
+	LexStats	stats = {0, 1469598103934665603ull};
+	Lexer		lexer;
+	InternTable	interns;
+	ArenaTemp	temp = arena_temp_begin(a);
+
+	intern_init(&interns, a);
+	lexer_init(&lexer, file, &interns, NULL);
+	lexer.use_simd = use_simd;
+	while (true)
+	{
+		Token t = lexer_next(&lexer);
+		stats.checksum = (stats.checksum ^ (uint64_t)t.type) * 1099511628211ull;
+		stats.checksum = (stats.checksum ^ (uint64_t)t.offset) * 1099511628211ull;
+		stats.checksum = (stats.checksum ^ (uint64_t)t.atom) * 1099511628211ull;
+		stats.tokens++;
+		if (t.type == TOKEN_EOF)
+			break;
+	}
+	arena_temp_end(temp);
+	return (stats);
+}
+
+static double	bench_path(Arena *a, FileMap *file, bool use_simd, LexStats *out)
+{
+	double best = 1e30;
+
+	for (int i = 0; i < BENCH_ROUNDS; ++i)
+	{
+		double start = now_seconds();
+		*out = lex_all(a, file, use_simd);
+		double elapsed = now_seconds() - start;
+		if (elapsed < best)
+			best = elapsed;
+	}
+	return ((double)file->length / (1024.0 * 1024.0) / best);
+}
+
+static LexStats	stream_stats(const TokenStream *ts)
+{
+	LexStats stats = {ts->count, 1469598103934665603ull};
+
+	for (size_t i = 0; i < ts->count; ++i)
+	{
+		stats.checksum = (stats.checksum ^ (uint64_t)ts->types[i]) * 1099511628211ull;
+		stats.checksum = (stats.checksum ^ (uint64_t)ts->offsets[i]) * 1099511628211ull;
+		stats.checksum = (stats.checksum ^ (uint64_t)ts->payloads[i]) * 1099511628211ull;
+	}
+	return (stats);
+}
+
+static double	bench_tokenize(Arena *a, FileMap *file, size_t jobs, LexStats *out)
+{
+	double best = 1e30;
+
+	for (int i = 0; i < BENCH_ROUNDS; ++i)
+	{
+		ArenaTemp	temp = arena_temp_begin(a);
+		InternTable	interns;
+		TokenStream	ts;
+
+		intern_init(&interns, a);
+		double start = now_seconds();
+		lexer_tokenize_parallel(file, &interns, NULL, a, jobs, &ts);
+		double elapsed = now_seconds() - start;
+		*out = stream_stats(&ts);
+		arena_temp_end(temp);
+		if (elapsed < best)
+			best = elapsed;
+	}
+	return ((double)file->length / (1024.0 * 1024.0) / best);
+}
+
+static int	bench_parallel(Arena *a, FileMap *file)
+{
+	size_t		jobs = parallel_default_jobs();
+	LexStats	one;
+	LexStats	many;
+
+	double one_mbs = bench_tokenize(a, file, 1, &one);
+	printf("  1 job  : %9.1f MB/s (%zu tokens)\n", one_mbs, one.tokens);
+	double many_mbs = bench_tokenize(a, file, jobs, &many);
+	char label[16];
+	snprintf(label, sizeof(label), "%zu jobs", jobs);
+	printf("  %-7s: %9.1f MB/s (%zu tokens)\n", label, many_mbs, many.tokens);
+	printf("  speedup: %9.2fx\n", many_mbs / one_mbs);
+	if (one.tokens != many.tokens || one.checksum != many.checksum)
+	{
+		fprintf(stderr, "lexer_bench: parallel and sequential token streams differ\n");
+		return (1);
+	}
+	return (0);
+}
+
+int	main(int argc, char **argv)
+{
+	Arena	arena = arena_init(PROT_READ | PROT_WRITE);
+	FileMap	file = (argc > 1) ? load_files(&arena, argc, argv) : make_corpus(&arena);
+	LexStats	scalar;
+	LexStats	simd;
+
+	printf("lexer_bench: %s, %.2f MB, best of %d rounds\n",
+			file.name, file.length / (1024.0 * 1024.0), BENCH_ROUNDS);
+	double scalar_mbs = bench_path(&arena, &file, false, &scalar);
+	printf("  scalar : %9.1f MB/s (%zu tokens)\n", scalar_mbs, scalar.tokens);
+
+	Lexer probe;
+	lexer_init(&probe, &file, NULL, NULL);
+	int status = 0;
+	if (!probe.use_simd)
+		printf("  simd   : not available on this target\n");
+	else
+	{
+		double simd_mbs = bench_path(&arena, &file, true, &simd);
+		printf("  simd   : %9.1f MB/s (%zu tokens)\n", simd_mbs, simd.tokens);
+		printf("  speedup: %9.2fx\n", simd_mbs / scalar_mbs);
+		if (scalar.tokens != simd.tokens || scalar.checksum != simd.checksum)
+		{
+			fprintf(stderr, "lexer_bench: scalar and simd token streams differ\n");
+			status = 1;
+		}
+	}
+	if (bench_parallel(&arena, &file) != 0)
+		status = 1;
+	arena_free(&arena);
+	return (status);
+}
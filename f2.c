@@ -0,0 +1,6 @@
+int main() {
+	uint32 z = 0u;
+	uint32 o = 1u;
+	int a = (z - o) >> 28;
+	return a;
+}
@@ -0,0 +1,7 @@
+int main() {
+	int a = 7 / -2;
+	int b = -7 >> 1;
+	int c = 1 << 31;
+	int64 d = 1 << 31;
+	return a + b;
+}
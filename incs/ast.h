@@ -2,8 +2,11 @@
 # define AST_H 
 
 # include "string_view.h"
+# include "intern.h"
+# include "memarena.h"
 # include <stdbool.h>
 # include <stddef.h>
+# include <stdint.h>
 
 typedef enum {
 	AST_NUMBER,
@@ -24,6 +27,9 @@ typedef enum {
 	AST_GREATER,
 	AST_GREATER_EQUAL,
 
+	AST_LOGICAL_AND,	// a && b, b only evaluated if a is non-zero
+	AST_LOGICAL_OR,		// a || b, b only evaluated if a is zero
+
 	AST_BIT_AND,
 	AST_BIT_OR,
 	AST_BIT_XOR,
@@ -143,93 +149,164 @@ DataType	type_from_sv(StringView sv);
 bool		is_type_keyword(StringView sv);
 
 typedef struct {
-	StringView name;
-	DataType type;
+	Atom		atom;
+	DataType	type;
 } Parameter;
 
-typedef struct ASTNode ASTNode;
+/* Index of a node in Ast.nodes. Node 0 is reserved, so 0 means "no node". */
+typedef uint32_t	NodeId;
+
+# define NODE_NONE	0
+
+// ASTNode.flags
+# define AST_FLAG_PROTOTYPE	0x01	// AST_FUNCTION without a body
+# define AST_FLAG_LAZY		0x02	// AST_BLOCK whose statements are not parsed yet
+
+/*
+*	Every node is 16 bytes: a kind, the type semantic analysis gives it and
+*	two 32-bit operands. Children are NodeIds, names are atoms. Lists and
+*	anything that does not fit in two words live in Ast.extra, and lhs/rhs
+*	then hold an index into it:
+*
+*	  kind              lhs                rhs
+*	  AST_NUMBER        low 32 bits        high 32 bits    (value_type: set by the parser)
+*	  AST_IDENTIFIER    atom               variable        (rhs: set by semantic analysis)
+*	  binary ops        left               right
+*	  unary ops         operand            -
+*	  AST_VAR_DECL      identifier         initializer     (value_type: declared)
+*	  AST_ASSIGNMENT    identifier         value
+*	  AST_IF            condition          extra: then, else
+*	  AST_WHILE         condition          body
+*	  AST_RETURN        expression         -
+*	  AST_BLOCK         extra: statements  count
+*	  AST_BLOCK (lazy)  end of the body    0               (offset: its '{')
+*	  AST_CALL          atom               extra: count, args...
+*	  AST_FUNCTION      atom               extra: body, first param, count,
+*	                                       offset of the return type
+*	  AST_TRANSLATION_UNIT  extra: declarations  count
+*
+*	Semantic analysis numbers the variables of each function, parameters
+*	first and then locals in declaration order, and stores the number of
+*	the one an identifier names in its rhs. Declarations and assignments
+*	name theirs through an identifier child, which a compound assignment
+*	shares with its operator.
+*
+*	A lazy body is parsed on demand by parser_parse_body, which appends the
+*	block after the rest of the AST and points the function at it.
+*/
+typedef struct {
+	uint8_t		type;		// ASTNodeType
+	uint8_t		value_type;	// DataType
+	uint8_t		flags;		// LiteralFlags for numbers, AST_FLAG_* otherwise
+	uint32_t	offset;		// byte offset of the node's first token
+	uint32_t	lhs;
+	uint32_t	rhs;
+} ASTNode;
 
-struct ASTNode {
-	ASTNodeType type;
-	DataType	value_type;
-	int line, column;
+_Static_assert(sizeof(ASTNode) == 16, "ASTNode must stay 16 bytes");
 
-	union
-	{
-		struct
-		{
-			StringView value;
-		} number;
-
-		struct
-		{
-			StringView name;
-		} identifier;
-
-		struct
-		{ 
-			ASTNode *left;
-			ASTNode *right;
-		} binary;
-
-		struct {
-			ASTNode *operand;
-		} unary;
-
-		struct
-		{
-			ASTNode	*condition;
-			ASTNode *then_branch;
-			ASTNode *else_branch; // NULL if no else 
-		} if_stmt;
-
-		struct {
-			ASTNode *condition;
-			ASTNode *body;
-		} while_stmt;
-
-		struct {
-			ASTNode *expression;
-		} return_stmt;
-
-		struct {
-			StringView	var_name;
-			DataType	var_type;
-			ASTNode		*initializer;
-		} var_decl;
-
-		struct {
-			StringView	var_name;
-			ASTNode		*value;
-		} assignment;
-
-		struct {
-			ASTNode		**statements;
-			size_t		count;
-		} block;
-
-		struct {
-			StringView	name;
-			DataType	return_type;
-			Parameter	*params;
-			size_t		param_count;
-			ASTNode		*body;
-			bool		is_prototype;
-		} function;
-
-		struct {
-			ASTNode **declarations;
-			size_t	count;
-		} translation_unit;
-
-		struct {
-			StringView function_name;
-			ASTNode **args;
-			size_t arg_count;
-		} call;
-	};
-};
-
-void	print_ast(ASTNode *node, int indent);
+typedef struct {
+	ASTNode				*nodes;
+	uint32_t			node_count;
+	uint32_t			node_capacity;
+	uint32_t			*extra;		// child lists and side data of nodes
+	uint32_t			extra_count;
+	uint32_t			extra_capacity;
+	Parameter			*params;
+	uint32_t			param_count;
+	uint32_t			param_capacity;
+	NodeId				root;		// AST_TRANSLATION_UNIT, NODE_NONE until parsed
+	Arena				*arena;
+	const InternTable	*interns;
+} Ast;
+
+typedef struct {
+	Atom		atom;
+	DataType	return_type;
+	NodeId		body;
+	Parameter	*params;
+	uint32_t	param_count;
+	uint32_t	start;		// offset of the return type, where the declaration begins
+	bool		is_prototype;
+	bool		is_lazy;	// body not parsed yet
+} ASTFunction;
+
+/* Builders (defined in ast.c), NODE_NONE or UINT32_MAX on allocation failure */
+bool		ast_init(Ast *ast, Arena *a, const InternTable *interns,
+				size_t source_size);
+NodeId		ast_add_node(Ast *ast, ASTNode node);
+uint32_t	ast_add_extra(Ast *ast, const uint32_t *words, uint32_t count);
+uint32_t	ast_add_params(Ast *ast, const Parameter *params, uint32_t count);
+void		ast_remap_atoms(Ast *ast, const Atom *remap);
+bool		ast_move_atoms(Ast *ast, InternTable *interns);
+NodeId		ast_copy_subtree(Ast *dst, const Ast *src, NodeId first, NodeId root,
+				int64_t offset_delta);
+
+static inline ASTNode	*ast_node(const Ast *ast, NodeId id)
+{
+	return (&ast->nodes[id]);
+}
+
+static inline ASTNodeType	ast_type(const Ast *ast, NodeId id)
+{
+	return ((ASTNodeType)ast->nodes[id].type);
+}
+
+static inline DataType	ast_value_type(const Ast *ast, NodeId id)
+{
+	return ((DataType)ast->nodes[id].value_type);
+}
+
+static inline StringView	ast_name(const Ast *ast, Atom atom)
+{
+	return (atom_sv(ast->interns, atom));
+}
+
+static inline int64_t	ast_number(const ASTNode *node)
+{
+	return ((int64_t)(((uint64_t)node->rhs << 32) | node->lhs));
+}
+
+/* Statements of a block or declarations of a translation unit */
+static inline const NodeId	*ast_list(const Ast *ast, NodeId id, uint32_t *count)
+{
+	*count = ast->nodes[id].rhs;
+	return (&ast->extra[ast->nodes[id].lhs]);
+}
+
+static inline const NodeId	*ast_call_args(const Ast *ast, NodeId id, uint32_t *count)
+{
+	*count = ast->extra[ast->nodes[id].rhs];
+	return (&ast->extra[ast->nodes[id].rhs + 1]);
+}
+
+static inline NodeId	ast_if_then(const Ast *ast, NodeId id)
+{
+	return (ast->extra[ast->nodes[id].rhs]);
+}
+
+static inline NodeId	ast_if_else(const Ast *ast, NodeId id)
+{
+	return (ast->extra[ast->nodes[id].rhs + 1]);
+}
+
+static inline ASTFunction	ast_function(const Ast *ast, NodeId id)
+{
+	const ASTNode	*node = &ast->nodes[id];
+	const uint32_t	*extra = &ast->extra[node->rhs];
+
+	return ((ASTFunction){
+		.atom = node->lhs,
+		.return_type = (DataType)node->value_type,
+		.body = extra[0],
+		.params = &ast->params[extra[1]],
+		.param_count = extra[2],
+		.start = extra[3],
+		.is_prototype = (node->flags & AST_FLAG_PROTOTYPE) != 0,
+		.is_lazy = (ast->nodes[extra[0]].flags & AST_FLAG_LAZY) != 0
+	});
+}
+
+void	print_ast(const Ast *ast, NodeId id, int indent);
 
 #endif
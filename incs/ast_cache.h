@@ -0,0 +1,69 @@
+#ifndef AST_CACHE_H
+# define AST_CACHE_H
+
+# include "ast.h"
+# include "file_map.h"
+# include "intern.h"
+# include "memarena.h"
+# include <stdbool.h>
+# include <stddef.h>
+# include <stdint.h>
+
+// Bump whenever ASTNode, Parameter, the extra layouts or the header change
+# define AST_CACHE_VERSION	4
+
+/*
+*	A cache file, <dir>/<source hash>.ast, is the parsed AST written out as
+*	it sits in memory. Links are indices and names are atoms, so nothing in
+*	it depends on where it is mapped:
+*
+*	  AstCacheHeader
+*	  ASTNode       nodes[node_count]
+*	  Parameter     params[param_count]
+*	  uint32_t      extra[extra_count]
+*	  AstCacheName  names[name_count]     the atoms the AST uses
+*	  char          text[text_size]       their spellings
+*
+*	Atoms are those of the table the file was parsed against. Loading
+*	interns the names again; when they come out the same, as they do for
+*	a file loaded where it was parsed, the arrays are used in place.
+*/
+typedef struct {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	node_size;		// sizeof(ASTNode), sizeof(Parameter) of the writer
+	uint32_t	param_size;
+	uint64_t	source_hash;
+	uint64_t	source_length;
+	uint32_t	node_count;
+	uint32_t	param_count;
+	uint32_t	extra_count;
+	uint32_t	name_count;
+	uint32_t	text_size;
+	uint32_t	atom_limit;		// every atom is below it
+	NodeId		root;
+	uint32_t	payload_hash;	// of everything after the header
+} AstCacheHeader;
+
+_Static_assert(sizeof(AstCacheHeader) % 16 == 0,
+		"AstCacheHeader must keep the node array aligned");
+
+typedef struct {
+	Atom		atom;
+	uint32_t	offset;		// into text
+	uint32_t	length;
+} AstCacheName;
+
+/* A loaded cache file, kept mapped for as long as the AST is used */
+typedef struct {
+	void	*data;
+	size_t	size;
+} AstCacheMap;
+
+bool	ast_cache_load(const char *dir, const FileMap *file, InternTable *interns,
+			Arena *a, Ast *ast, AstCacheMap *map);
+bool	ast_cache_store(const char *dir, const FileMap *file, const Ast *ast,
+			Arena *scratch);
+void	ast_cache_release(AstCacheMap *map);
+
+#endif // AST_CACHE_H
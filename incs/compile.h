@@ -2,36 +2,65 @@
 # define COMPILE_H
 
 # include "ast.h"
+# include "ast_cache.h"
 # include "file_map.h"
 # include "memarena.h"
 # include "semantic.h"
 # include "error_handler.h"
 # include "cleanup.h"
+# include "lexer.h"
+# include "intern.h"
 # include <stdbool.h>
 # include <stddef.h>
 
+typedef struct {
+	bool		pretokenize;	// --pretokenize: lex each file into a TokenStream first
+	bool		stream;			// --stream: read files through a sliding window
+	size_t		jobs;			// --jobs[=N]: worker threads, 1 runs everything inline
+	bool		watch;			// --watch: recompile whenever an input file changes
+	const char	*ast_cache;		// --ast-cache=DIR: reuse ASTs of unchanged files
+	bool		lazy;			// --lazy: parse only the bodies reachable from main
+	bool		fused;			// --fused: check each body as its IR is generated
+} CompileOptions;
+
+typedef struct CompileSession	CompileSession;
+
 typedef struct CompilationUnit {
-	FileMap	file;
-	ASTNode	*ast;
-	bool	parsed_ok;
+	FileMap		file;
+	int			fd;			// open while streamed, -1 when file is mapped
+	TokenStream	tokens;
+	Ast			ast;
+	Arena		arena;		// holds the AST when the unit was parsed on a worker
+	AstCacheMap	cache;		// holds the AST when it was loaded from --ast-cache
+	VisibleSet	visible;	// built by semantic analysis on first use
+	bool		parsed_ok;
 } CompilationUnit;
 
 typedef struct {
+	CompileOptions	options;
 	CompilationUnit	*units;
 	size_t			count;
 	size_t			capacity;
 	Arena			*arena;
 	ErrorContext	*errors;
+	InternTable		*interns;
+	CompileSession	*session;	// --watch state, NULL for a one-off compile
 	GlobalScope		global;
+	CallGraph		calls;		// built once bodies are analyzed, not under --lazy
 } CompilationContext;
 
+bool	compile_parse_options(CompileOptions *opts, int argc, char **argv,
+					ErrorContext *errors, size_t *file_count);
 bool	compile_ctx_init(CompilationContext *ctx, Arena *arena, 
-					ErrorContext *errors, size_t file_count);
+					ErrorContext *errors, const CompileOptions *opts,
+					size_t file_count, CompileSession *session);
 bool	compile_ctx_add_file(CompilationContext *ctx, const char *filepath,
 					ResourceTracker *resources);
 bool	compile_parse_all(CompilationContext *ctx);
 bool	compile_analyze_all(CompilationContext *ctx);
+CompilationUnit	*compile_unit_of(CompilationContext *ctx, const FileMap *file);
 void	compile_print_errors(CompilationContext *ctx);
-ASTNode	*compile_get_entry_point(CompilationContext *ctx);
+NodeId	compile_get_entry_point(CompilationContext *ctx, CompilationUnit **unit);
+void	compile_ctx_free(CompilationContext *ctx);
 
 #endif
@@ -1,22 +1,48 @@
 #ifndef DEFINES_H
 # define DEFINES_H
 
-// For scope variables
+# include <stdint.h>
+
+// Initial slots of the semantic scope table, which grows as needed
 # define SCOPE_HASH_SIZE			128
 
 # define MAX_SOURCE_FILES			64
+# define MAX_SOURCE_FILE_SIZE		(10 * 1024 * 1024)
 # define IR_CHUNK_SIZE				64 
 # define MAX_PARAMS_PER_FUNCTION	32
-# define MAX_FUNCTION_COUNT			256
-# define MAX_CALL_SITES				1024
-# define SYMBOL_TABLE_SIZE			4096
+// Initial sizes of the function and call site tables, which grow as needed
+# define FUNCTION_TABLE_SIZE		256
+# define CALL_SITE_TABLE_SIZE		1024
 # define MAX_LABELS					512
-# define MAX_BLOCK_STATEMENTS		512
-# define MAX_EXPRESSION_DEPTH		128
+// Tree walk frames kept on the C stack, deeper trees spill into the arena
+# define WALK_STACK_SIZE			64
 # define MAX_VREGS_PER_FUNCTION		65536
 
 // Upper bound on IR instructions per function to prevent buffer overflow
 # define MAX_IR_INSTRUCTIONS_PER_FUNCTION	65536
+// Pure call results kept for reuse at once, see ir_optimize_calls
+# define CALL_REUSE_LIMIT			64
+
+/* -- Streaming input (--stream) -- */
+// Token offsets are 32-bit, which is the only limit on a streamed file
+# define MAX_STREAM_FILE_SIZE		UINT32_MAX
+# ifndef STREAM_WINDOW_SIZE
+#  define STREAM_WINDOW_SIZE		(1024 * 1024)
+# endif
+// Bytes kept ahead of the lexer; longer tokens or comments are re-lexed
+# define STREAM_LOOKAHEAD			4096
+
+/* -- Worker threads (--jobs) -- */
+# define MAX_JOBS					64
+// Function bodies a semantic worker takes at a time, with one diagnostic list
+# define SEMANTIC_BATCH_SIZE		64
+// Files are only split for parallel lexing into chunks at least this big
+# ifndef PARALLEL_LEX_MIN_CHUNK
+#  define PARALLEL_LEX_MIN_CHUNK	(1024 * 1024)
+# endif
+
+/* -- Recompiling on change (--watch) -- */
+# define WATCH_POLL_MS				200
 
 /* -- For encoders.c -- */
 # define STACK_ALIGNMENT			16
@@ -45,8 +71,8 @@
 	} while (0)
 
 // Static assertions to ensure sane defaults
-_Static_assert((SYMBOL_TABLE_SIZE & (SYMBOL_TABLE_SIZE - 1)) == 0, 
-			   "SYMBOL_TABLE_SIZE must be power of 2");
+_Static_assert((SCOPE_HASH_SIZE & (SCOPE_HASH_SIZE - 1)) == 0,
+			   "SCOPE_HASH_SIZE must be power of 2");
 _Static_assert(MAX_PARAMS_PER_FUNCTION <= 255,
 			   "MAX_PARAMS_PER_FUNCTION must fit in uint8_t");
 
@@ -2,8 +2,10 @@
 # define ERROR_HANDLER_H
 
 # include "memarena.h"
+# include "file_map.h"
 # include <stdbool.h>
 # include <stdarg.h>
+# include <stdint.h>
 #include <stddef.h>
 
 typedef enum {
@@ -29,6 +31,8 @@ struct ErrorNode {
 	const char		*filename;
 	int				line;
 	int				column;
+	FileMap			*file;		// when set, line/column come from offset
+	uint32_t		offset;
 	ErrorNode		*next;
 };
 
@@ -41,20 +45,24 @@ typedef struct {
 } ErrorContext;
 
 void	error_context_init(ErrorContext *ctx, Arena *a);
+void	error_context_merge(ErrorContext *dst, const ErrorContext *src);
 void	error_add(ErrorContext *ctx, ErrorCategory category, ErrorLevel level,
-			const char *filename, int line, int column, 
+			const char *filename, int line, int column,
 			const char *fmt, ...) __attribute__((format(printf, 7, 8)));
+void	error_add_at(ErrorContext *ctx, ErrorCategory category, ErrorLevel level,
+			FileMap *file, uint32_t offset,
+			const char *fmt, ...) __attribute__((format(printf, 6, 7)));
 
-#define error_lexer(ctx, file, line, col, ...) \
-	error_add(ctx, ERROR_LEXER, ERROR_LEVEL_ERROR, file, line, col, __VA_ARGS__)
-#define error_parser(ctx, file, line, col, ...) \
-	error_add(ctx, ERROR_PARSER, ERROR_LEVEL_ERROR, file, line, col, __VA_ARGS__)
-#define error_semantic(ctx, file, line, col, ...) \
-	error_add(ctx, ERROR_SEMANTIC, ERROR_LEVEL_ERROR, file, line, col, __VA_ARGS__)
+#define error_lexer(ctx, file, offset, ...) \
+	error_add_at(ctx, ERROR_LEXER, ERROR_LEVEL_ERROR, file, offset, __VA_ARGS__)
+#define error_parser(ctx, file, offset, ...) \
+	error_add_at(ctx, ERROR_PARSER, ERROR_LEVEL_ERROR, file, offset, __VA_ARGS__)
+#define error_semantic(ctx, file, offset, ...) \
+	error_add_at(ctx, ERROR_SEMANTIC, ERROR_LEVEL_ERROR, file, offset, __VA_ARGS__)
 #define error_fatal(ctx, file, line, col, ...) \
 	error_add(ctx, ERROR_SYSTEM, ERROR_LEVEL_FATAL, file, line, col, __VA_ARGS__)
-#define warning_add(ctx, file, line, col, ...) \
-	error_add(ctx, ERROR_PARSER, ERROR_LEVEL_WARNING, file, line, col, __VA_ARGS__)
+#define warning_add(ctx, file, offset, ...) \
+	error_add_at(ctx, ERROR_PARSER, ERROR_LEVEL_WARNING, file, offset, __VA_ARGS__)
 
 bool	error_has_errors(ErrorContext *ctx);
 bool	error_has_warnings(ErrorContext *ctx);
@@ -2,13 +2,24 @@
 # define FILE_MAP_H
 
 # include <stddef.h>
+# include <stdint.h>
+# include "memarena.h"
 
 typedef struct {
 	const char	*data;
 	size_t		length;
 	const char	*name;
+	uint32_t	*line_offsets;	// start offset of every line, built on demand
+	size_t		line_count;
 } FileMap;
 
-FileMap map_input(int fd);
+typedef struct {
+	int	line;
+	int	column;
+} SourcePos;
+
+FileMap		map_input(int fd);
+bool		file_map_index_lines(FileMap *file, Arena *a);
+SourcePos	file_map_position(FileMap *file, Arena *a, uint32_t offset);
 
 #endif // FILE_MAP_H
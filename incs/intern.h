@@ -0,0 +1,56 @@
+#ifndef INTERN_H
+# define INTERN_H
+
+# include <stdbool.h>
+# include <stddef.h>
+# include <stdint.h>
+# include "memarena.h"
+# include "string_view.h"
+
+/* Interned identifier. Equal names get equal atoms; 0 means "no atom". */
+typedef uint32_t	Atom;
+
+# define ATOM_NONE	0
+
+typedef struct {
+	const char	*start;
+	uint32_t	len;
+	uint32_t	hash;
+} InternEntry;
+
+typedef struct {
+	InternEntry	*entries;	// indexed by atom, entries[0] unused
+	uint32_t	count;
+	uint32_t	capacity;
+	Atom		*slots;		// open addressing over entries, 0 = empty
+	uint32_t	slot_mask;
+	Arena		*arena;
+	bool		copy_all;	// intern behaves like intern_copy, for tables outliving the source
+} InternTable;
+
+bool	intern_init(InternTable *t, Arena *a);
+Atom	intern(InternTable *t, const char *s, size_t len);
+Atom	intern_copy(InternTable *t, const char *s, size_t len);
+Atom	intern_find(const InternTable *t, const char *s, size_t len);
+
+static inline StringView	atom_sv(const InternTable *t, Atom atom)
+{
+	return ((StringView){ t->entries[atom].start, t->entries[atom].len });
+}
+
+static inline uint32_t	atom_hash(const InternTable *t, Atom atom)
+{
+	return (t->entries[atom].hash);
+}
+
+/*
+*	Slot for an atom in a power-of-two table. Atoms are dense small
+*	integers and an odd multiplier permutes the low bits, so no lookup of
+*	the cached string hash is needed.
+*/
+static inline uint32_t	atom_slot(Atom atom, uint32_t mask)
+{
+	return ((atom * 2654435761u) & mask);
+}
+
+#endif // INTERN_H
@@ -2,35 +2,16 @@
 # define IR_H
 
 #include "error_handler.h"
+# include "file_map.h"
 # include "memarena.h"
 # include "ast.h"
 # include "string_view.h"
+# include "intern.h"
 # include "defines.h"
 # include <stdbool.h>
 # include <stdlib.h>
 # include <stddef.h>
 
-typedef struct ScopeChange ScopeChange;
-
-typedef struct {
-	StringView	name;
-	size_t		index;
-	bool		is_stack;
-	bool		occupied;
-} Symbol;
-
-struct ScopeChange {
-	size_t		index;
-	Symbol		previous;
-	ScopeChange	*next;
-};
-
-typedef struct {
-	Symbol		entries[SYMBOL_TABLE_SIZE];
-	Arena		*arena;
-	ScopeChange	*changes;
-} SymbolTable;
-
 typedef enum {
 	FMT_NONE,
 	FMT_BIN,	// dest = src_1 op src_2
@@ -57,10 +38,13 @@ typedef struct {
 	size_t		src_2;
 	int64_t		imm;	// Immediate value for IR_CONST
 	StringView	func_name;
+	Atom		func_atom;
 	size_t		label_id;
 } IRInstruction;
 
 typedef struct IRChunk IRChunk;
+typedef struct SemanticAnalyzer SemanticAnalyzer;
+typedef struct CallGraph CallGraph;
 
 struct IRChunk {
 	IRChunk			*next;
@@ -74,19 +58,21 @@ typedef struct {
 	size_t			total_count;
 	size_t			vreg_count;
 	size_t			stack_count;
+	size_t			param_count;	// held in vregs 1 to param_count
 	size_t			label_count;
 	StringView		name;
 	ErrorContext	*errors;
-	const char		*filename;
+	FileMap			*file;
+	const Ast		*ast;
+	SemanticAnalyzer	*sa;		// set by ir_gen_fused, which checks nodes as it goes
+	bool			checked;	// whether the nodes checked so far passed
 } IRFunction;
 
-uint32_t		hash_sv(StringView sv);
-void			symbol_table_restore(SymbolTable *st, ScopeChange *target_state);
-Symbol*			symbol_table_lookup(SymbolTable *st, StringView name);
-void			symbol_table_add(SymbolTable *st, StringView name, size_t vreg);
-
-IRFunction		*ir_gen(Arena *a, ASTNode *root, 
-						ErrorContext *errors, const char *filename);
+IRFunction		*ir_gen(Arena *a, const Ast *ast, NodeId root,
+						ErrorContext *errors, FileMap *file);
+IRFunction		*ir_gen_fused(Arena *a, SemanticAnalyzer *sa, NodeId func,
+						ErrorContext *errors);
+void			ir_optimize_calls(Arena *a, IRFunction *f, const CallGraph *calls);
 void			ir_print(IRFunction *func);
 
 const char		*ir_opcode_name(IROpcode op);
@@ -99,7 +85,7 @@ static inline bool ir_alloc_vreg(IRFunction *f, size_t *out_vreg)
         if (f->errors)
         {
             error_add(f->errors, ERROR_CODEGEN, ERROR_LEVEL_ERROR,
-                    f->filename, 0, 0,
+                    f->file ? f->file->name : NULL, 0, 0,
                     "function '%.*s' exceeds virtual register limit (%d)",
                     (int)f->name.len, f->name.start, MAX_VREGS_PER_FUNCTION);
         }
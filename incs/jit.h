@@ -71,6 +71,7 @@ typedef enum {
 	OP_MOVSXD = 0x63,		// Load 32-bit signed (move with sign-extended dword)
 	OP_MOVSX_8 = 0xBE,		// Load 8-bit signed (move with sign-extended byte + 0x prefix)
 	OP_MOVZX = 0xB6,		// MOVZX r64, r/m8 (w/ 0f prefix)
+	OP_MOVZX_16 = 0xB7,		// MOVZX r64, r/m16 (w/ 0f prefix)
 	OP_LEA = 0x8D,			// Load effective address
 	OP_SHIFT_CL = 0xD3,		// Shift r/m by CL
 
@@ -133,27 +134,17 @@ struct Patch {
 	Patch	*next;
 };
 
-typedef struct {
-	StringView	name;
-	uint8_t		*code_addr;
-	size_t		code_size;
-} CompiledFunction;
-
-typedef struct {
-	CompiledFunction	*functions;
-	size_t				count;
-	size_t				capacity;
-} FunctionRegistry;
-
 typedef struct {
 	uint8_t		*patch_location;
 	StringView	target_name;
+	Atom		target_atom;
 } CallSite;
 
 typedef struct {
 	CallSite	*sites;
 	size_t		count;
 	size_t		capacity;
+	size_t		dropped;	// sites that found no memory, reported when linking
 } CallSiteList;
 
 typedef struct {
@@ -164,7 +155,8 @@ typedef struct {
 typedef struct {
 	Arena				*data_arena;
 	Arena				*exec_arena;
-	FunctionRegistry	registry;
+	Arena				*link_arena;	// call sites, kept until linked
+	GlobalScope			*global;		// where compiled functions are recorded
 	CallSiteList		call_sites;
 	PendingCall			pending_call;
 
@@ -179,9 +171,13 @@ typedef struct {
 
 bool	jit_compile_pass(JITContext *jit_ctx, CompilationContext *comp_ctx, 
 					ErrorContext *errors);
-void		jit_ctx_init(JITContext *ctx, Arena *a, Arena *exec_arena);
-JITResult	jit_compile_function(JITContext *ctx, IRFunction *ir_func, ASTNode *func);
+void		jit_ctx_init(JITContext *ctx, Arena *a, Arena *exec_arena,
+				Arena *link_arena, GlobalScope *global);
+JITResult	jit_compile_function(JITContext *ctx, IRFunction *ir_func,
+				const Ast *ast, NodeId func);
 bool		jit_link_all(JITContext *ctx, ErrorContext *errors);
+uint8_t		*jit_lookup_function(JITContext *ctx, Atom name);
+void		jit_add_call_site(JITContext *ctx, CallSite site);
 
 void		emit_u8(uint8_t **buf, size_t *count, uint8_t byte);
 void		emit_u32(uint8_t **buf, size_t *count, uint32_t val);
@@ -194,6 +190,7 @@ void		emit_imul_r64(uint8_t **buf, size_t *cnt, X86Reg dst, X86Reg src);
 void		emit_mov_reg_reg(uint8_t **buf, size_t *cnt, X86Reg dst, X86Reg src);
 void		emit_cmp(uint8_t **buf, size_t *cnt, X86Reg dst, X86Reg src);
 void		emit_movzx(uint8_t **buf, size_t *cnt, X86Reg dst, X86Reg src);
+void		emit_zeroext(uint8_t **buf, size_t *cnt, X86Reg reg, int size);
 void		emit_setcc(uint8_t **buf, size_t *cnt, X86Condition cc, X86Reg dst);
 void		emit_test(uint8_t **buf, size_t *cnt, X86Reg dst, X86Reg src);
 void		emit_pop(uint8_t **buf, size_t *cnt, X86Reg reg);
@@ -14,6 +14,7 @@ Location get_location(JITContext *ctx, size_t vreg);
 /* --- Location Helper Functions -- */
 void	load_location_to_reg(uint8_t **buf, size_t *size, X86Reg dst, Location loc);
 void	store_reg_to_location(uint8_t **buf, size_t *size, Location loc, X86Reg src);
+void	wrap_unsigned(uint8_t **buf, size_t *size, X86Reg reg, DataType type);
 void	load_binary_operands(uint8_t **buf, size_t *size, X86Reg dst, X86Reg tmp,
 							Location left, Location right, X86Reg *out_right_reg);
 size_t	emit_standard_binary_op(uint8_t *buf, IRInstruction *inst, JITContext *ctx,
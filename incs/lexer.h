@@ -3,7 +3,11 @@
 
 # include <ctype.h>
 # include <stdbool.h>
+# include <stdint.h>
 # include "file_map.h"
+# include "intern.h"
+# include "error_handler.h"
+# include "memarena.h"
 # include "string_view.h"
 
 typedef enum {
@@ -12,33 +16,98 @@ typedef enum {
 	#undef X_TOKEN
 }	TokenType;
 
+/* Integer literal suffixes, as written in the source */
+typedef enum {
+	LITERAL_UNSIGNED	= 1 << 0,	// u, U
+	LITERAL_LONG		= 1 << 1,	// l, L, ll, LL
+} LiteralFlags;
+
 typedef struct {
 	TokenType type;
 	StringView text;
-	int line;
-	int column;
+	uint32_t offset;	// byte offset into the file, see file_map_position
+	Atom atom;			// interned name, TOKEN_IDENTIFIER only
+	uint64_t value;		// TOKEN_NUMBER only, already range checked
+	uint8_t literal_flags;
 } Token;
 
+/* Sliding read window over a file that is not mapped, see input_stream.c */
+typedef struct {
+	int			fd;
+	char		*buffer;
+	size_t		capacity;
+	size_t		filled;			// valid bytes in buffer
+	uint32_t	base_offset;	// file offset of buffer[0]
+	bool		eof;
+	size_t		line_capacity;
+	FileMap		*file;			// line index is built here as input arrives
+	Arena		*arena;
+} InputStream;
+
 typedef struct {
-	const char	*start;
-	const char	*curr;
-	const char	*end;
-	int			line;
-	int			column;
-	FileMap		*file;
+	const char		*start;
+	const char		*curr;
+	const char		*end;
+	const char		*base;			// buffer holding file offset base_offset
+	uint32_t		base_offset;
+	bool			use_simd;
+	FileMap			*file;
+	InputStream		*stream;		// NULL when the whole file is mapped
+	InternTable		*interns;
+	ErrorContext	*errors;		// lexer diagnostics, may be NULL
 } Lexer;
 
+typedef struct {
+	uint64_t	value;
+	uint8_t		flags;
+} TokenLiteral;
+
+/* Whole-file token stream, one entry per token in parallel arrays */
+typedef struct {
+	uint8_t			*types;
+	uint32_t		*offsets;
+	uint32_t		*lengths;
+	uint32_t		*payloads;	// atom for identifiers, literal index for numbers
+	size_t			count;
+	size_t			capacity;
+	TokenLiteral	*literals;
+	size_t			literal_count;
+	size_t			literal_capacity;
+	FileMap			*file;
+} TokenStream;
+
+/* Walks a TokenStream, rebuilding Tokens on the way */
+typedef struct {
+	TokenStream	*stream;
+	size_t		index;
+} TokenCursor;
+
 /* =================== */
 /* FUNCTION PROTOTYPES */
 /* =================== */
 
-void	lexer_init(Lexer *l, FileMap *file);
+void	lexer_init(Lexer *l, FileMap *file, InternTable *interns,
+			ErrorContext *errors);
+void	lexer_init_stream(Lexer *l, InputStream *s, InternTable *interns,
+			ErrorContext *errors);
 Token	lexer_next(Lexer *l);
 char	lexer_peek(Lexer *l);
 char	lexer_peek_next(Lexer *l);
 char	lexer_advance(Lexer *l);
 void	lexer_skip_whitespace(Lexer *l);
+bool	lexer_skip_block(Lexer *l);
 Token	lexer_make_token(Lexer *l, TokenType type, StringView text);
 Token	lexer_make_token_no_sv(Lexer *l, TokenType type);
 
+bool		input_stream_open(InputStream *s, int fd, FileMap *file, Arena *a);
+bool		input_stream_refill(InputStream *s, size_t keep_from);
+void		input_stream_close(InputStream *s);
+
+bool		lexer_tokenize(Lexer *l, Arena *a, TokenStream *out);
+bool		lexer_tokenize_parallel(FileMap *file, InternTable *interns,
+				ErrorContext *errors, Arena *a, size_t jobs, TokenStream *out);
+void		token_cursor_init(TokenCursor *c, TokenStream *stream);
+Token		token_cursor_next(TokenCursor *c);
+TokenType	token_cursor_peek(TokenCursor *c, size_t ahead);
+
 #endif
@@ -0,0 +1,35 @@
+#ifndef LEXER_INTERNAL_H
+# define LEXER_INTERNAL_H
+
+# include "lexer.h"
+
+/* === Bulk scanners (scan.c) ===
+*
+*	Each scanner starts at p and returns the first byte that does not
+*	belong to the run. With l->use_simd set they use the SSE2/AVX2 path,
+*	otherwise the scalar fallback. Newlines are not tracked here; positions
+*	are resolved from byte offsets when a diagnostic needs them.
+*/
+bool		lexer_simd_available(void);
+const char	*lexer_scan_whitespace(Lexer *l, const char *p);
+const char	*lexer_scan_identifier(Lexer *l, const char *p);
+const char	*lexer_scan_digits(Lexer *l, const char *p);
+const char	*lexer_scan_line(Lexer *l, const char *p);
+const char	*lexer_scan_block_comment(Lexer *l, const char *p);
+
+/* === Keyword lookup (keywords.c) === */
+void		lexer_keywords_init(void);
+TokenType	lexer_keyword_lookup(const char *s, size_t len);
+const char	*lexer_token_spelling(TokenType type);
+
+/* === Operator DFA (operators.c) === */
+void		lexer_operators_init(void);
+TokenType	lexer_scan_operator(Lexer *l);
+
+/* True when a streaming lexer hit the window end and may have cut a token */
+static inline bool	lexer_window_cut(const Lexer *l)
+{
+	return (l->stream && l->curr >= l->end && !l->stream->eof);
+}
+
+#endif // LEXER_INTERNAL_H
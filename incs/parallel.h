@@ -0,0 +1,16 @@
+#ifndef PARALLEL_H
+# define PARALLEL_H
+
+# include <stddef.h>
+
+/* One unit of work, called once for every index in [0, count) */
+typedef void	(*ParallelFn)(void *ctx, size_t index);
+/* The same, told which worker runs it: a number below jobs, fixed per thread */
+typedef void	(*ParallelWorkerFn)(void *ctx, size_t worker, size_t index);
+
+void	parallel_for(size_t count, size_t jobs, ParallelFn fn, void *ctx);
+void	parallel_for_workers(size_t count, size_t jobs, ParallelWorkerFn fn,
+			void *ctx);
+size_t	parallel_default_jobs(void);
+
+#endif // PARALLEL_H
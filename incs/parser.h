@@ -29,16 +29,53 @@ typedef enum {
 	PREC_PRIMARY,
 } Precedence;
 
+typedef enum {
+	EXPR_UNARY,		// op of the operand
+	EXPR_BINARY,	// left op the operand
+	EXPR_ASSIGN,	// name = the operand
+	EXPR_COMPOUND,	// name op= the operand
+	EXPR_GROUP,		// ( the operand )
+	EXPR_CALL,		// name(..., the operand, ...)
+} ExprFrameKind;
+
+/*
+*	An operator waiting for its right operand. parse_expression keeps these
+*	on a stack instead of recursing, and builds the node once the operand
+*	is complete.
+*/
+typedef struct {
+	uint8_t		kind;		// ExprFrameKind
+	uint8_t		op;			// ASTNodeType to build
+	uint8_t		precedence;	// of the expression to resume afterwards
+	uint32_t	offset;
+	uint32_t	lhs;		// left operand or assigned identifier, the atom of a callee
+	uint32_t	top;		// scratch_count when a call opened
+} ExprFrame;
+
 typedef struct {
 	Lexer			*lexer;
+	TokenCursor		*cursor;
+	FileMap			*file;
 	Arena			*arena;
+	Ast				*ast;
 	ErrorContext	*errors;
 	Token			current;
 	Token			next;
 	bool			panic_mode;
-	size_t			expr_depth;
+	bool			lazy;		// delimit function bodies instead of parsing them
+	Precedence		expr_prec;	// binding power of the operand being parsed
+	ExprFrame		*frames;	// pending operators, innermost on top
+	uint32_t		frame_count;
+	uint32_t		frame_capacity;
+	NodeId			*scratch;	// open child lists, innermost on top
+	uint32_t		scratch_count;
+	uint32_t		scratch_capacity;
 } Parser;
 
-ASTNode	*parser_parse(Lexer *l, Arena *a, ErrorContext *e);
+NodeId	parser_parse(Lexer *l, Ast *ast, ErrorContext *e);
+NodeId	parser_parse_stream(TokenStream *ts, Ast *ast, ErrorContext *e);
+NodeId	parser_parse_lazy(Lexer *l, Ast *ast, ErrorContext *e);
+NodeId	parser_parse_body(Ast *ast, NodeId func, FileMap *file,
+			InternTable *interns, ErrorContext *e);
 
 #endif
@@ -5,9 +5,12 @@
 # include "ast.h"
 # include "lexer.h"
 
-typedef ASTNode*	(*ParsePrefixFn)(Parser *p);
-typedef ASTNode*	(*ParseInfixFn)(Parser *p, ASTNode *left);
-typedef ASTNode*	(*ParseStmtFn)(Parser *p);
+/* Returned by a rule that pushed an ExprFrame and still needs an operand */
+# define NODE_PENDING	UINT32_MAX
+
+typedef NodeId	(*ParsePrefixFn)(Parser *p);
+typedef NodeId	(*ParseInfixFn)(Parser *p, NodeId left);
+typedef NodeId	(*ParseStmtFn)(Parser *p);
 
 typedef struct {
 	const char		*name;
@@ -20,24 +23,28 @@ typedef struct {
 extern const ParseRule rules[];
 
 // === Expression parsing (parser_expr.c) ===
-ASTNode		*parse_expression(Parser *parser, Precedence precedence);
-ASTNode		*parse_assignment(Parser *p, ASTNode *left);
-ASTNode		*parse_identifier(Parser *parser);
-ASTNode		*parse_grouping(Parser *parser);
-ASTNode		*parse_number(Parser *parser);
-ASTNode		*parse_unary(Parser *parser);
-ASTNode		*parse_binary(Parser *parser, ASTNode *left);
-ASTNode		*parse_call(Parser *parser, ASTNode *callee);
+NodeId		parse_expression(Parser *parser, Precedence precedence);
+NodeId		parse_assignment(Parser *p, NodeId left);
+NodeId		parse_compound_assignment(Parser *p, NodeId left);
+NodeId		parse_identifier(Parser *parser);
+NodeId		parse_grouping(Parser *parser);
+NodeId		parse_number(Parser *parser);
+NodeId		parse_unary(Parser *parser);
+NodeId		parse_binary(Parser *parser, NodeId left);
+NodeId		parse_call(Parser *parser, NodeId callee);
+
+// === Constant folding (parser_fold.c) ===
+NodeId		parser_fold(Parser *parser, ASTNode node);
 
 // === Statement parsing (parser_stmt.c) ===
-ASTNode		*parse_statement(Parser *parser);
-ASTNode		*parse_block(Parser *parser);
-ASTNode		*parse_function(Parser *parser);
-ASTNode		*parse_var_decl(Parser *parser);
-ASTNode		*parse_return(Parser *parser);
-ASTNode		*parse_if(Parser *parser);
-ASTNode		*parse_while(Parser *parser);
-ASTNode		*parse_expr_stmt(Parser *parser);
+NodeId		parse_statement(Parser *parser);
+NodeId		parse_block(Parser *parser);
+NodeId		parse_function(Parser *parser);
+NodeId		parse_var_decl(Parser *parser);
+NodeId		parse_return(Parser *parser);
+NodeId		parse_if(Parser *parser);
+NodeId		parse_while(Parser *parser);
+NodeId		parse_expr_stmt(Parser *parser);
 
 // === Utils (parser_utils.c ===
 void		parser_advance(Parser *parser);
@@ -49,6 +56,10 @@ bool		check(Parser *parser, TokenType type);
 const char	*token_type_name(TokenType type);
 Precedence	get_token_precedence(TokenType type);
 DataType	parse_type(Parser *parser);
+NodeId		parser_add_node(Parser *parser, ASTNode node);
+uint32_t	parser_add_extra(Parser *parser, const uint32_t *words, uint32_t count);
+bool		parser_scratch_push(Parser *parser, NodeId id);
+uint32_t	parser_scratch_flush(Parser *parser, uint32_t top, bool counted);
 
 
 
@@ -6,6 +6,7 @@
 # include "defines.h"
 # include "string_view.h"
 # include "error_handler.h"
+# include "file_map.h"
 # include <stdbool.h>
 # include <stddef.h>
 # include <limits.h>
@@ -14,61 +15,143 @@ typedef struct CompilationUnit CompilationUnit;
 
 typedef struct {
 	StringView	name;
+	Atom		atom;
 	DataType	type;
 	bool		initialized;
-	int			line;
+	uint32_t	offset;
+	uint32_t	index;		// parameter number, then locals in declaration order
 } VarInfo;
 
+/* A variable in scope and the one of the same name it hides */
 typedef struct {
 	VarInfo		info;
-	bool		occupied;
-} ScopeEntry;
+	uint32_t	depth;		// nesting of the scope it is declared in
+	uint32_t	shadowed;	// index + 1 into ScopeTable.vars, 0 if none
+} ScopeVar;
 
-typedef struct Scope Scope;
+typedef struct {
+	Atom		atom;
+	uint32_t	var;		// index + 1 into ScopeTable.vars, 0 if out of scope
+} ScopeSlot;
 
-struct Scope {
-	Scope		*parent;
-	ScopeEntry	entries[SCOPE_HASH_SIZE];
-	size_t		var_count;
-};
+/*
+*	Every variable of the function being analyzed, in one table. A name
+*	keeps its slot once declared, pointing at the innermost variable of
+*	that name in scope, so a lookup is a single probe sequence whatever the nesting.
+*	vars doubles as the undo log: leaving a scope pops the variables
+*	declared at its depth and points their slots back at the ones they hid.
+*/
+typedef struct {
+	ScopeSlot	*slots;
+	uint32_t	capacity;	// power of two
+	uint32_t	used;		// slots holding a name
+	ScopeVar	*vars;
+	uint32_t	var_count;
+	uint32_t	var_capacity;
+	uint32_t	depth;
+	uint32_t	declared;	// variables the function has declared so far
+} ScopeTable;
 
 typedef struct {
 	StringView	name;
+	Atom		atom;
 	DataType	return_type;
 	Parameter	*params;
 	size_t		param_count;
-	int			line;
-	const char	*filename;
+	FileMap		*file;
+	uint32_t	offset;
+	NodeId		node;		// the AST_FUNCTION in file's AST, the definition once seen
 	bool		is_prototype;
+	uint8_t		*code;		// entry point, once the JIT has compiled it
 } FunctionInfo;
 
+/*
+*	Every function of the program, in declaration order, and an open
+*	addressed index over it by name. Both grow as needed, so a pointer
+*	into functions only holds until the next declaration.
+*/
 typedef struct {
-	FunctionInfo	functions[MAX_FUNCTION_COUNT];
+	FunctionInfo	*functions;
 	size_t			function_count;
+	size_t			function_capacity;
+	uint32_t		*slots;			// index + 1 into functions, 0 if empty
+	uint32_t		slot_capacity;	// power of two
+	Arena			*arena;
 } GlobalScope;
 
+/* What a call may do besides computing its result */
+typedef enum {
+	EFFECT_IMPURE	= 1 << 0,	// touches state other than its own frame
+	EFFECT_LOOPS	= 1 << 1,	// may never return, looping or recursing
+	EFFECT_TRAPS	= 1 << 2,	// may fault, as a division can
+	EFFECT_UNKNOWN	= EFFECT_IMPURE | EFFECT_LOOPS | EFFECT_TRAPS,
+} CallEffect;
+
+/*
+*	Calls between the functions of the program, by index into
+*	GlobalScope.functions. The callees of function i, each listed once,
+*	are callees[first[i]] up to callees[first[i + 1]].
+*/
+typedef struct CallGraph {
+	uint32_t	*first;				// function_count + 1 offsets into callees
+	uint32_t	*callees;
+	size_t		function_count;
+	bool		*reachable;			// set by call_graph_mark_reachable
+	uint8_t		*effects;			// CallEffect bits, final after call_graph_find_effects
+	GlobalScope	*global;
+} CallGraph;
+
+/* The names a unit declares, which are the ones its bodies may call */
 typedef struct {
-	Scope			*current;
+	Atom		*atoms;
+	uint32_t	capacity;	// power of two, 0 until built
+} VisibleSet;
+
+typedef struct SemanticAnalyzer {
+	ScopeTable		scopes;
 	Arena			*arena;
 	ErrorContext	*errors;
-	const char		*filename;
+	FileMap			*file;
+	Ast				*ast;
 	GlobalScope		*global;
 	DataType		current_return_type;
-
-	StringView		visible_funcs[MAX_FUNCTION_COUNT];
-	size_t			visible_count;
+	const VisibleSet	*visible;
 } SemanticAnalyzer;
 
 bool	semantic_analyze(Arena *a, CompilationUnit *unit, ErrorContext *errors, GlobalScope *global);
+bool	semantic_prepare_unit(CompilationUnit *unit, ErrorContext *errors,
+			GlobalScope *global);
+bool	semantic_analyze_function(Arena *a, ScopeTable *scopes,
+			CompilationUnit *unit, Ast *ast, NodeId func, ErrorContext *errors,
+			GlobalScope *global);
+
+bool	semantic_init(SemanticAnalyzer *sa, Arena *a, CompilationUnit *unit,
+			Ast *ast, ErrorContext *errors, GlobalScope *global);
+
+/* One node at a time, for walkers that do more than analyze */
+bool	semantic_begin_function(SemanticAnalyzer *sa, NodeId func);
+void	semantic_end_function(SemanticAnalyzer *sa);
+bool	semantic_enter(SemanticAnalyzer *sa, NodeId id);
+bool	semantic_check_argument(SemanticAnalyzer *sa, NodeId call, uint32_t index);
+bool	semantic_leave(SemanticAnalyzer *sa, NodeId id, bool children_ok);
+bool	semantic_analyze_tree(SemanticAnalyzer *sa, NodeId root);
 
 bool	semantic_global_declare_function(GlobalScope *global, ErrorContext *errors, 
-			ASTNode *func_node, const char *filename);
+			const Ast *ast, NodeId func_node, FileMap *file);
+
+FunctionInfo	*semantic_global_lookup_function(GlobalScope *global, Atom name);
 
-FunctionInfo	*semantic_global_lookup_function(GlobalScope *global, StringView name);
+bool	call_graph_build(CallGraph *graph, Arena *a, GlobalScope *global,
+			CompilationUnit *units, size_t unit_count, ErrorContext *errors);
+bool	call_graph_mark_reachable(CallGraph *graph, Arena *a, uint32_t entry,
+			ErrorContext *errors);
+bool	call_graph_find_effects(CallGraph *graph, Arena *a, ErrorContext *errors);
+uint8_t	call_graph_effects(const CallGraph *graph, Atom callee);
 
-Scope	*semantic_scope_enter(SemanticAnalyzer *sa);
+void	semantic_scope_enter(SemanticAnalyzer *sa);
 void	semantic_scope_exit(SemanticAnalyzer *sa);
-VarInfo	*semantic_scope_lookup(Scope *scope, StringView name);
-bool	semantic_scope_declare(SemanticAnalyzer *sa, StringView name, DataType type, int line);
+VarInfo	*semantic_scope_lookup(SemanticAnalyzer *sa, Atom name);
+VarInfo	*semantic_scope_declare(SemanticAnalyzer *sa, StringView name, Atom atom,
+			DataType type, uint32_t offset);
 
 #endif
@@ -0,0 +1,65 @@
+#ifndef SESSION_H
+# define SESSION_H
+
+# include "ast.h"
+# include "compile.h"
+# include "defines.h"
+# include "error_handler.h"
+# include "intern.h"
+# include "memarena.h"
+# include <stdbool.h>
+# include <stdint.h>
+# include <sys/stat.h>
+
+/*
+*	A top-level declaration kept from the last parse of a file. The ranges
+*	of a file's declarations tile it: each runs from its start to the next
+*	declaration's start, the first from offset 0, the last to the end of
+*	the file.
+*/
+typedef struct {
+	uint32_t	start;
+	uint32_t	length;
+	uint64_t	hash;		// of the range's bytes
+	NodeId		first;		// the subtree is nodes [first, root]
+	NodeId		root;
+} ReparseDecl;
+
+typedef struct {
+	const char	*path;
+	Arena		arenas[2];	// the AST and decls live in arenas[current]
+	int			current;
+	Ast			ast;
+	ReparseDecl	*decls;
+	uint32_t	decl_count;
+	uint32_t	length;		// file size the decls were built from
+	bool		valid;		// set once the file has parsed cleanly
+} ReparseEntry;
+
+typedef struct {
+	bool			exists;
+	off_t			size;
+	struct timespec	mtime;
+} WatchStamp;
+
+/* State kept across the recompiles of a --watch session */
+struct CompileSession {
+	bool			watch;		// set by session_start
+	Arena			arena;		// intern table and its names
+	InternTable		interns;	// atoms stay valid from one compile to the next
+	ReparseEntry	entries[MAX_SOURCE_FILES];
+	size_t			entry_count;
+	size_t			reused;		// declarations the last compile carried over
+	size_t			reparsed;	// declarations it had to parse
+	WatchStamp		stamps[MAX_SOURCE_FILES];
+};
+
+void	session_init(CompileSession *s);
+void	session_free(CompileSession *s);
+bool	session_start(CompileSession *s);
+NodeId	session_parse_unit(CompileSession *s, CompilationUnit *unit,
+			ErrorContext *errors);
+void	session_stamp_files(CompileSession *s, int argc, char **argv);
+void	session_wait_for_change(CompileSession *s, int argc, char **argv);
+
+#endif // SESSION_H
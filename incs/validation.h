@@ -16,13 +16,13 @@ typedef struct {
 } FileValidation;
 
 bool	validate_source_file(const char *filepath, FileValidation *out,
-				ErrorContext *errors);
+				size_t max_size, ErrorContext *errors);
 bool	validate_file_extension(const char *filepath, const char *expected_ext);
 bool	validate_file_size(size_t size, size_t max_size, const char *filepath,
 				ErrorContext *errors);
 bool	validate_identifier(const char *name, size_t len, ErrorContext *errors,
-				const char *filename, int line);
+				FileMap *file, uint32_t offset);
 bool	validate_integer_literal(const char *text, size_t len, int64_t *out_value,
-				ErrorContext *errors, const char *filename, int line);
+				ErrorContext *errors, FileMap *file, uint32_t offset);
 
 #endif // VALIDATION_H
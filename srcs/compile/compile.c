@@ -7,15 +7,103 @@
 #include "lexer.h"
 #include "validation.h"
 #include "parser.h"
+#include "parallel.h"
+#include "session.h"
 #include <errno.h>
 #include <fcntl.h>
 
+/**
+ * @brief Picks the "--" options out of argv, counting the remaining files
+ */
+bool compile_parse_options(CompileOptions *opts, int argc, char **argv,
+		ErrorContext *errors, size_t *file_count)
+{
+	*opts = (CompileOptions){ .jobs = 1 };
+	*file_count = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strncmp(argv[i], "--", 2) != 0)
+			(*file_count)++;
+		else if (strcmp(argv[i], "--pretokenize") == 0)
+			opts->pretokenize = true;
+		else if (strcmp(argv[i], "--stream") == 0)
+			opts->stream = true;
+		else if (strcmp(argv[i], "--watch") == 0)
+			opts->watch = true;
+		else if (strcmp(argv[i], "--lazy") == 0)
+			opts->lazy = true;
+		else if (strcmp(argv[i], "--fused") == 0)
+			opts->fused = true;
+		else if (strncmp(argv[i], "--ast-cache=", 12) == 0)
+		{
+			if (argv[i][12] == '\0')
+			{
+				error_fatal(errors, NULL, 0, 0, "--ast-cache expects a directory");
+				return (false);
+			}
+			opts->ast_cache = argv[i] + 12;
+		}
+		else if (strcmp(argv[i], "--jobs") == 0)
+			opts->jobs = parallel_default_jobs();
+		else if (strncmp(argv[i], "--jobs=", 7) == 0)
+		{
+			char	*end;
+			long	jobs = strtol(argv[i] + 7, &end, 10);
+			if (*end != '\0' || jobs < 1 || jobs > MAX_JOBS)
+			{
+				error_fatal(errors, NULL, 0, 0,
+						"--jobs expects a count between 1 and %d", MAX_JOBS);
+				return (false);
+			}
+			opts->jobs = (size_t)jobs;
+		}
+		else
+		{
+			error_fatal(errors, NULL, 0, 0, "unknown option '%s'", argv[i]);
+			return (false);
+		}
+	}
+	// A token stream points into the whole file, which --stream never holds
+	if (opts->stream && opts->pretokenize)
+	{
+		error_fatal(errors, NULL, 0, 0,
+				"--stream cannot be combined with --pretokenize");
+		return (false);
+	}
+	// Reparsing works on the mapped text of the changed declarations
+	if (opts->watch && (opts->stream || opts->pretokenize))
+	{
+		error_fatal(errors, NULL, 0, 0,
+				"--watch cannot be combined with --stream or --pretokenize");
+		return (false);
+	}
+	// Entries are keyed by the mapped text; a session keeps its own ASTs
+	if (opts->ast_cache && (opts->stream || opts->watch))
+	{
+		error_fatal(errors, NULL, 0, 0,
+				"--ast-cache cannot be combined with --stream or --watch");
+		return (false);
+	}
+	// Bodies are parsed later from the mapped text, into the unit's own AST
+	if (opts->lazy && (opts->stream || opts->pretokenize || opts->watch
+			|| opts->ast_cache))
+	{
+		error_fatal(errors, NULL, 0, 0, "--lazy cannot be combined with "
+				"--stream, --pretokenize, --watch or --ast-cache");
+		return (false);
+	}
+	return (true);
+}
+
 bool compile_ctx_init(CompilationContext *ctx, Arena *arena, 
-		ErrorContext *errors, size_t file_count)
+		ErrorContext *errors, const CompileOptions *opts, size_t file_count,
+		CompileSession *session)
 {
+	ctx->options = *opts;
 	ctx->arena = arena;
 	ctx->errors = errors;
 	ctx->count = 0;
+	ctx->session = session;
 	if (file_count < 1)
 	{
 		error_fatal(errors, NULL, 0, 0,
@@ -36,7 +124,43 @@ bool compile_ctx_init(CompilationContext *ctx, Arena *arena,
 				"failed to allocate compilation units");
 		return (false);
 	}
-	ctx->global.function_count = 0;
+	// A session's table persists, so atoms match the ASTs it reuses
+	ctx->interns = session ? &session->interns
+		: arena_alloc(arena, sizeof(InternTable));
+	if (!ctx->interns || (!session && !intern_init(ctx->interns, arena)))
+	{
+		error_fatal(errors, NULL, 0, 0,
+				"failed to allocate identifier table");
+		return (false);
+	}
+	ctx->global = (GlobalScope){ .arena = arena };
+	ctx->calls = (CallGraph){0};
+	return (true);
+}
+
+/* Keeps fd open for parsing instead of mapping the file */
+static bool add_streamed_file(CompilationContext *ctx, const char *filepath,
+		int fd, size_t size, ResourceTracker *resources)
+{
+	if (!resource_track_fd(resources, fd))
+	{
+		error_fatal(ctx->errors, filepath, 0, 0,
+				"resource tracker full (capacity %zu)",
+				resources->capacity);
+		return (false);
+	}
+	ctx->units[ctx->count] = (CompilationUnit){
+		.file = { .name = filepath, .length = size },
+		.fd = fd,
+		.tokens = {0},
+		.ast = {0},
+		.arena = {0},
+		.cache = {0},
+		.parsed_ok = false
+	};
+	ctx->count++;
+
+	printf(BOLD_GREEN "  > LOAD SOURCE: " RESET WHITE "%s (%zu bytes, streamed)\n" RESET, filepath, size);
 	return (true);
 }
 
@@ -49,7 +173,9 @@ bool compile_ctx_add_file(CompilationContext *ctx, const char *filepath,
 		return (false);
 	}
 	FileValidation validation;
-	if (!validate_source_file(filepath, &validation, ctx->errors))
+	size_t max_size = ctx->options.stream
+		? MAX_STREAM_FILE_SIZE : MAX_SOURCE_FILE_SIZE;
+	if (!validate_source_file(filepath, &validation, max_size, ctx->errors))
 		return (false);
 
 	int fd = open(validation.canonical_path, O_RDONLY);
@@ -59,6 +185,8 @@ bool compile_ctx_add_file(CompilationContext *ctx, const char *filepath,
 				"failed to open file: %s", strerror(errno));
 		return (false);
 	}
+	if (ctx->options.stream)
+		return (add_streamed_file(ctx, filepath, fd, validation.size, resources));
 
 	FileMap file = map_input(fd);
 	if (!file.data)
@@ -78,7 +206,11 @@ bool compile_ctx_add_file(CompilationContext *ctx, const char *filepath,
 
 	ctx->units[ctx->count] = (CompilationUnit){
 		.file = file,
-		.ast = NULL,
+		.fd = -1,
+		.tokens = {0},
+		.ast = {0},
+		.arena = {0},
+		.cache = {0},
 		.parsed_ok = false
 	};
 	ctx->count++;
@@ -87,25 +219,412 @@ bool compile_ctx_add_file(CompilationContext *ctx, const char *filepath,
 	return (true);
 }
 
-bool compile_parse_all(CompilationContext *ctx)
+/* Whether the unit's AST came from --ast-cache and needs no parsing */
+static bool unit_cached(const CompilationUnit *unit)
 {
-	bool all_ok = true;
+	return (unit->cache.data != NULL);
+}
+
+/**
+ * @brief Loads the AST of every unit that has a valid --ast-cache entry
+ *
+ * Runs before anything is lexed, so a fully cached compile interns the
+ * names in the same order a parse would and the cached atoms need no
+ * rewriting.
+ */
+static bool load_cached(CompilationContext *ctx)
+{
+	for (size_t i = 0; i < ctx->count; ++i)
+	{
+		CompilationUnit *unit = &ctx->units[i];
+		if (ast_cache_load(ctx->options.ast_cache, &unit->file, ctx->interns,
+					ctx->arena, &unit->ast, &unit->cache))
+		{
+			unit->parsed_ok = true;
+			printf("  > loaded %s from the AST cache\n", unit->file.name);
+		}
+		else if (unit_cached(unit))
+		{
+			error_fatal(ctx->errors, unit->file.name, 0, 0,
+					"failed to allocate identifier table");
+			return (false);
+		}
+	}
+	return (true);
+}
+
+/* Writes a cache entry for every unit that was parsed, not loaded */
+static void store_cached(CompilationContext *ctx)
+{
+	size_t	loaded = 0;
+	size_t	stored = 0;
 
 	for (size_t i = 0; i < ctx->count; ++i)
 	{
 		CompilationUnit *unit = &ctx->units[i];
+		if (unit_cached(unit))
+			loaded++;
+		else if (ast_cache_store(ctx->options.ast_cache, &unit->file,
+					&unit->ast, ctx->arena))
+			stored++;
+		else
+			error_add(ctx->errors, ERROR_SYSTEM, ERROR_LEVEL_WARNING,
+					unit->file.name, 0, 0, "could not write AST cache entry to %s: %s",
+					ctx->options.ast_cache, strerror(errno));
+	}
+	printf("  > AST cache: %zu loaded, %zu stored\n", loaded, stored);
+}
+
+static bool tokenize_all(CompilationContext *ctx)
+{
+	for (size_t i = 0; i < ctx->count; ++i)
+	{
+		CompilationUnit *unit = &ctx->units[i];
+		if (unit_cached(unit))
+			continue;
+		if (!lexer_tokenize_parallel(&unit->file, ctx->interns, ctx->errors,
+					ctx->arena, ctx->options.jobs, &unit->tokens))
+		{
+			error_fatal(ctx->errors, unit->file.name, 0, 0,
+					"failed to build token stream");
+			return (false);
+		}
+	}
+	return (true);
+}
+
+static NodeId parse_streamed(CompilationUnit *unit, Arena *a,
+		InternTable *interns, ErrorContext *errors)
+{
+	InputStream	input;
+	Lexer		lexer;
+
+	if (!input_stream_open(&input, unit->fd, &unit->file, a))
+	{
+		error_fatal(errors, unit->file.name, 0, 0,
+				"failed to read file: %s", strerror(errno));
+		return (NODE_NONE);
+	}
+	lexer_init_stream(&lexer, &input, interns, errors);
+	NodeId root = parser_parse(&lexer, &unit->ast, errors);
+	input_stream_close(&input);
+	return (root);
+}
+
+/* Builds unit->ast in a, naming identifiers through interns */
+static NodeId parse_unit(CompilationContext *ctx, CompilationUnit *unit,
+		Arena *a, InternTable *interns, ErrorContext *errors)
+{
+	if (!ast_init(&unit->ast, a, interns, unit->file.length))
+	{
+		error_fatal(errors, unit->file.name, 0, 0,
+				"failed to allocate the AST");
+		return (NODE_NONE);
+	}
+	if (ctx->options.pretokenize)
+		return (parser_parse_stream(&unit->tokens, &unit->ast, errors));
+	if (unit->fd >= 0)
+		return (parse_streamed(unit, a, interns, errors));
+	Lexer lexer;
+	lexer_init(&lexer, &unit->file, interns, errors);
+	if (ctx->options.lazy)
+		return (parser_parse_lazy(&lexer, &unit->ast, errors));
+	return (parser_parse(&lexer, &unit->ast, errors));
+}
+
+typedef struct {
+	CompilationContext	*ctx;
+	InternTable			*interns;	// one per unit
+	ErrorContext		*errors;	// one per unit
+} ParallelParse;
+
+static void parse_unit_worker(void *arg, size_t index)
+{
+	ParallelParse	*pp = arg;
+	CompilationUnit	*unit = &pp->ctx->units[index];
+	InternTable		*interns = &pp->interns[index];
+	ErrorContext	*errors = &pp->errors[index];
+
+	if (unit_cached(unit))
+		return;
+	unit->arena = arena_init(PROT_READ | PROT_WRITE);
+	error_context_init(errors, &unit->arena);
+	// Pre-tokenized units already carry atoms of the shared table
+	if (pp->ctx->options.pretokenize)
+		interns = pp->ctx->interns;
+	else if (!intern_init(interns, &unit->arena))
+	{
+		error_fatal(errors, unit->file.name, 0, 0,
+				"failed to allocate identifier table");
+		return;
+	}
+	NodeId root = parse_unit(pp->ctx, unit, &unit->arena, interns, errors);
+	unit->parsed_ok = (root != NODE_NONE && errors->error_count == 0);
+}
+
+/**
+ * @brief Parses every unit on its own worker, each into a private arena,
+ * intern table and error list
+ *
+ * Afterwards, in file order, names move into the shared intern table and
+ * diagnostics into ctx->errors, so both come out as with a sequential
+ * parse.
+ */
+static void parse_all_parallel(CompilationContext *ctx)
+{
+	ParallelParse	pp = {
+		.ctx = ctx,
+		.interns = arena_alloc(ctx->arena, ctx->count * sizeof(InternTable)),
+		.errors = arena_alloc(ctx->arena, ctx->count * sizeof(ErrorContext))
+	};
+
+	if (!pp.interns || !pp.errors)
+	{
+		error_fatal(ctx->errors, NULL, 0, 0,
+				"failed to allocate parser workers");
+		return;
+	}
+	for (size_t i = 0; i < ctx->count; ++i)
+	{
+		if (unit_cached(&ctx->units[i]))
+		{
+			error_context_init(&pp.errors[i], ctx->arena);
+			continue;
+		}
+		ctx->units[i].parsed_ok = false;
+		printf ("  > parsing %s\n", ctx->units[i].file.name);
+	}
+	parallel_for(ctx->count, ctx->options.jobs, parse_unit_worker, &pp);
+	for (size_t i = 0; i < ctx->count; ++i)
+	{
+		CompilationUnit *unit = &ctx->units[i];
+		error_context_merge(ctx->errors, &pp.errors[i]);
+		if (unit->parsed_ok && unit->ast.interns != ctx->interns
+				&& !ast_move_atoms(&unit->ast, ctx->interns))
+		{
+			error_fatal(ctx->errors, unit->file.name, 0, 0,
+					"failed to allocate identifier table");
+			unit->parsed_ok = false;
+		}
+	}
+}
+
+/* Parses through the --watch session, which only reparses what changed */
+static void parse_all_session(CompilationContext *ctx)
+{
+	ctx->session->reused = 0;
+	ctx->session->reparsed = 0;
+	for (size_t i = 0; i < ctx->count; ++i)
+	{
+		CompilationUnit *unit = &ctx->units[i];
+		size_t errors_before = ctx->errors->error_count;
 		printf ("  > parsing %s\n", unit->file.name);
-		Lexer lexer;
-		lexer_init(&lexer, &unit->file);
-		unit->ast = parser_parse(&lexer, ctx->arena, ctx->errors);
-		unit->parsed_ok = (unit->ast != NULL);
-		if (!unit->parsed_ok)
+		NodeId root = session_parse_unit(ctx->session, unit, ctx->errors);
+		unit->parsed_ok = (root != NODE_NONE
+				&& ctx->errors->error_count == errors_before);
+	}
+	printf("  > reused %zu declaration(s), parsed %zu\n",
+			ctx->session->reused, ctx->session->reparsed);
+}
+
+bool compile_parse_all(CompilationContext *ctx)
+{
+	bool	all_ok = true;
+	size_t	errors_at_start = ctx->errors->error_count;
+
+	if (ctx->options.ast_cache && !load_cached(ctx))
+		return (false);
+	if (ctx->options.pretokenize)
+	{
+		printf("  > tokenizing %zu file(s)\n", ctx->count);
+		if (!tokenize_all(ctx))
+			return (false);
+	}
+
+	if (ctx->session)
+		parse_all_session(ctx);
+	else if (ctx->options.jobs > 1 && ctx->count > 1)
+		parse_all_parallel(ctx);
+	else
+	{
+		for (size_t i = 0; i < ctx->count; ++i)
+		{
+			CompilationUnit *unit = &ctx->units[i];
+			size_t errors_before = ctx->errors->error_count;
+			if (unit_cached(unit))
+				continue;
+			printf ("  > parsing %s\n", unit->file.name);
+			NodeId root = parse_unit(ctx, unit, ctx->arena,
+					ctx->interns, ctx->errors);
+			// Lexer and parser errors are recovered from, but the unit is not usable
+			unit->parsed_ok = (root != NODE_NONE
+					&& ctx->errors->error_count == errors_before);
+		}
+	}
+	for (size_t i = 0; i < ctx->count; ++i)
+	{
+		if (!ctx->units[i].parsed_ok)
 			all_ok = false;
 	}
+	// Catches lexer errors raised while pre-tokenizing, too
+	if (ctx->errors->error_count != errors_at_start)
+		all_ok = false;
+	// Only clean compiles are cached, so a hit never hides a diagnostic
+	if (all_ok && ctx->options.ast_cache)
+		store_cached(ctx);
+	return (all_ok);
+}
+
+/**
+ * @return the unit file belongs to, or NULL
+ */
+CompilationUnit *compile_unit_of(CompilationContext *ctx, const FileMap *file)
+{
+	for (size_t i = 0; i < ctx->count; ++i)
+	{
+		if (&ctx->units[i].file == file)
+			return (&ctx->units[i]);
+	}
+	return (NULL);
+}
+
+typedef struct {
+	CompilationUnit	*unit;
+	NodeId			func;
+} BodyRef;
+
+/* What a semantic worker keeps from one batch to the next */
+typedef struct {
+	Arena		arena;
+	ScopeTable	scopes;
+} SemanticWorker;
+
+typedef struct {
+	CompilationContext	*ctx;
+	BodyRef				*bodies;
+	size_t				count;
+	SemanticWorker		*workers;	// one per thread
+	ErrorContext		*errors;	// one per batch
+	bool				*ok;		// one per batch
+} ParallelAnalysis;
+
+static void analyze_batch(void *arg, size_t worker, size_t batch)
+{
+	ParallelAnalysis	*pa = arg;
+	SemanticWorker		*w = &pa->workers[worker];
+	size_t				end = (batch + 1) * SEMANTIC_BATCH_SIZE;
+
+	if (end > pa->count)
+		end = pa->count;
+	error_context_init(&pa->errors[batch], &w->arena);
+	pa->ok[batch] = true;
+	for (size_t i = batch * SEMANTIC_BATCH_SIZE; i < end; ++i)
+	{
+		BodyRef *body = &pa->bodies[i];
+		if (!semantic_analyze_function(&w->arena, &w->scopes, body->unit,
+					&body->unit->ast, body->func, &pa->errors[batch],
+					&pa->ctx->global))
+			pa->ok[batch] = false;
+	}
+}
+
+/* Lists the function definitions of every parsed unit, in file order */
+static size_t	collect_bodies(CompilationContext *ctx, BodyRef *bodies)
+{
+	size_t	count = 0;
+
+	for (size_t i = 0; i < ctx->count; ++i)
+	{
+		CompilationUnit *unit = &ctx->units[i];
+		if (!unit->parsed_ok)
+			continue;
+		uint32_t		n;
+		const NodeId	*decls = ast_list(&unit->ast, unit->ast.root, &n);
+		for (uint32_t j = 0; j < n; ++j)
+		{
+			if (ast_type(&unit->ast, decls[j]) != AST_FUNCTION
+					|| ast_function(&unit->ast, decls[j]).is_prototype)
+				continue;
+			if (bodies)
+				bodies[count] = (BodyRef){ .unit = unit, .func = decls[j] };
+			count++;
+		}
+	}
+	return (count);
+}
+
+/**
+ * @brief Analyzes every function body on the worker threads
+ *
+ * Bodies are cut into batches of SEMANTIC_BATCH_SIZE in file order, each
+ * with its own error list, and a worker analyzes with an arena and scope
+ * table of its own. Merging the lists in batch order gives the diagnostics
+ * of a sequential pass, whichever thread took which batch.
+ */
+static bool analyze_all_parallel(CompilationContext *ctx)
+{
+	size_t				count = collect_bodies(ctx, NULL);
+	size_t				batches = (count + SEMANTIC_BATCH_SIZE - 1) / SEMANTIC_BATCH_SIZE;
+	size_t				jobs = ctx->options.jobs;
+	ParallelAnalysis	pa = {
+		.ctx = ctx,
+		.count = count,
+		.bodies = arena_alloc(ctx->arena, (count + 1) * sizeof(BodyRef)),
+		.workers = arena_alloc_zeroed(ctx->arena, jobs * sizeof(SemanticWorker)),
+		.errors = arena_alloc(ctx->arena, (batches + 1) * sizeof(ErrorContext)),
+		.ok = arena_alloc(ctx->arena, batches + 1)
+	};
+	bool				all_ok = true;
 
+	if (!pa.bodies || !pa.workers || !pa.errors || !pa.ok)
+	{
+		error_fatal(ctx->errors, NULL, 0, 0,
+				"failed to allocate semantic workers");
+		return (false);
+	}
+	for (size_t i = 0; i < ctx->count; ++i)
+	{
+		CompilationUnit *unit = &ctx->units[i];
+		if (!unit->parsed_ok)
+			continue;
+		printf("%4zu | %s\n", i, unit->file.name);
+		if (!semantic_prepare_unit(unit, ctx->errors, &ctx->global))
+			return (false);
+	}
+	collect_bodies(ctx, pa.bodies);
+	for (size_t i = 0; i < jobs; ++i)
+		pa.workers[i].arena = arena_init(PROT_READ | PROT_WRITE);
+	parallel_for_workers(batches, jobs, analyze_batch, &pa);
+	for (size_t i = 0; i < batches; ++i)
+	{
+		error_context_merge(ctx->errors, &pa.errors[i]);
+		if (!pa.ok[i])
+			all_ok = false;
+	}
+	for (size_t i = 0; i < jobs; ++i)
+		arena_free(&pa.workers[i].arena);
 	return (all_ok);
 }
 
+/*
+ * Builds ctx->calls, with the effects of each call, and marks what main
+ * reaches, which is what jit_compile_pass compiles. Without main nothing
+ * is, and running the program reports it missing.
+ */
+static bool	build_call_graph(CompilationContext *ctx)
+{
+	FunctionInfo	*entry = semantic_global_lookup_function(&ctx->global,
+			intern_find(ctx->interns, "main", 4));
+
+	if (!call_graph_build(&ctx->calls, ctx->arena, &ctx->global,
+				ctx->units, ctx->count, ctx->errors)
+			|| !call_graph_find_effects(&ctx->calls, ctx->arena, ctx->errors))
+		return (false);
+	return (call_graph_mark_reachable(&ctx->calls, ctx->arena,
+				entry ? (uint32_t)(entry - ctx->global.functions) : UINT32_MAX,
+				ctx->errors));
+}
+
 bool compile_analyze_all(CompilationContext *ctx)
 {
 	bool all_ok = true;
@@ -116,49 +635,83 @@ bool compile_analyze_all(CompilationContext *ctx)
 		CompilationUnit *unit = &ctx->units[i];
 		if (!unit->parsed_ok)
 			continue;
-		for (size_t j = 0; j < unit->ast->translation_unit.count; ++j)
+		uint32_t		count;
+		const NodeId	*decls = ast_list(&unit->ast, unit->ast.root, &count);
+		for (size_t j = 0; j < count; ++j)
 		{
-			ASTNode *func = unit->ast->translation_unit.declarations[j];
-			if (func->type == AST_FUNCTION)
+			if (ast_type(&unit->ast, decls[j]) == AST_FUNCTION)
 			{
 				if (!semantic_global_declare_function(&ctx->global, 
-							ctx->errors, func, unit->file.name))
+							ctx->errors, &unit->ast, decls[j], &unit->file))
 					all_ok = false;
 			}
 		}
 	}
 	if (!all_ok)
 		return (false);
-	
-	printf("  > analyzing function bodies\n");
-	for (size_t i = 0; i < ctx->count; ++i)
+	// Lazy bodies are parsed and analyzed one by one by jit_compile_pass
+	if (ctx->options.lazy)
+		return (true);
+	// Under --fused, jit_compile_pass checks each body as it generates its IR
+	if (!ctx->options.fused)
 	{
-		CompilationUnit *unit = &ctx->units[i];
-		if (!unit->parsed_ok || !unit->ast)
-			continue;
-		printf("%4zu | %s\n", i, unit->file.name);
-		if (!semantic_analyze(ctx->arena, unit, ctx->errors, &ctx->global))
-			all_ok = false;
+		printf("  > analyzing function bodies\n");
+		if (ctx->options.jobs > 1)
+			all_ok = analyze_all_parallel(ctx);
+		else for (size_t i = 0; i < ctx->count; ++i)
+		{
+			CompilationUnit *unit = &ctx->units[i];
+			if (!unit->parsed_ok)
+				continue;
+			printf("%4zu | %s\n", i, unit->file.name);
+			if (!semantic_analyze(ctx->arena, unit, ctx->errors, &ctx->global))
+				all_ok = false;
+		}
+		if (!all_ok)
+			return (false);
 	}
-
-	return (all_ok);
+	return (build_call_graph(ctx));
 }
 
-ASTNode *compile_get_entry_point(CompilationContext *ctx)
+/**
+ * @brief Finds main() across all units
+ *
+ * @param unit receives the unit whose AST the returned node belongs to
+ */
+NodeId compile_get_entry_point(CompilationContext *ctx, CompilationUnit **unit)
 {
 	for (size_t i = 0; i < ctx->count; ++i)
 	{
-		CompilationUnit *unit = &ctx->units[i];
-		if (!unit->ast || !unit->parsed_ok)
+		CompilationUnit *u = &ctx->units[i];
+		if (!u->parsed_ok)
 			continue;
-		for (size_t j = 0; j < unit->ast->translation_unit.count; ++j)
+		uint32_t		count;
+		const NodeId	*decls = ast_list(&u->ast, u->ast.root, &count);
+		for (size_t j = 0; j < count; ++j)
 		{
-			ASTNode *func = unit->ast->translation_unit.declarations[j];
-			if (func->type == AST_FUNCTION && sv_eq_cstr(func->function.name, "main"))
-				return (func);
+			ASTNode *func = ast_node(&u->ast, decls[j]);
+			if (func->type == AST_FUNCTION
+					&& sv_eq_cstr(ast_name(&u->ast, func->lhs), "main"))
+			{
+				*unit = u;
+				return (decls[j]);
+			}
 		}
 	}
 
 	error_fatal(ctx->errors, NULL, 0, 0, "no main() function found");
-	return (NULL);
+	return (NODE_NONE);
+}
+
+/**
+ * @brief Releases the arenas of units parsed on worker threads and the
+ * mappings of units loaded from the AST cache
+ */
+void compile_ctx_free(CompilationContext *ctx)
+{
+	for (size_t i = 0; i < ctx->count; ++i)
+	{
+		arena_free(&ctx->units[i].arena);
+		ast_cache_release(&ctx->units[i].cache);
+	}
 }
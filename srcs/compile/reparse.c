@@ -0,0 +1,338 @@
+/**
+ * @file
+ * @brief Incremental reparsing for --watch
+ *
+ * Every file remembers the byte range, content hash and subtree of each
+ * top-level declaration from its last clean parse. On the next compile the
+ * ranges are checked from the front at their old offsets and from the back
+ * at offsets shifted by the change in file size; the matching ones are
+ * copied into the new AST with ast_copy_subtree, value types from the last
+ * semantic pass included. Only the bytes between the last front match and
+ * the first back match are lexed and parsed again, so a one-line edit
+ * costs the parse of the function it is in.
+ *
+ * The parts are lexed separately, which only gives the whole-file result
+ * if each cut sits between tokens. Front matches start where the old file
+ * had a declaration, after identical text, so they do. A cut before a back
+ * match must follow a newline, or an open line comment or a name could
+ * run into the declaration, and must not sit inside a block comment, which
+ * the lexer lets run to the end of its input. Anything the reparsed window
+ * reports sends the file through a full parse, which then produces the
+ * diagnostics.
+ */
+
+#include "session.h"
+#include "lexer.h"
+#include "parser.h"
+
+static uint64_t	range_hash(const char *s, size_t len)
+{
+	uint64_t	hash = 14695981039346656037ull;
+
+	for (size_t i = 0; i < len; ++i)
+	{
+		hash ^= (uint8_t)s[i];
+		hash *= 1099511628211ull;
+	}
+	return (hash);
+}
+
+static ReparseEntry	*find_entry(CompileSession *s, const char *path)
+{
+	for (size_t i = 0; i < s->entry_count; ++i)
+	{
+		if (strcmp(s->entries[i].path, path) == 0)
+			return (&s->entries[i]);
+	}
+	if (s->entry_count >= MAX_SOURCE_FILES)
+		return (NULL);
+	ReparseEntry *e = &s->entries[s->entry_count++];
+	*e = (ReparseEntry){ .path = path };
+	e->arenas[0] = arena_init(PROT_READ | PROT_WRITE);
+	e->arenas[1] = arena_init(PROT_READ | PROT_WRITE);
+	return (e);
+}
+
+/* Empties the arena not holding the current AST and returns it */
+static Arena	*spare_arena(ReparseEntry *e)
+{
+	Arena *a = &e->arenas[!e->current];
+
+	arena_free(a);
+	*a = arena_init(PROT_READ | PROT_WRITE);
+	return (a);
+}
+
+/* Makes ast and decls, built in the spare arena, the entry's current state */
+static void	install(ReparseEntry *e, const Ast *ast, ReparseDecl *decls,
+				uint32_t count, uint32_t length)
+{
+	arena_free(&e->arenas[e->current]);
+	e->current = !e->current;
+	e->ast = *ast;
+	e->decls = decls;
+	e->decl_count = count;
+	e->length = length;
+	e->valid = true;
+}
+
+/*
+ * Sets the ranges of decls from their starts. A decl with a non-zero
+ * length was carried over and keeps its hash if its range is unchanged.
+ */
+static void	finish_ranges(ReparseDecl *decls, uint32_t count, const FileMap *file)
+{
+	if (count > 0 && decls[0].start != 0)
+	{
+		decls[0].start = 0;
+		decls[0].length = 0;
+	}
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint32_t end = i + 1 < count ? decls[i + 1].start : (uint32_t)file->length;
+		uint32_t length = end - decls[i].start;
+		if (decls[i].length != length)
+		{
+			decls[i].length = length;
+			decls[i].hash = range_hash(file->data + decls[i].start, length);
+		}
+	}
+}
+
+/* Appends the declarations of a freshly parsed translation unit */
+static uint32_t	add_parsed(ReparseDecl *decls, uint32_t count, const Ast *ast,
+					NodeId tu, NodeId first)
+{
+	uint32_t		n;
+	const NodeId	*list = ast_list(ast, tu, &n);
+
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		decls[count++] = (ReparseDecl){
+			.start = ast_function(ast, list[i]).start,
+			.first = first,
+			.root = list[i]
+		};
+		first = list[i] + 1;
+	}
+	return (count);
+}
+
+static NodeId	parse_full(CompileSession *s, ReparseEntry *e,
+					CompilationUnit *unit, ErrorContext *errors)
+{
+	Arena	*a = spare_arena(e);
+	size_t	errors_before = errors->error_count + errors->warning_count;
+	Ast		ast;
+	Lexer	lexer;
+
+	if (!ast_init(&ast, a, &s->interns, unit->file.length))
+	{
+		error_fatal(errors, unit->file.name, 0, 0, "failed to allocate the AST");
+		return (NODE_NONE);
+	}
+	lexer_init(&lexer, &unit->file, &s->interns, errors);
+	NodeId root = parser_parse(&lexer, &ast, errors);
+	// A file with diagnostics is not cached; the last clean parse stays
+	if (root == NODE_NONE
+			|| errors->error_count + errors->warning_count != errors_before)
+	{
+		unit->ast = ast;
+		return (root);
+	}
+	uint32_t	count = ast_node(&ast, root)->rhs;
+	ReparseDecl	*decls = arena_alloc(a, (count + 1) * sizeof(ReparseDecl));
+	if (!decls)
+	{
+		unit->ast = ast;
+		return (root);
+	}
+	count = add_parsed(decls, 0, &ast, root, 1);
+	finish_ranges(decls, count, &unit->file);
+	install(e, &ast, decls, count, (uint32_t)unit->file.length);
+	s->reparsed += count;
+	unit->ast = e->ast;
+	return (root);
+}
+
+/* Does old decl d appear at its old offset moved by delta? */
+static bool	range_matches(const ReparseDecl *d, const FileMap *file, int64_t delta)
+{
+	int64_t start = (int64_t)d->start + delta;
+
+	if (start < 0 || start + d->length > (int64_t)file->length)
+		return (false);
+	return (range_hash(file->data + start, d->length) == d->hash);
+}
+
+static bool	cut_after_newline(const FileMap *file, int64_t at)
+{
+	return (at == 0 || at == (int64_t)file->length || file->data[at - 1] == '\n');
+}
+
+/*
+ * Whether [p, end) leaves a block comment open. Without string literals,
+ * a slash-star outside a comment always opens one, and "//" or '#' a line
+ * the lexer skips.
+ */
+static bool	ends_in_comment(const char *p, const char *end)
+{
+	while (p < end)
+	{
+		if (*p == '#' || (*p == '/' && p + 1 < end && p[1] == '/'))
+		{
+			p = memchr(p, '\n', end - p);
+			if (!p)
+				return (false);
+		}
+		else if (*p == '/' && p + 1 < end && p[1] == '*')
+		{
+			p += 2;
+			while (p + 1 < end && !(p[0] == '*' && p[1] == '/'))
+				p++;
+			if (p + 1 >= end)
+				return (true);
+			p++;
+		}
+		p++;
+	}
+	return (false);
+}
+
+static bool	copy_decls(Ast *dst, const ReparseEntry *e, uint32_t from,
+				uint32_t to, int64_t delta, ReparseDecl *out, uint32_t *count)
+{
+	for (uint32_t i = from; i < to; ++i)
+	{
+		const ReparseDecl	*d = &e->decls[i];
+		NodeId				first = dst->node_count;
+		NodeId				root = ast_copy_subtree(dst, &e->ast, d->first, d->root, delta);
+
+		if (root == NODE_NONE)
+			return (false);
+		out[(*count)++] = (ReparseDecl){
+			.start = (uint32_t)(d->start + delta),
+			.length = d->length,
+			.hash = d->hash,
+			.first = first,
+			.root = root
+		};
+	}
+	return (true);
+}
+
+/*
+ * Rebuilds the unit's AST from e, parsing only what changed. Returns
+ * NODE_NONE when that is not possible and a full parse is needed.
+ */
+static NodeId	parse_changed(CompileSession *s, ReparseEntry *e,
+					CompilationUnit *unit)
+{
+	const FileMap	*file = &unit->file;
+	uint32_t		k = e->decl_count;
+	int64_t			delta = (int64_t)file->length - e->length;
+	uint32_t		front = 0;
+	uint32_t		back = k;
+
+	while (front < k && range_matches(&e->decls[front], file, 0))
+		front++;
+	if (front == k && delta == 0)
+	{
+		s->reused += k;
+		unit->ast = e->ast;
+		return (e->ast.root);
+	}
+	// The last range may end in a comment that new text would extend
+	if (front == k && (!cut_after_newline(file, e->length)
+			|| ends_in_comment(file->data + e->decls[k - 1].start,
+				file->data + e->length)))
+		front--;
+	int64_t a = front < k ? e->decls[front].start : e->length;
+	while (back > front && e->decls[back - 1].start + delta >= a
+			&& range_matches(&e->decls[back - 1], file, delta))
+		back--;
+	while (back < k && !cut_after_newline(file, e->decls[back].start + delta))
+		back++;
+	int64_t b = back < k ? e->decls[back].start + delta : (int64_t)file->length;
+	if (back < k && ends_in_comment(file->data + a, file->data + b))
+		return (NODE_NONE);
+
+	Arena		*arena = spare_arena(e);
+	Ast			ast;
+	ErrorContext window_errors;
+	uint32_t	count = 0;
+	ReparseDecl	*decls = arena_alloc(arena, (front + 1) * sizeof(ReparseDecl));
+	if (!decls || !ast_init(&ast, arena, &s->interns, file->length)
+			|| !copy_decls(&ast, e, 0, front, 0, decls, &count))
+		return (NODE_NONE);
+
+	Lexer lexer;
+	error_context_init(&window_errors, arena);
+	lexer_init(&lexer, &unit->file, &s->interns, &window_errors);
+	lexer.start = file->data + a;
+	lexer.curr = lexer.start;
+	lexer.end = file->data + b;
+	NodeId first = ast.node_count;
+	NodeId window = parser_parse(&lexer, &ast, &window_errors);
+	if (window == NODE_NONE || window_errors.head)
+		return (NODE_NONE);
+	uint32_t parsed = ast_node(&ast, window)->rhs;
+	// The window's declarations are only counted once it is parsed
+	ReparseDecl *all = arena_alloc(arena,
+			((size_t)count + parsed + (k - back) + 1) * sizeof(ReparseDecl));
+	if (!all)
+		return (NODE_NONE);
+	memcpy(all, decls, count * sizeof(ReparseDecl));
+	decls = all;
+	count = add_parsed(decls, count, &ast, window, first);
+
+	if (!copy_decls(&ast, e, back, k, delta, decls, &count))
+		return (NODE_NONE);
+	uint32_t *roots = arena_alloc(arena, (count + 1) * sizeof(uint32_t));
+	if (!roots)
+		return (NODE_NONE);
+	for (uint32_t i = 0; i < count; ++i)
+		roots[i] = decls[i].root;
+	uint32_t list = ast_add_extra(&ast, roots, count);
+	if (list == UINT32_MAX)
+		return (NODE_NONE);
+	ast.root = ast_add_node(&ast, (ASTNode){
+		.type = AST_TRANSLATION_UNIT,
+		.lhs = list,
+		.rhs = count
+	});
+	if (ast.root == NODE_NONE)
+		return (NODE_NONE);
+	finish_ranges(decls, count, file);
+	install(e, &ast, decls, count, (uint32_t)file->length);
+	s->reused += count - parsed;
+	s->reparsed += parsed;
+	unit->ast = e->ast;
+	return (ast.root);
+}
+
+/**
+ * @brief Parses unit, reusing whatever the last compile of the file left
+ *
+ * unit->ast ends up in the session's own arenas and names resolve through
+ * s->interns.
+ */
+NodeId	session_parse_unit(CompileSession *s, CompilationUnit *unit,
+			ErrorContext *errors)
+{
+	ReparseEntry *e = find_entry(s, unit->file.name);
+
+	if (!e)
+	{
+		error_fatal(errors, unit->file.name, 0, 0,
+				"internal error: too many files in the session");
+		return (NODE_NONE);
+	}
+	if (e->valid && e->decl_count > 0 && unit->file.length < UINT32_MAX)
+	{
+		NodeId root = parse_changed(s, e, unit);
+		if (root != NODE_NONE)
+			return (root);
+	}
+	return (parse_full(s, e, unit, errors));
+}
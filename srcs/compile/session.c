@@ -0,0 +1,110 @@
+/**
+ * @file
+ * @brief --watch: recompile whenever an input file changes
+ *
+ * The session outlives the per-compile arenas. It holds the intern table,
+ * whose names are copied since each compile maps the files anew, and the
+ * per-file state reparse.c reuses. Changes are found by polling stat(2),
+ * which needs nothing platform specific and costs a few syscalls per
+ * WATCH_POLL_MS.
+ */
+
+#include "session.h"
+#include "layout.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+void	session_init(CompileSession *s)
+{
+	memset(s, 0, sizeof(*s));
+	s->arena = arena_init(PROT_READ | PROT_WRITE);
+}
+
+void	session_free(CompileSession *s)
+{
+	for (size_t i = 0; i < s->entry_count; ++i)
+	{
+		arena_free(&s->entries[i].arenas[0]);
+		arena_free(&s->entries[i].arenas[1]);
+	}
+	arena_free(&s->arena);
+	s->entry_count = 0;
+}
+
+/**
+ * @brief Sets up the intern table, once the first compile asks for --watch
+ */
+bool	session_start(CompileSession *s)
+{
+	if (s->watch)
+		return (true);
+	if (!intern_init(&s->interns, &s->arena))
+		return (false);
+	s->interns.copy_all = true;
+	s->watch = true;
+	return (true);
+}
+
+static WatchStamp	stamp_file(const char *path)
+{
+	struct stat	st;
+
+	if (stat(path, &st) != 0)
+		return ((WatchStamp){ .exists = false });
+#ifdef __APPLE__
+	return ((WatchStamp){ true, st.st_size, st.st_mtimespec });
+#else
+	return ((WatchStamp){ true, st.st_size, st.st_mtim });
+#endif
+}
+
+static bool	stamp_equal(WatchStamp a, WatchStamp b)
+{
+	return (a.exists == b.exists && a.size == b.size
+		&& a.mtime.tv_sec == b.mtime.tv_sec
+		&& a.mtime.tv_nsec == b.mtime.tv_nsec);
+}
+
+/**
+ * @brief Records the state of every input file, before it is read
+ */
+void	session_stamp_files(CompileSession *s, int argc, char **argv)
+{
+	size_t n = 0;
+
+	for (int i = 1; i < argc && n < MAX_SOURCE_FILES; ++i)
+	{
+		if (strncmp(argv[i], "--", 2) != 0)
+			s->stamps[n++] = stamp_file(argv[i]);
+	}
+}
+
+/**
+ * @brief Blocks until an input file differs from its last stamp
+ */
+void	session_wait_for_change(CompileSession *s, int argc, char **argv)
+{
+	const struct timespec	poll = {
+		.tv_sec = WATCH_POLL_MS / 1000,
+		.tv_nsec = (WATCH_POLL_MS % 1000) * 1000000L
+	};
+
+	printf(BOLD_GREEN "\n  > WATCHING: " RESET WHITE
+			"waiting for changes (Ctrl-C to stop)\n" RESET);
+	fflush(stdout);
+	while (true)
+	{
+		size_t n = 0;
+		nanosleep(&poll, NULL);
+		for (int i = 1; i < argc && n < MAX_SOURCE_FILES; ++i)
+		{
+			if (strncmp(argv[i], "--", 2) != 0
+					&& !stamp_equal(s->stamps[n++], stamp_file(argv[i])))
+			{
+				printf(BOLD_GREEN "  > CHANGED: " RESET WHITE "%s\n\n" RESET, argv[i]);
+				return;
+			}
+		}
+	}
+}
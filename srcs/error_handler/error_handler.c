@@ -33,27 +33,21 @@ void	error_context_init(ErrorContext *ctx, Arena *arena)
 	ctx->arena = arena;
 }
 
-void error_add(ErrorContext *ctx, ErrorCategory category, ErrorLevel level,
-				const char *filename, int line, int column,
-				const char *fmt, ...)
+static ErrorNode	*error_push(ErrorContext *ctx, ErrorCategory category,
+				ErrorLevel level, const char *fmt, va_list args)
 {
-	va_list	args;
-	va_start(args, fmt);
 	char buffer[1024];
 	vsnprintf(buffer, sizeof(buffer), fmt, args);
-	va_end(args);
 
 	size_t len = strlen(buffer);
 	char *msg = arena_alloc(ctx->arena, len + 1);
 	memcpy(msg, buffer, len + 1);
 	ErrorNode *node = arena_alloc(ctx->arena, sizeof(ErrorNode));
-	node->category = category;
-	node->level = level;
-	node->message = msg;
-	node->filename = filename;
-	node->line = line;
-	node->column = column;
-	node->next = NULL;
+	*node = (ErrorNode){
+		.category = category,
+		.level = level,
+		.message = msg
+	};
 
 	if (ctx->tail)
 	{
@@ -67,6 +61,68 @@ void error_add(ErrorContext *ctx, ErrorCategory category, ErrorLevel level,
 		ctx->warning_count++;
 	else
 		ctx->error_count++;
+	return (node);
+}
+
+static ErrorNode	*error_pushf(ErrorContext *ctx, ErrorCategory category,
+				ErrorLevel level, const char *fmt, ...)
+{
+	va_list	args;
+	va_start(args, fmt);
+	ErrorNode *node = error_push(ctx, category, level, fmt, args);
+	va_end(args);
+	return (node);
+}
+
+/**
+ * @brief Appends copies of src's diagnostics to dst, keeping their order
+ *
+ * For contexts filled on worker threads; src's arena may be freed after.
+ */
+void	error_context_merge(ErrorContext *dst, const ErrorContext *src)
+{
+	for (ErrorNode *curr = src->head; curr; curr = curr->next)
+	{
+		ErrorNode *node = error_pushf(dst, curr->category, curr->level,
+				"%s", curr->message);
+		node->filename = curr->filename;
+		node->line = curr->line;
+		node->column = curr->column;
+		node->file = curr->file;
+		node->offset = curr->offset;
+	}
+}
+
+void error_add(ErrorContext *ctx, ErrorCategory category, ErrorLevel level,
+				const char *filename, int line, int column,
+				const char *fmt, ...)
+{
+	va_list	args;
+	va_start(args, fmt);
+	ErrorNode *node = error_push(ctx, category, level, fmt, args);
+	va_end(args);
+
+	node->filename = filename;
+	node->line = line;
+	node->column = column;
+}
+
+/**
+ * @brief Adds a diagnostic anchored at a byte offset of file
+ *
+ * The line and column are left unresolved until error_print_all.
+ */
+void error_add_at(ErrorContext *ctx, ErrorCategory category, ErrorLevel level,
+				FileMap *file, uint32_t offset, const char *fmt, ...)
+{
+	va_list	args;
+	va_start(args, fmt);
+	ErrorNode *node = error_push(ctx, category, level, fmt, args);
+	va_end(args);
+
+	node->filename = file ? file->name : NULL;
+	node->file = file;
+	node->offset = offset;
 }
 
 bool	error_has_warnings(ErrorContext *ctx)
@@ -111,6 +167,12 @@ void	error_print_all(ErrorContext *ctx)
 	{
 		const char	*color = level_colors[curr->level];
 		const char	*level_name = level_names[curr->level];
+		if (curr->file)
+		{
+			SourcePos pos = file_map_position(curr->file, ctx->arena, curr->offset);
+			curr->line = pos.line;
+			curr->column = pos.column;
+		}
 		if (curr->filename)
 		{
 			fprintf(stderr, "%s%s:%d:%d: %s[%s]%s %s\n" RESET, BOLD_WHITE,
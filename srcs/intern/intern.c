@@ -0,0 +1,134 @@
+/**
+ * @file
+ * @brief Identifier intern table
+ *
+ * The lexer interns every identifier once; the hash is computed there and
+ * cached in the entry. Later phases compare the resulting atoms as plain
+ * integers. Entry text points into the source mapping, which outlives
+ * the compilation, or into the arena for names interned with intern_copy.
+ */
+
+#include "intern.h"
+
+#define INTERN_INITIAL_CAPACITY	256
+
+static inline uint32_t	intern_hash(const char *s, size_t len)
+{
+	uint32_t	hash = 2166136261u;
+
+	for (size_t i = 0; i < len; ++i)
+	{
+		hash ^= (uint8_t)s[i];
+		hash *= 16777619;
+	}
+	return (hash);
+}
+
+static bool	intern_grow(InternTable *t)
+{
+	uint32_t	capacity = t->capacity ? t->capacity * 2 : INTERN_INITIAL_CAPACITY;
+	uint32_t	slot_count = capacity * 2;
+	InternEntry	*entries = arena_alloc(t->arena, capacity * sizeof(InternEntry));
+	Atom		*slots = arena_alloc_zeroed(t->arena, slot_count * sizeof(Atom));
+
+	if (!entries || !slots)
+		return (false);
+	if (t->count > 0)
+		memcpy(entries, t->entries, t->count * sizeof(InternEntry));
+	// Slot table is kept at most half full, rehash from the cached hashes
+	for (Atom atom = 1; atom < t->count; ++atom)
+	{
+		uint32_t idx = entries[atom].hash & (slot_count - 1);
+		while (slots[idx] != ATOM_NONE)
+			idx = (idx + 1) & (slot_count - 1);
+		slots[idx] = atom;
+	}
+	t->entries = entries;
+	t->slots = slots;
+	t->capacity = capacity;
+	t->slot_mask = slot_count - 1;
+	return (true);
+}
+
+bool	intern_init(InternTable *t, Arena *a)
+{
+	*t = (InternTable){ .arena = a };
+	if (!intern_grow(t))
+		return (false);
+	// Atom 0 is reserved for ATOM_NONE
+	t->entries[0] = (InternEntry){0};
+	t->count = 1;
+	return (true);
+}
+
+static uint32_t	intern_probe(const InternTable *t, const char *s, size_t len,
+					uint32_t hash)
+{
+	uint32_t idx = hash & t->slot_mask;
+
+	while (t->slots[idx] != ATOM_NONE)
+	{
+		const InternEntry *e = &t->entries[t->slots[idx]];
+		if (e->hash == hash && e->len == len && memcmp(e->start, s, len) == 0)
+			break;
+		idx = (idx + 1) & t->slot_mask;
+	}
+	return (idx);
+}
+
+static Atom	intern_insert(InternTable *t, const char *s, size_t len, bool copy)
+{
+	uint32_t hash = intern_hash(s, len);
+	uint32_t idx = intern_probe(t, s, len, hash);
+
+	if (t->slots[idx] != ATOM_NONE)
+		return (t->slots[idx]);
+	if (t->count >= t->capacity)
+	{
+		if (!intern_grow(t))
+			return (ATOM_NONE);
+		idx = intern_probe(t, s, len, hash);
+	}
+	if (copy || t->copy_all)
+	{
+		char *text = arena_alloc(t->arena, len);
+		if (!text)
+			return (ATOM_NONE);
+		memcpy(text, s, len);
+		s = text;
+	}
+	Atom atom = t->count++;
+	t->entries[atom] = (InternEntry){ s, (uint32_t)len, hash };
+	t->slots[idx] = atom;
+	return (atom);
+}
+
+/**
+ * @brief Returns the atom for s, adding it to the table if it is new
+ *
+ * @return the atom, or ATOM_NONE on allocation failure
+ */
+Atom	intern(InternTable *t, const char *s, size_t len)
+{
+	return (intern_insert(t, s, len, false));
+}
+
+/**
+ * @brief Like intern, but a new entry gets its own copy of the text
+ *
+ * For text that does not outlive the call, such as a streaming read window.
+ */
+Atom	intern_copy(InternTable *t, const char *s, size_t len)
+{
+	return (intern_insert(t, s, len, true));
+}
+
+/**
+ * @brief Looks s up without adding it
+ *
+ * @return the atom, or ATOM_NONE if s was never interned
+ */
+Atom	intern_find(const InternTable *t, const char *s, size_t len)
+{
+	return (t->slots[intern_probe(t, s, len, intern_hash(s, len))]);
+}
@@ -2,13 +2,15 @@
 #include "defines.h"
 #include "error_handler.h"
 #include "ir.h"
+#include "semantic.h"
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 
 static size_t	gen_expression(Arena *a, IRFunction *f,
-		ASTNode *node, SymbolTable *symbol_table);
+		NodeId id);
 static void		gen_statement(Arena *a, IRFunction *f, 
-		ASTNode *node, SymbolTable *symbol_table, size_t *last_reg);
+		NodeId id, size_t *last_reg);
 
 
 static void emit(Arena *a, IRFunction *f, IRInstruction inst)
@@ -32,35 +34,51 @@ static void emit(Arena *a, IRFunction *f, IRInstruction inst)
 	f->total_count++;
 }
 
-static size_t gen_number(Arena *a, IRFunction *f, ASTNode *node)
+/*
+ * Under ir_gen_fused, semantic_leave for id once its children are
+ * generated. It types id, so it runs before id's own instructions.
+ */
+static inline void	check_node(IRFunction *f, NodeId id)
 {
+	if (f->sa)
+		f->checked = semantic_leave(f->sa, id, f->checked);
+}
+
+static size_t gen_number(Arena *a, IRFunction *f, NodeId id)
+{
+	const ASTNode	*node = ast_node(f->ast, id);
 	size_t reg;
+
+	check_node(f, id);
 	if (!ir_alloc_vreg(f, &reg))
 		return (0);
 
-	int64_t val = sv_to_int64(a, node->number.value);
 	IRInstruction inst = { 
 		.opcode = IR_CONST, 
 		.type = node->value_type,
 		.dest = reg, 
-		.imm = val
+		.imm = ast_number(node)
 	};
 	emit(a, f, inst);
 	return (reg);
 }
 
-static size_t gen_identifier(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *symbol_table)
+/* Parameters stay in the vregs they arrive in, locals get stack slots */
+static inline size_t	var_location(const IRFunction *f, uint32_t var, bool *is_stack)
 {
-	Symbol *sym = symbol_table_lookup(symbol_table, node->identifier.name);
-	if (!sym)
-	{
-		error_add(f->errors, ERROR_CODEGEN, ERROR_LEVEL_ERROR,
-				f->filename, node->line, node->column,
-				"undefined variable '%.*s'",
-				(int)node->identifier.name.len, node->identifier.name.start);
-		return (0);
-	}
-	if (sym->is_stack)
+	*is_stack = (var >= f->param_count);
+	return (*is_stack ? var - f->param_count : var + 1);
+}
+
+static size_t gen_identifier(Arena *a, IRFunction *f, NodeId id)
+{
+	const ASTNode	*node = ast_node(f->ast, id);
+	bool			is_stack;
+	size_t			location;
+
+	check_node(f, id);
+	location = var_location(f, node->rhs, &is_stack);
+	if (is_stack)
 	{
 		size_t	temp_reg;
 		if (!ir_alloc_vreg(f, &temp_reg))
@@ -69,30 +87,95 @@ static size_t gen_identifier(Arena *a, IRFunction *f, ASTNode *node, SymbolTable
 			.opcode = IR_LOAD,
 			.type = node->value_type,
 			.dest = temp_reg,
-			.src_1 = sym->index
+			.src_1 = location
 		};
 		emit(a, f, load);
 		return (temp_reg);
 	}
-	return (sym->index);
+	return (location);
 }
 
-static size_t gen_call(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *symbol_table)
+/*
+*	How gen_expression handles a node: what its operands are and what it
+*	emits once they are generated.
+*/
+typedef enum {
+	GEN_LEAF,
+	GEN_CALL,
+	GEN_UNARY,
+	GEN_BINARY,
+	GEN_LOGICAL,
+	GEN_STATEMENT,
+}	GenKind;
+
+/*
+*	An expression of the walk in gen_expression whose operands are being
+*	generated. The vregs of finished operands that are still to be used,
+*	the arguments of a call or a left operand, wait on a second stack.
+*/
+typedef struct {
+	NodeId		id;
+	uint8_t		kind;		// GenKind
+	bool		outer;		// f->checked of the enclosing expression
+	uint32_t	next;		// operands started so far
+	uint32_t	values;		// where its operands' vregs start
+	size_t		result;		// && and ||: the vreg both paths write
+	size_t		label;		// && and ||: where a deciding operand jumps
+} GenFrame;
+
+/* Both stacks start on the C stack and move into the arena when deeper */
+typedef struct {
+	GenFrame	*frames;
+	uint32_t	count;
+	uint32_t	capacity;
+	size_t		*values;
+	uint32_t	value_count;
+	uint32_t	value_capacity;
+} GenStack;
+
+static GenKind	gen_kind(ASTNodeType type)
 {
-	size_t	arg_vregs[MAX_PARAMS_PER_FUNCTION];
-	size_t	result_reg;
-
-	for (size_t i = 0; i < node->call.arg_count; ++i)
+	switch (type)
 	{
-		arg_vregs[i] = gen_expression(a, f, node->call.args[i], symbol_table);
-		if (arg_vregs[i] == 0)
-			return (0);
+		case AST_NUMBER:
+		case AST_IDENTIFIER:
+			return (GEN_LEAF);
+		case AST_CALL:
+			return (GEN_CALL);
+		case AST_NEGATE:
+		case AST_NOT:
+		case AST_BIT_NOT:
+			return (GEN_UNARY);
+		case AST_LOGICAL_AND:
+		case AST_LOGICAL_OR:
+			return (GEN_LOGICAL);
+		case AST_VAR_DECL:
+		case AST_ASSIGNMENT:
+		case AST_RETURN:
+		case AST_IF:
+		case AST_WHILE:
+		case AST_BLOCK:
+		case AST_FUNCTION:
+		case AST_TRANSLATION_UNIT:
+			return (GEN_STATEMENT);
+		default:
+			return (GEN_BINARY);
 	}
-	for (size_t i = 0; i < node->call.arg_count; ++i)
+}
+
+static size_t gen_call(Arena *a, IRFunction *f, NodeId id, const size_t *arg_vregs)
+{
+	const ASTNode	*node = ast_node(f->ast, id);
+	uint32_t		arg_count;
+	const NodeId	*args = ast_call_args(f->ast, id, &arg_count);
+	size_t			result_reg;
+
+	check_node(f, id);
+	for (size_t i = 0; i < arg_count; ++i)
 	{
 		IRInstruction arg_inst = { 
 			.opcode = IR_ARG,
-			.type = node->call.args[i]->value_type,
+			.type = ast_value_type(f->ast, args[i]),
 			.src_1 = arg_vregs[i],
 			.imm = i
 		};
@@ -105,19 +188,20 @@ static size_t gen_call(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *symb
 		.opcode = IR_CALL,
 		.type = node->value_type,
 		.dest = result_reg,
-		.func_name = node->call.function_name
+		.func_name = ast_name(f->ast, node->lhs),
+		.func_atom = node->lhs
 	};
 	emit(a, f, call_inst);
 	return (result_reg);
 }
 
-static size_t gen_unary(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *symbol_table)
+static size_t gen_unary(Arena *a, IRFunction *f, NodeId id, size_t operand)
 {
-	size_t		operand;
+	const ASTNode	*node = ast_node(f->ast, id);
 	size_t		dest;
 	IROpcode	op;
 
-	operand = gen_expression(a, f, node->unary.operand, symbol_table);
+	check_node(f, id);
 	if (operand == 0)
 		return (0);
 	if (!ir_alloc_vreg(f, &dest))
@@ -128,8 +212,8 @@ static size_t gen_unary(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *sym
 		case AST_NOT:			op = IR_NOT; break;
 		case AST_BIT_NOT:		op = IR_BNOT; break;
 		default:
-			error_add(f->errors, ERROR_CODEGEN, ERROR_LEVEL_ERROR,
-					f->filename, node->line, node->column,
+			error_add_at(f->errors, ERROR_CODEGEN, ERROR_LEVEL_ERROR,
+					f->file, node->offset,
 					"unknown unary operator");
 			return (0);
 	}
@@ -142,12 +226,11 @@ static size_t gen_unary(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *sym
 	return (dest);
 }
 
-static size_t gen_binary_op(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *symbol_table)
+static size_t gen_binary_op(Arena *a, IRFunction *f, NodeId id, size_t left,
+		size_t right)
 {
-	size_t		left = gen_expression(a, f, node->binary.left, symbol_table);
-	if (left == 0)
-		return (0);
-	size_t		right = gen_expression(a, f, node->binary.right, symbol_table);
+	const ASTNode	*node = ast_node(f->ast, id);
+	check_node(f, id);
 	if (right == 0)
 		return (0);
 	size_t		dest;
@@ -169,7 +252,7 @@ static size_t gen_binary_op(Arena *a, IRFunction *f, ASTNode *node, SymbolTable
 		case AST_GREATER_EQUAL:	op = IR_GE; break;
 		case AST_LSHIFT:		op = IR_LSHIFT; break;
 		case AST_RSHIFT:
-			if (type_is_unsigned(node->binary.left->value_type))
+			if (type_is_unsigned(ast_value_type(f->ast, node->lhs)))
 				op = IR_URSHIFT;
 			else
 				op = IR_RSHIFT;
@@ -178,8 +261,8 @@ static size_t gen_binary_op(Arena *a, IRFunction *f, ASTNode *node, SymbolTable
 		case AST_BIT_OR:		op = IR_BOR; break;
 		case AST_BIT_XOR:		op = IR_BXOR; break;
 		default:
-			error_add(f->errors, ERROR_CODEGEN, ERROR_LEVEL_ERROR,
-					f->filename, node->line, node->column,
+			error_add_at(f->errors, ERROR_CODEGEN, ERROR_LEVEL_ERROR,
+					f->file, node->offset,
 					"unknown binary operator");
 			return (0);
 	}
@@ -194,71 +277,354 @@ static size_t gen_binary_op(Arena *a, IRFunction *f, ASTNode *node, SymbolTable
 	return (dest);
 }
 
-static size_t gen_expression(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *symbol_table)
+/**
+ * @brief && and ||: the right operand only runs when the left one does
+ * not decide the result, which is always 0 or 1
+ *
+ * The result starts out as what a deciding operand gives, see
+ * gen_logical_operand and gen_logical_close.
+ */
+static bool	gen_logical_open(Arena *a, IRFunction *f, GenFrame *frame)
+{
+	const ASTNode	*node = ast_node(f->ast, frame->id);
+	bool			is_and = (node->type == AST_LOGICAL_AND);
+
+	frame->label = f->label_count++;
+	if (!ir_alloc_vreg(f, &frame->result))
+		return (false);
+	emit(a, f, (IRInstruction){
+			.opcode = IR_CONST,
+			.type = node->value_type,
+			.dest = frame->result,
+			.imm = is_and ? 0 : 1 });
+	return (true);
+}
+
+/* Jumps to the end when operand, just generated into reg, decides */
+static void	gen_logical_operand(Arena *a, IRFunction *f, const GenFrame *frame,
+				NodeId operand, size_t reg)
+{
+	bool	is_and = (ast_type(f->ast, frame->id) == AST_LOGICAL_AND);
+
+	emit(a, f, (IRInstruction){
+			.opcode = is_and ? IR_JZ : IR_JNZ,
+			.type = ast_value_type(f->ast, operand),
+			.src_1 = reg,
+			.label_id = frame->label });
+}
+
+static size_t	gen_logical_close(Arena *a, IRFunction *f, const GenFrame *frame)
+{
+	const ASTNode	*node = ast_node(f->ast, frame->id);
+	bool			is_and = (node->type == AST_LOGICAL_AND);
+	size_t			other;
+
+	check_node(f, frame->id);
+	if (!ir_alloc_vreg(f, &other))
+		return (0);
+	emit(a, f, (IRInstruction){
+			.opcode = IR_CONST,
+			.type = node->value_type,
+			.dest = other,
+			.imm = is_and ? 1 : 0 });
+	emit(a, f, (IRInstruction){
+			.opcode = IR_MOV,
+			.type = node->value_type,
+			.dest = frame->result,
+			.src_1 = other });
+	emit(a, f, (IRInstruction){
+			.opcode = IR_LABEL,
+			.type = TYPE_VOID,
+			.label_id = frame->label });
+	return (frame->result);
+}
+
+/* Stands in for an expression that failed its checks under ir_gen_fused */
+static size_t	gen_placeholder(Arena *a, IRFunction *f)
 {
-	if (!node)
+	size_t	reg;
+
+	if (!ir_alloc_vreg(f, &reg))
 		return (0);
+	emit(a, f, (IRInstruction){
+			.opcode = IR_CONST,
+			.type = TYPE_INT64,
+			.dest = reg,
+			.imm = 0 });
+	return (reg);
+}
 
-	switch (node->type)
+static bool	gen_reserve(Arena *a, IRFunction *f, void **array,
+				uint32_t *capacity, uint32_t count, size_t size)
+{
+	void	*grown;
+
+	if (count < *capacity)
+		return (true);
+	grown = arena_alloc(a, (size_t)*capacity * 2 * size);
+	if (!grown)
 	{
-		case AST_NUMBER:
-			return (gen_number(a, f, node));
-		case AST_IDENTIFIER:
-			return (gen_identifier(a, f, node, symbol_table));
-		case AST_CALL:
-			return (gen_call(a, f, node, symbol_table));
-		case AST_NEGATE:
-		case AST_NOT:
-		case AST_BIT_NOT:
-			return (gen_unary(a, f, node, symbol_table));
-		case AST_ADD:
-		case AST_SUB:
-		case AST_MUL:
-		case AST_DIV:
-		case AST_EQUAL:
-		case AST_NOT_EQUAL:
-		case AST_LESS:
-		case AST_LESS_EQUAL:
-		case AST_GREATER:
-		case AST_GREATER_EQUAL:
-		case AST_LSHIFT:
-		case AST_RSHIFT:
-		case AST_BIT_AND:
-		case AST_BIT_OR:
-		case AST_BIT_XOR:
-			return (gen_binary_op(a, f, node, symbol_table));
-		case AST_VAR_DECL:
-		case AST_ASSIGNMENT:
-		case AST_RETURN:
-		case AST_IF:
-		case AST_WHILE:
-		case AST_BLOCK:
-		case AST_FUNCTION:
-		case AST_TRANSLATION_UNIT:
-			error_add(f->errors, ERROR_CODEGEN, ERROR_LEVEL_ERROR,
-					f->filename, node->line, node->column,
+		error_fatal(f->errors, f->file->name, 0, 0,
+				"failed to allocate the IR generation walk");
+		return (false);
+	}
+	memcpy(grown, *array, (size_t)count * size);
+	*array = grown;
+	*capacity *= 2;
+	return (true);
+}
+
+/*
+ * Starts expression id. Returns true with its vreg in *reg when that is
+ * known at once, for a missing operand or one failing its checks.
+ */
+static bool	gen_open(Arena *a, IRFunction *f, GenStack *s, NodeId id, size_t *reg)
+{
+	*reg = 0;
+	if (id == NODE_NONE)
+		return (true);
+	if (f->sa && !semantic_enter(f->sa, id))
+	{
+		f->checked = false;
+		*reg = gen_placeholder(a, f);
+		return (true);
+	}
+	if (!gen_reserve(a, f, (void **)&s->frames, &s->capacity, s->count,
+				sizeof(GenFrame)))
+		return (true);
+	s->frames[s->count++] = (GenFrame){
+		.id = id,
+		.kind = gen_kind(ast_type(f->ast, id)),
+		.outer = f->checked,
+		.values = s->value_count
+	};
+	if (f->sa)
+		f->checked = true;
+	return (false);
+}
+
+/* Finishes the innermost expression, which gives reg */
+static size_t	gen_close(IRFunction *f, GenStack *s, size_t reg)
+{
+	const GenFrame	*frame = &s->frames[--s->count];
+
+	s->value_count = frame->values;
+	if (f->sa)
+		f->checked = frame->outer && f->checked;
+	return (reg);
+}
+
+/* Under ir_gen_fused, analyzes subtree id that is not being generated */
+static void	check_tree(IRFunction *f, NodeId id)
+{
+	if (f->sa && !semantic_analyze_tree(f->sa, id))
+		f->checked = false;
+}
+
+/*
+ * Finishes the innermost expression without a value once its generation
+ * failed. Under ir_gen_fused the operands it did not get to are analyzed
+ * and it is checked all the same, so the diagnostics do not change.
+ */
+static size_t	gen_fail(IRFunction *f, GenStack *s)
+{
+	GenFrame		*top = &s->frames[s->count - 1];
+	const ASTNode	*node = ast_node(f->ast, top->id);
+	uint32_t		count;
+	const NodeId	*args;
+
+	if (!f->sa)
+		return (gen_close(f, s, 0));
+	if (top->kind == GEN_CALL)
+	{
+		args = ast_call_args(f->ast, top->id, &count);
+		if (!semantic_check_argument(f->sa, top->id, top->next - 1))
+			f->checked = false;
+		for (uint32_t i = top->next; i < count; ++i)
+		{
+			check_tree(f, args[i]);
+			if (!semantic_check_argument(f->sa, top->id, i))
+				f->checked = false;
+		}
+	}
+	else if (top->kind == GEN_BINARY || top->kind == GEN_LOGICAL)
+	{
+		if (top->next == 0)
+			check_tree(f, node->lhs);
+		if (top->next <= 1)
+			check_tree(f, node->rhs);
+	}
+	check_node(f, top->id);
+	return (gen_close(f, s, 0));
+}
+
+/*
+ * Starts the next operand of the innermost expression, or finishes it once
+ * it has them all. Returns true with a vreg in *reg when something finished.
+ */
+static bool	gen_step(Arena *a, IRFunction *f, GenStack *s, size_t *reg)
+{
+	GenFrame		*top = &s->frames[s->count - 1];
+	const ASTNode	*node = ast_node(f->ast, top->id);
+	uint32_t		count;
+	const NodeId	*args;
+
+	switch (top->kind)
+	{
+		case GEN_LEAF:
+			if (node->type == AST_NUMBER)
+				*reg = gen_close(f, s, gen_number(a, f, top->id));
+			else
+				*reg = gen_close(f, s, gen_identifier(a, f, top->id));
+			return (true);
+		case GEN_CALL:
+			args = ast_call_args(f->ast, top->id, &count);
+			if (top->next < count)
+				return (gen_open(a, f, s, args[top->next++], reg));
+			*reg = gen_close(f, s, gen_call(a, f, top->id, s->values + top->values));
+			return (true);
+		case GEN_UNARY:
+			top->next++;
+			return (gen_open(a, f, s, node->lhs, reg));
+		case GEN_BINARY:
+			return (gen_open(a, f, s, top->next++ == 0 ? node->lhs : node->rhs, reg));
+		case GEN_LOGICAL:
+			if (top->next == 0 && !gen_logical_open(a, f, top))
+			{
+				*reg = gen_fail(f, s);
+				return (true);
+			}
+			if (top->next < 2)
+				return (gen_open(a, f, s, top->next++ == 0 ? node->lhs : node->rhs, reg));
+			*reg = gen_close(f, s, gen_logical_close(a, f, top));
+			return (true);
+		default:
+			error_add_at(f->errors, ERROR_CODEGEN, ERROR_LEVEL_ERROR,
+					f->file, node->offset,
 					"statement node in expression context");
-			return (0);
+			*reg = gen_fail(f, s);
+			return (true);
 	}
 }
 
-static void gen_if(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *symbol_table, size_t *last_reg)
+/*
+ * Hands reg, the vreg of the operand just generated, to the innermost
+ * expression. Returns true with a vreg in *out if that finishes it, which
+ * a failed operand does.
+ */
+static bool	gen_operand(Arena *a, IRFunction *f, GenStack *s, size_t reg,
+				size_t *out)
 {
-	size_t		cond_reg = gen_expression(a, f, node->if_stmt.condition, symbol_table);
-	DataType	cond_type = node->if_stmt.condition->value_type;
-	if (node->if_stmt.else_branch)
+	GenFrame	*top = &s->frames[s->count - 1];
+
+	if (top->kind == GEN_UNARY)
+	{
+		*out = gen_close(f, s, gen_unary(a, f, top->id, reg));
+		return (true);
+	}
+	if (top->kind == GEN_BINARY && top->next == 2)
+	{
+		*out = gen_close(f, s, gen_binary_op(a, f, top->id,
+					s->values[top->values], reg));
+		return (true);
+	}
+	if (reg == 0)
+	{
+		*out = gen_fail(f, s);
+		return (true);
+	}
+	if (top->kind == GEN_LOGICAL)
+	{
+		const ASTNode *node = ast_node(f->ast, top->id);
+		gen_logical_operand(a, f, top, top->next == 1 ? node->lhs : node->rhs, reg);
+		return (false);
+	}
+	// A call's argument or a left operand, kept until the node is emitted
+	if (!gen_reserve(a, f, (void **)&s->values, &s->value_capacity,
+				s->value_count, sizeof(size_t)))
+	{
+		*out = gen_fail(f, s);
+		return (true);
+	}
+	s->values[s->value_count++] = reg;
+	if (top->kind == GEN_CALL && f->sa
+			&& !semantic_check_argument(f->sa, top->id, top->next - 1))
+		f->checked = false;
+	return (false);
+}
+
+/*
+ * Generates expression id and returns the vreg holding its value, 0 if it
+ * could not be generated. The walk keeps its own stacks rather than
+ * recursing, so nesting is only bounded by memory.
+ *
+ * Under ir_gen_fused each expression is entered before its children and
+ * checked by check_node after them; f->checked gathers whether the
+ * children passed. Generation goes on past a failed check so that the
+ * rest of the function still gets its diagnostics, the IR being dropped.
+ */
+static size_t gen_expression(Arena *a, IRFunction *f, NodeId id)
+{
+	GenFrame	frames[WALK_STACK_SIZE];
+	size_t		values[WALK_STACK_SIZE];
+	GenStack	s = {
+		.frames = frames,
+		.capacity = WALK_STACK_SIZE,
+		.values = values,
+		.value_capacity = WALK_STACK_SIZE
+	};
+	size_t		reg;
+	bool		done = gen_open(a, f, &s, id, &reg);
+
+	while (true)
+	{
+		if (!done)
+			done = gen_step(a, f, &s, &reg);
+		else if (s.count == 0)
+			return (reg);
+		else
+			done = gen_operand(a, f, &s, reg, &reg);
+	}
+}
+
+/*
+ * Under ir_gen_fused, checks if or while statement id whose condition
+ * could not be generated, along with the statements left out for it.
+ */
+static void	check_skipped(IRFunction *f, NodeId id)
+{
+	if (ast_type(f->ast, id) == AST_IF)
+	{
+		check_tree(f, ast_if_then(f->ast, id));
+		check_tree(f, ast_if_else(f->ast, id));
+	}
+	else
+		check_tree(f, ast_node(f->ast, id)->rhs);
+	check_node(f, id);
+}
+
+static void gen_if(Arena *a, IRFunction *f, NodeId id, size_t *last_reg)
+{
+	const ASTNode	*node = ast_node(f->ast, id);
+	NodeId			else_branch = ast_if_else(f->ast, id);
+	size_t			cond_reg = gen_expression(a, f, node->lhs);
+	DataType		cond_type = ast_value_type(f->ast, node->lhs);
+	if (else_branch != NODE_NONE)
 	{
 		size_t	label_else = f->label_count++;
 		size_t	label_end = f->label_count++;
 		if (cond_reg == 0)
+		{
+			check_skipped(f, id);
 			return;
+		}
 
 		emit(a, f, (IRInstruction){ 
 				.opcode = IR_JZ,
 				.type = cond_type, 
 				.src_1 = cond_reg,
 				.label_id = label_else });
-		gen_statement(a, f, node->if_stmt.then_branch, symbol_table, last_reg);
+		gen_statement(a, f, ast_if_then(f->ast, id), last_reg);
 		emit(a, f, (IRInstruction){
 				.opcode = IR_JMP,
 				.type = TYPE_VOID,
@@ -267,8 +633,8 @@ static void gen_if(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *symbol_t
 				.opcode = IR_LABEL,
 				.type = TYPE_VOID,
 				.label_id = label_else });
-		if (node->if_stmt.else_branch)
-			gen_statement(a, f, node->if_stmt.else_branch, symbol_table, last_reg);
+		gen_statement(a, f, else_branch, last_reg);
+		check_node(f, id);
 		emit(a, f, (IRInstruction){ 
 				.opcode = IR_LABEL,
 				.type = TYPE_VOID,
@@ -278,14 +644,18 @@ static void gen_if(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *symbol_t
 	{
 		size_t	label_end = f->label_count++;
 		if (cond_reg == 0)
+		{
+			check_skipped(f, id);
 			return;
+		}
 
 		emit(a, f, (IRInstruction){ 
 				.opcode = IR_JZ, 
 				.type = cond_type,
 				.src_1 = cond_reg,
 				.label_id = label_end });
-		gen_statement(a, f, node->if_stmt.then_branch, symbol_table, last_reg);
+		gen_statement(a, f, ast_if_then(f->ast, id), last_reg);
+		check_node(f, id);
 		emit(a, f, (IRInstruction) {
 				.opcode = IR_LABEL,
 				.type = TYPE_VOID,
@@ -293,26 +663,30 @@ static void gen_if(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *symbol_t
 	}
 }
 
-static void	gen_while(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *symbol_table, size_t *last_reg)
+static void	gen_while(Arena *a, IRFunction *f, NodeId id, size_t *last_reg)
 {
-	size_t		label_start = f->label_count++;
-	size_t		label_end = f->label_count++;
-	size_t		cond_reg;
-	DataType	cond_type = node->while_stmt.condition->value_type;
+	const ASTNode	*node = ast_node(f->ast, id);
+	size_t			label_start = f->label_count++;
+	size_t			label_end = f->label_count++;
+	size_t			cond_reg;
 
 	emit(a, f, (IRInstruction){ 
 			.opcode = IR_LABEL,
 			.type = TYPE_VOID,
 			.label_id = label_start });
-	cond_reg = gen_expression(a, f, node->while_stmt.condition, symbol_table);
+	cond_reg = gen_expression(a, f, node->lhs);
 	if (cond_reg == 0)
+	{
+		check_skipped(f, id);
 		return;
+	}
 	emit(a, f, (IRInstruction){ 
 			.opcode = IR_JZ,
-			.type = cond_type,
+			.type = ast_value_type(f->ast, node->lhs),
 			.src_1 = cond_reg,
 			.label_id = label_end });
-	gen_statement(a, f, node->while_stmt.body, symbol_table, last_reg);
+	gen_statement(a, f, node->rhs, last_reg);
+	check_node(f, id);
 	emit(a, f, (IRInstruction){
 			.opcode = IR_JMP,
 			.type = TYPE_VOID,
@@ -323,35 +697,36 @@ static void	gen_while(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *symbo
 			.label_id = label_end });
 }
 
-static void gen_var_decl(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *symbol_table, size_t *last_reg)
+static void gen_var_decl(Arena *a, IRFunction *f, NodeId id, size_t *last_reg)
 {
-	size_t	stack_idx = f->stack_count++;
-	size_t	init_reg;
-	
-	symbol_table_add(symbol_table, node->var_decl.var_name, stack_idx);
-	Symbol *sym = symbol_table_lookup(symbol_table, node->var_decl.var_name);
-	if (sym)
-		sym->is_stack = true;
-	if (node->var_decl.initializer)
-	{
-		init_reg = gen_expression(a, f, node->var_decl.initializer, symbol_table);
-		if (init_reg == 0)
-			return;
-	}
-	else
+	const ASTNode	*node = ast_node(f->ast, id);
+	bool			is_stack;
+	size_t			stack_idx;
+	size_t			init_reg;
+
+	if (node->rhs != NODE_NONE)
+		init_reg = gen_expression(a, f, node->rhs);
+	else if (ir_alloc_vreg(f, &init_reg))
 	{
-		if (!ir_alloc_vreg(f, &init_reg))
-			return;
 		IRInstruction inst = { 
 			.opcode = IR_CONST,
-			.type = node->var_decl.var_type,
+			.type = (DataType)node->value_type,
 			.dest = init_reg, 
 			.imm = 0 };
 		emit(a, f, inst);
 	}
+	else
+		init_reg = 0;
+	// The variable only has its slot once checked
+	check_node(f, id);
+	if (init_reg == 0 || !f->checked)
+		return;
+	stack_idx = var_location(f, ast_node(f->ast, node->lhs)->rhs, &is_stack);
+	if (stack_idx >= f->stack_count)
+		f->stack_count = stack_idx + 1;
 	IRInstruction store = {
 		.opcode = IR_STORE,
-		.type = node->var_decl.var_type,
+		.type = (DataType)node->value_type,
 		.dest = stack_idx,
 		.src_1 = init_reg
 	};
@@ -359,41 +734,32 @@ static void gen_var_decl(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *sy
 	*last_reg = init_reg;
 }
 
-static void gen_assignment(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *symbol_table, size_t *last_reg)
+static void gen_assignment(Arena *a, IRFunction *f, NodeId id, size_t *last_reg)
 {
-	Symbol		*sym = symbol_table_lookup(symbol_table, node->assignment.var_name);
-	IROpcode	opcode = IR_MOV;
-	size_t		val_reg;
-
-	if (!sym)
-	{
-		error_add(f->errors, ERROR_CODEGEN, ERROR_LEVEL_ERROR,
-				f->filename, node->line, node->column,
-				"assignment to undefined variable '%.*s'",
-				(int)node->assignment.var_name.len,
-				node->assignment.var_name.start);
-		return;
-	}
+	const ASTNode	*node = ast_node(f->ast, id);
+	bool			is_stack;
+	size_t			location = var_location(f, ast_node(f->ast, node->lhs)->rhs, &is_stack);
+	size_t			val_reg = gen_expression(a, f, node->rhs);
 
-	val_reg = gen_expression(a, f, node->assignment.value, symbol_table);
+	check_node(f, id);
 	if (val_reg == 0)
 		return;
-
-	if (sym->is_stack)
-		opcode = IR_STORE;
 	IRInstruction instruction = {
-		.opcode = opcode,
+		.opcode = is_stack ? IR_STORE : IR_MOV,
 		.type = node->value_type,
-		.dest = sym->index,
+		.dest = location,
 		.src_1 = val_reg
 	};
 	emit(a, f, instruction);
 	*last_reg = val_reg;
 }
 
-static void gen_return(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *symbol_table)
+static void gen_return(Arena *a, IRFunction *f, NodeId id)
 {
-	size_t ret_reg = gen_expression(a, f, node->return_stmt.expression, symbol_table);
+	const ASTNode	*node = ast_node(f->ast, id);
+	size_t ret_reg = gen_expression(a, f, node->lhs);
+
+	check_node(f, id);
 	if (ret_reg == 0)
 		return;
 
@@ -403,93 +769,124 @@ static void gen_return(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *symb
 			.src_1 = ret_reg });
 }
 
-static void gen_block(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *symbol_table, size_t *last_reg)
+static void gen_block(Arena *a, IRFunction *f, NodeId id, size_t *last_reg)
 {
-	ScopeChange	*watermark = symbol_table->changes;
+	uint32_t		count;
+	const NodeId	*stmts = ast_list(f->ast, id, &count);
 
-	for (size_t i = 0; i < node->block.count; ++i)
-		gen_statement(a, f, node->block.statements[i], symbol_table, last_reg);
-	symbol_table_restore(symbol_table, watermark);
+	for (size_t i = 0; i < count; ++i)
+		gen_statement(a, f, stmts[i], last_reg);
+	check_node(f, id);
 }
 
-static void gen_statement(Arena *a, IRFunction *f, ASTNode *node, SymbolTable *symbol_table, size_t *last_reg)
+/* Statements are entered and checked like expressions, see gen_expression */
+static void gen_statement(Arena *a, IRFunction *f, NodeId id, size_t *last_reg)
 {
-	if (!node)
+	bool	outer = f->checked;
+
+	if (id == NODE_NONE)
 		return;
-	switch (node->type)
+	switch (ast_type(f->ast, id))
+	{
+		case AST_VAR_DECL:
+		case AST_ASSIGNMENT:
+		case AST_RETURN:
+		case AST_BLOCK:
+		case AST_IF:
+		case AST_WHILE:
+			break;
+		default:
+			*last_reg = gen_expression(a, f, id);
+			return;
+	}
+	if (f->sa && !semantic_enter(f->sa, id))
+	{
+		f->checked = false;
+		return;
+	}
+	f->checked = true;
+	switch (ast_type(f->ast, id))
 	{
 		case AST_VAR_DECL:
-			gen_var_decl(a, f, node, symbol_table, last_reg);
+			gen_var_decl(a, f, id, last_reg);
 			break;
 		case AST_ASSIGNMENT:
-			gen_assignment(a, f, node, symbol_table, last_reg);
+			gen_assignment(a, f, id, last_reg);
 			break;
 		case AST_RETURN:
-			gen_return(a, f, node, symbol_table);
+			gen_return(a, f, id);
 			break;
 		case AST_BLOCK:
-			gen_block(a, f, node, symbol_table, last_reg);
+			gen_block(a, f, id, last_reg);
 			break;
 		case AST_IF:
-			gen_if(a, f, node, symbol_table, last_reg);
+			gen_if(a, f, id, last_reg);
 			break;
 		case AST_WHILE:
-			gen_while(a, f, node, symbol_table, last_reg);
+			gen_while(a, f, id, last_reg);
 			break;
 		default:
-			*last_reg = gen_expression(a, f, node, symbol_table);
 			break;
 	}
+	f->checked = outer && f->checked;
 }
 
-IRFunction *ir_gen(Arena *a, ASTNode *root, ErrorContext *errors, const char *filename)
+IRFunction *ir_gen(Arena *a, const Ast *ast, NodeId root, ErrorContext *errors, FileMap *file)
 {
-	if (!root)
+	if (root == NODE_NONE)
 		return (NULL);
 
 	IRFunction *f = arena_alloc(a, sizeof(IRFunction));
 	f->vreg_count = 1;
+	f->stack_count = 0;
+	f->param_count = 0;
 	f->label_count = 0;
 	f->total_count = 0;
 	f->head = NULL;
 	f->tail = NULL;
 	f->errors = errors;
-	f->filename = filename;
+	f->file = file;
+	f->ast = ast;
+	f->sa = NULL;
+	f->checked = true;
 
-	SymbolTable symbol_table = { .arena = a, .changes = NULL };
 	size_t result_reg = 0;
+	uint32_t count;
+	const NodeId *stmts;
 
-	if (root->type == AST_FUNCTION)
+	if (ast_type(ast, root) == AST_FUNCTION)
 	{
-		f->name = root->function.name;
-		for (size_t i = 0; i < root->function.param_count; ++i)
+		ASTFunction func = ast_function(ast, root);
+		f->name = ast_name(ast, func.atom);
+		// Parameter i arrives in vreg i + 1, see var_location
+		for (size_t i = 0; i < func.param_count; ++i)
 		{
-			Parameter *param = &root->function.params[i];
 			size_t vreg;
 			if (!ir_alloc_vreg(f, &vreg))
 				return (NULL);
-			symbol_table_add(&symbol_table, param->name, vreg);
 		}
-		ASTNode *body = root->function.body;
-		if (body && body->type == AST_BLOCK)
+		f->param_count = func.param_count;
+		if (func.body != NODE_NONE && ast_type(ast, func.body) == AST_BLOCK)
 		{
-			for (size_t i = 0; i < body->block.count; ++i)
-				gen_statement(a, f, body->block.statements[i], &symbol_table, &result_reg);
+			stmts = ast_list(ast, func.body, &count);
+			for (size_t i = 0; i < count; ++i)
+				gen_statement(a, f, stmts[i], &result_reg);
 		}
 	}
-	else if (root->type == AST_BLOCK)
+	else if (ast_type(ast, root) == AST_BLOCK)
 	{
-		for (size_t i = 0; i < root->block.count; ++i)
-			gen_statement(a, f, root->block.statements[i], &symbol_table, &result_reg);
+		stmts = ast_list(ast, root, &count);
+		for (size_t i = 0; i < count; ++i)
+			gen_statement(a, f, stmts[i], &result_reg);
 	}
 	else
 	{
-		result_reg = gen_expression(a, f, root, &symbol_table);
+		result_reg = gen_expression(a, f, root);
 		if (result_reg == 0)
 			return (NULL);
 		IRInstruction ret = { 
 			.opcode = IR_RET,
-			.type = root->value_type,
+			.type = ast_value_type(ast, root),
 			.src_1 = result_reg };
 		emit(a, f, ret);
 	}
@@ -497,7 +894,73 @@ IRFunction *ir_gen(Arena *a, ASTNode *root, ErrorContext *errors, const char *fi
 	if (f->total_count >= MAX_IR_INSTRUCTIONS_PER_FUNCTION)
 	{
 		error_add(errors, ERROR_CODEGEN, ERROR_LEVEL_ERROR,
-				filename, 0, 0,
+				file->name, 0, 0,
+				"function '%.*s' exceeds IR instruction limit (%d)",
+				(int)f->name.len, f->name.start,
+				MAX_IR_INSTRUCTIONS_PER_FUNCTION);
+		return (NULL);
+	}
+	return (f);
+}
+
+/**
+ * @brief Checks and generates function func in one walk of its body
+ *
+ * sa is set up by semantic_init for the unit func belongs to. Each node
+ * goes through semantic_enter, its children, semantic_leave and then its
+ * own instructions, so the AST is read once for both. The diagnostics are
+ * the ones semantic_analyze_function would give, in the same order, and
+ * go to sa->errors; errors gets those of the IR, as ir_gen would report
+ * them. Returns NULL if func fails a check, or if its IR cannot be
+ * generated.
+ */
+IRFunction	*ir_gen_fused(Arena *a, SemanticAnalyzer *sa, NodeId func,
+				ErrorContext *errors)
+{
+	ASTFunction		decl = ast_function(sa->ast, func);
+	IRFunction		*f = arena_alloc(a, sizeof(IRFunction));
+	size_t			result_reg = 0;
+	uint32_t		count;
+	const NodeId	*stmts;
+
+	if (!f)
+		return (NULL);
+	*f = (IRFunction){
+		.vreg_count = 1,
+		.param_count = decl.param_count,
+		.name = ast_name(sa->ast, decl.atom),
+		.errors = errors,
+		.file = sa->file,
+		.ast = sa->ast,
+		.sa = sa,
+	};
+	bool ok = semantic_begin_function(sa, func);
+	for (size_t i = 0; i < decl.param_count; ++i)
+	{
+		size_t vreg;
+		if (!ir_alloc_vreg(f, &vreg))
+		{
+			semantic_end_function(sa);
+			return (NULL);
+		}
+	}
+	if (decl.body != NODE_NONE && ast_type(sa->ast, decl.body) == AST_BLOCK)
+	{
+		stmts = ast_list(sa->ast, decl.body, &count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			f->checked = true;
+			gen_statement(a, f, stmts[i], &result_reg);
+			ok = ok && f->checked;
+		}
+	}
+	semantic_end_function(sa);
+	if (!ok)
+		return (NULL);
+	if (f->total_count >= MAX_IR_INSTRUCTIONS_PER_FUNCTION)
+	{
+		error_add(f->errors, ERROR_CODEGEN, ERROR_LEVEL_ERROR,
+				f->file->name, 0, 0,
 				"function '%.*s' exceeds IR instruction limit (%d)",
 				(int)f->name.len, f->name.start,
 				MAX_IR_INSTRUCTIONS_PER_FUNCTION);
@@ -0,0 +1,510 @@
+/**
+ * @file
+ * @brief Rewrites of the calls in a function's IR, by what the callee may do
+ *
+ * Three rewrites, in this order:
+ *  - a call inside a while loop whose callee has no effects at all and
+ *    whose arguments the loop does not change moves in front of the loop,
+ *    along with the instructions in the loop that compute them;
+ *  - a pure call repeating an earlier one, while the arguments of both
+ *    and the earlier result still sit in the same vregs, becomes a MOV of
+ *    that result;
+ *  - a call without effects whose result nothing reads is removed, with
+ *    whatever then only computed its arguments.
+ *
+ * Pure means without EFFECT_IMPURE, see call_graph.c. The IR is not SSA:
+ * parameters and the results of && and || are written more than once, and
+ * locals live in stack slots, so each rewrite checks the vregs and slots it
+ * relies on. A call's ARGs always sit right before its CALL and go with it.
+ */
+
+#include "ir.h"
+#include "semantic.h"
+#include <string.h>
+
+#define NO_INST	UINT32_MAX
+
+typedef struct {
+	IRInstruction		*code;		// the function's instructions, in one array
+	uint32_t			*next;		// their current order, as a list
+	uint32_t			*prev;
+	uint32_t			head;
+	uint32_t			tail;
+	uint32_t			count;
+	uint32_t			*defs;		// per vreg: instructions writing it, parameters one more
+	uint32_t			*vreg_mark;	// per vreg scratch, by stamp
+	uint32_t			*vreg_aux;
+	uint32_t			*inst_mark;	// per instruction scratch, by stamp
+	uint32_t			*slot_mark;	// per stack slot scratch, by stamp
+	uint32_t			*slot_value;
+	uint32_t			stamp;
+	const CallGraph		*calls;
+	const IRFunction	*f;
+} CallOpt;
+
+/* The vreg inst writes, 0 if none */
+static size_t	inst_dest(const IRInstruction *inst)
+{
+	switch (inst->opcode)
+	{
+		case IR_STORE:
+		case IR_ARG:
+		case IR_RET:
+		case IR_LABEL:
+		case IR_JMP:
+		case IR_JZ:
+		case IR_JNZ:
+			return (0);
+		default:
+			return (inst->dest);
+	}
+}
+
+/* The vregs inst reads, into srcs; returns how many */
+static int	inst_sources(const IRInstruction *inst, size_t srcs[2])
+{
+	srcs[0] = inst->src_1;
+	srcs[1] = inst->src_2;
+	switch (ir_opcode_format(inst->opcode))
+	{
+		case FMT_BIN:
+			if (inst->opcode == IR_LOAD)
+				return (0);
+			return (inst->opcode == IR_STORE ? 1 : 2);
+		case FMT_UNARY:
+		case FMT_ARG:
+		case FMT_BRANCH:
+			return (inst->src_1 != 0);
+		default:
+			return (0);
+	}
+}
+
+/* Whether inst may run where it would not have: it cannot fault or loop */
+static bool	is_speculatable(const CallOpt *o, const IRInstruction *inst)
+{
+	switch (inst->opcode)
+	{
+		case IR_DIV:
+		case IR_STORE:
+		case IR_ARG:
+		case IR_RET:
+		case IR_LABEL:
+		case IR_JMP:
+		case IR_JZ:
+		case IR_JNZ:
+			return (false);
+		case IR_CALL:
+			return (call_graph_effects(o->calls, inst->func_atom) == 0);
+		default:
+			return (true);
+	}
+}
+
+static void	unlink_inst(CallOpt *o, uint32_t i)
+{
+	if (o->prev[i] != NO_INST)
+		o->next[o->prev[i]] = o->next[i];
+	else
+		o->head = o->next[i];
+	if (o->next[i] != NO_INST)
+		o->prev[o->next[i]] = o->prev[i];
+	else
+		o->tail = o->prev[i];
+}
+
+static void	insert_before(CallOpt *o, uint32_t i, uint32_t at)
+{
+	o->prev[i] = o->prev[at];
+	o->next[i] = at;
+	if (o->prev[at] != NO_INST)
+		o->next[o->prev[at]] = i;
+	else
+		o->head = i;
+	o->prev[at] = i;
+}
+
+/* First of the ARGs of the CALL call, or call itself if it has none */
+static uint32_t	call_start(const CallOpt *o, uint32_t call)
+{
+	while (o->prev[call] != NO_INST && o->code[o->prev[call]].opcode == IR_ARG)
+		call = o->prev[call];
+	return (call);
+}
+
+static bool	flatten(Arena *a, const IRFunction *f, CallOpt *o)
+{
+	size_t		vregs = f->vreg_count + 1;
+	uint32_t	n = 0;
+
+	o->count = (uint32_t)f->total_count;
+	o->code = arena_alloc(a, (o->count + 1) * sizeof(IRInstruction));
+	o->next = arena_alloc(a, (o->count + 1) * sizeof(uint32_t));
+	o->prev = arena_alloc(a, (o->count + 1) * sizeof(uint32_t));
+	o->inst_mark = arena_alloc_zeroed(a, (o->count + 1) * sizeof(uint32_t));
+	o->defs = arena_alloc_zeroed(a, vregs * sizeof(uint32_t));
+	o->vreg_mark = arena_alloc_zeroed(a, vregs * sizeof(uint32_t));
+	o->vreg_aux = arena_alloc_zeroed(a, vregs * sizeof(uint32_t));
+	o->slot_mark = arena_alloc_zeroed(a, (f->stack_count + 1) * sizeof(uint32_t));
+	o->slot_value = arena_alloc(a, (f->stack_count + 1) * sizeof(uint32_t));
+	if (!o->code || !o->next || !o->prev || !o->inst_mark || !o->defs
+			|| !o->vreg_mark || !o->vreg_aux || !o->slot_mark || !o->slot_value)
+		return (false);
+	for (const IRChunk *chunk = f->head; chunk; chunk = chunk->next)
+	{
+		for (size_t i = 0; i < chunk->count; ++i, ++n)
+		{
+			o->code[n] = chunk->instructions[i];
+			o->next[n] = n + 1 < o->count ? n + 1 : NO_INST;
+			o->prev[n] = n > 0 ? n - 1 : NO_INST;
+			o->defs[inst_dest(&o->code[n])]++;
+		}
+	}
+	for (size_t v = 1; v <= f->param_count; ++v)
+		o->defs[v]++;
+	o->head = 0;
+	o->tail = o->count - 1;
+	return (true);
+}
+
+static void	write_back(IRFunction *f, const CallOpt *o)
+{
+	IRChunk	*chunk = f->head;
+	size_t	n = 0;
+
+	for (IRChunk *c = f->head; c; c = c->next)
+		c->count = 0;
+	for (uint32_t i = o->head; i != NO_INST; i = o->next[i], ++n)
+	{
+		if (chunk->count == IR_CHUNK_SIZE)
+			chunk = chunk->next;
+		chunk->instructions[chunk->count++] = o->code[i];
+	}
+	chunk->next = NULL;
+	f->tail = chunk;
+	f->total_count = n;
+}
+
+/*
+ * Whether the loop leaves v alone: nothing in it writes v, or only an
+ * instruction already found invariant does, which vreg_aux records.
+ */
+static bool	is_invariant(const CallOpt *o, size_t v)
+{
+	return (o->vreg_mark[v] != o->stamp || o->vreg_aux[v] == o->stamp);
+}
+
+/*
+ * Marks the instructions of the loop [start, end] whose result is the
+ * same on every iteration and which could run before it, by inst_mark.
+ * vreg_mark tells which vregs the loop writes, slot_mark which stack
+ * slots it stores to.
+ */
+static void	find_invariants(CallOpt *o, uint32_t start, uint32_t end)
+{
+	for (uint32_t i = start; ; i = o->next[i])
+	{
+		o->vreg_mark[inst_dest(&o->code[i])] = o->stamp;
+		if (o->code[i].opcode == IR_STORE)
+			o->slot_mark[o->code[i].dest] = o->stamp;
+		if (i == end)
+			break;
+	}
+	for (uint32_t i = start; i != end; i = o->next[i])
+	{
+		IRInstruction	*inst = &o->code[i];
+		size_t			srcs[2];
+		int				n = inst_sources(inst, srcs);
+		size_t			dest = inst_dest(inst);
+		bool			invariant = true;
+
+		if (inst->opcode == IR_ARG)
+			invariant = is_invariant(o, inst->src_1);
+		else if (!is_speculatable(o, inst) || o->defs[dest] != 1
+				|| (inst->opcode == IR_LOAD && o->slot_mark[inst->src_1] == o->stamp))
+			invariant = false;
+		for (int k = 0; k < n && invariant; ++k)
+			invariant = is_invariant(o, srcs[k]);
+		// A call also needs each of its arguments
+		for (uint32_t arg = i; invariant && inst->opcode == IR_CALL
+				&& o->prev[arg] != NO_INST && o->code[o->prev[arg]].opcode == IR_ARG; )
+		{
+			arg = o->prev[arg];
+			invariant = (o->inst_mark[arg] == o->stamp);
+		}
+		if (!invariant)
+			continue;
+		o->inst_mark[i] = o->stamp;
+		if (dest != 0)
+			o->vreg_aux[dest] = o->stamp;
+	}
+}
+
+/*
+ * Moves the invariant calls of the loop [start, end] before its label,
+ * start, with the ARGs and invariant instructions computing their
+ * arguments. Walking back, vreg_aux now marks the vregs a moved
+ * instruction reads, whose writes in the loop must move too.
+ */
+static void	hoist_loop(CallOpt *o, uint32_t start, uint32_t end, uint32_t *moved)
+{
+	size_t		count = 0;
+	bool		in_args = false;
+
+	o->stamp++;
+	find_invariants(o, start, end);
+	o->stamp++;
+	for (uint32_t i = o->prev[end]; i != start; i = o->prev[i])
+	{
+		IRInstruction	*inst = &o->code[i];
+		size_t			srcs[2];
+		int				n = inst_sources(inst, srcs);
+		size_t			dest = inst_dest(inst);
+		bool			hoist;
+
+		if (inst->opcode == IR_ARG)
+			hoist = in_args;
+		else
+		{
+			in_args = false;
+			hoist = (o->inst_mark[i] == o->stamp - 1) && (inst->opcode == IR_CALL
+					|| (dest != 0 && o->vreg_aux[dest] == o->stamp));
+			in_args = hoist && inst->opcode == IR_CALL;
+		}
+		if (!hoist)
+			continue;
+		for (int k = 0; k < n; ++k)
+			o->vreg_aux[srcs[k]] = o->stamp;
+		moved[count++] = i;
+	}
+	while (count > 0)
+	{
+		uint32_t i = moved[--count];
+		unlink_inst(o, i);
+		insert_before(o, i, start);
+	}
+}
+
+/*
+ * A while loop is a LABEL that a later JMP goes back to. Moving code only
+ * ever puts it right before a loop's label, so labels and jumps keep the
+ * order they were generated in and inner loops are done first: what they
+ * hoist may then leave the enclosing loop as well.
+ */
+static bool	hoist_loops(Arena *a, CallOpt *o)
+{
+	size_t		labels = o->f->label_count;
+	uint32_t	*label_at = arena_alloc(a, (labels + 1) * sizeof(uint32_t));
+	uint32_t	*moved = arena_alloc(a, (o->count + 1) * sizeof(uint32_t));
+
+	if (!label_at || !moved)
+		return (false);
+	// A label left out by a failed expression is never a loop
+	memset(label_at, 0xff, labels * sizeof(uint32_t));
+	for (uint32_t i = 0; i < o->count; ++i)
+	{
+		if (o->code[i].opcode == IR_LABEL && o->code[i].label_id < labels)
+			label_at[o->code[i].label_id] = i;
+	}
+	for (uint32_t i = o->head; i != NO_INST; i = o->next[i])
+	{
+		if (o->code[i].opcode == IR_JMP && o->code[i].label_id < labels
+				&& label_at[o->code[i].label_id] < i)
+			hoist_loop(o, label_at[o->code[i].label_id], i, moved);
+	}
+	return (true);
+}
+
+/* The vreg first holding the value v holds, see number_load */
+static size_t	value_of(const CallOpt *o, size_t v)
+{
+	return (o->vreg_mark[v] != 0 ? o->vreg_mark[v] : v);
+}
+
+/*
+ * Loads of a stack slot with no store to it in between give the same
+ * value, so vreg_mark sends the dest of a LOAD to that of the first one.
+ * slot_mark tells which slots slot_value holds such a first load for,
+ * within the current stretch of straight-line code.
+ */
+static void	number_load(CallOpt *o, const IRInstruction *inst)
+{
+	if (inst->opcode == IR_STORE)
+		o->slot_mark[inst->dest] = 0;
+	if (inst->opcode != IR_LOAD || o->defs[inst->dest] != 1)
+		return ;
+	if (o->slot_mark[inst->src_1] == o->stamp)
+		o->vreg_mark[inst->dest] = o->slot_value[inst->src_1];
+	else
+	{
+		o->slot_mark[inst->src_1] = o->stamp;
+		o->slot_value[inst->src_1] = (uint32_t)inst->dest;
+	}
+}
+
+/* Whether the CALLs a and b pass the same values */
+static bool	same_arguments(const CallOpt *o, uint32_t a, uint32_t b)
+{
+	uint32_t	x = o->prev[a];
+	uint32_t	y = o->prev[b];
+
+	while (x != NO_INST && o->code[x].opcode == IR_ARG)
+	{
+		if (y == NO_INST || o->code[y].opcode != IR_ARG
+				|| value_of(o, o->code[x].src_1) != value_of(o, o->code[y].src_1))
+			return (false);
+		x = o->prev[x];
+		y = o->prev[y];
+	}
+	return (y == NO_INST || o->code[y].opcode != IR_ARG);
+}
+
+/*
+ * Whether the result of the earlier CALL call, made at position at, is
+ * still what a call with the same arguments would give: vreg_aux holds
+ * the position of each vreg's last write. The first load of a value is
+ * written once, so it holds as long as the vreg it was compared through.
+ */
+static bool	still_holds(const CallOpt *o, uint32_t call, uint32_t at)
+{
+	if (o->vreg_aux[o->code[call].dest] != at)
+		return (false);
+	for (uint32_t x = o->prev[call]; x != NO_INST && o->code[x].opcode == IR_ARG;
+			x = o->prev[x])
+	{
+		if (o->vreg_aux[o->code[x].src_1] > at)
+			return (false);
+	}
+	return (true);
+}
+
+/*
+ * Reuses pure call results along straight-line code. A label is where
+ * other paths join, so what was available before it is forgotten, loaded
+ * values included.
+ */
+static void	reuse_calls(CallOpt *o)
+{
+	uint32_t	avail[CALL_REUSE_LIMIT];
+	uint32_t	avail_at[CALL_REUSE_LIMIT];
+	size_t		count = 0;
+	uint32_t	at = 0;
+
+	memset(o->vreg_aux, 0, (o->f->vreg_count + 1) * sizeof(uint32_t));
+	memset(o->vreg_mark, 0, (o->f->vreg_count + 1) * sizeof(uint32_t));
+	o->stamp++;
+	for (uint32_t i = o->head; i != NO_INST; i = o->next[i])
+	{
+		IRInstruction	*inst = &o->code[i];
+		size_t			j = 0;
+
+		at++;
+		if (inst->opcode == IR_LABEL)
+		{
+			count = 0;
+			o->stamp++;
+		}
+		number_load(o, inst);
+		if (inst->opcode == IR_CALL
+				&& !(call_graph_effects(o->calls, inst->func_atom) & EFFECT_IMPURE))
+		{
+			while (j < count && (o->code[avail[j]].func_atom != inst->func_atom
+					|| !same_arguments(o, avail[j], i)
+					|| !still_holds(o, avail[j], avail_at[j])))
+				j++;
+			if (j < count)
+			{
+				for (uint32_t x = o->prev[i]; x != NO_INST && o->code[x].opcode == IR_ARG;
+						x = o->prev[x])
+					unlink_inst(o, x);
+				*inst = (IRInstruction){
+					.opcode = IR_MOV,
+					.type = inst->type,
+					.dest = inst->dest,
+					.src_1 = o->code[avail[j]].dest
+				};
+			}
+			else
+			{
+				// The oldest entry makes room
+				if (count == CALL_REUSE_LIMIT)
+				{
+					memmove(avail, avail + 1, (count - 1) * sizeof(uint32_t));
+					memmove(avail_at, avail_at + 1, (count - 1) * sizeof(uint32_t));
+					count--;
+				}
+				avail[count] = i;
+				avail_at[count++] = at;
+			}
+		}
+		o->vreg_aux[inst_dest(inst)] = at;
+	}
+}
+
+/*
+ * Removes, walking back so that one removal can expose the next, each
+ * instruction that could run anywhere and whose result is never read, a
+ * call with its ARGs. vreg_aux counts the reads of each vreg.
+ */
+static void	remove_unused(CallOpt *o)
+{
+	memset(o->vreg_aux, 0, (o->f->vreg_count + 1) * sizeof(uint32_t));
+	for (uint32_t i = o->head; i != NO_INST; i = o->next[i])
+	{
+		size_t	srcs[2];
+		int		n = inst_sources(&o->code[i], srcs);
+
+		for (int k = 0; k < n; ++k)
+			o->vreg_aux[srcs[k]]++;
+	}
+	for (uint32_t i = o->tail, prev; i != NO_INST; i = prev)
+	{
+		IRInstruction	*inst = &o->code[i];
+		size_t			dest = inst_dest(inst);
+
+		prev = o->prev[i];
+		if (dest == 0 || o->vreg_aux[dest] != 0 || inst->opcode == IR_ARG)
+			continue;
+		if (inst->opcode == IR_CALL)
+		{
+			if (!is_speculatable(o, inst))
+				continue;
+			prev = o->prev[call_start(o, i)];
+			for (uint32_t x = o->prev[i]; x != prev; )
+			{
+				uint32_t before = o->prev[x];
+				o->vreg_aux[o->code[x].src_1]--;
+				unlink_inst(o, x);
+				x = before;
+			}
+		}
+		else if (!is_speculatable(o, inst))
+			continue;
+		else
+		{
+			size_t	srcs[2];
+			int		n = inst_sources(inst, srcs);
+
+			for (int k = 0; k < n; ++k)
+				o->vreg_aux[srcs[k]]--;
+		}
+		unlink_inst(o, i);
+	}
+}
+
+/**
+ * @brief Hoists, reuses and removes the calls of f, per calls' effects
+ *
+ * The work arrays come from a, which may be the region holding f. If they
+ * cannot be allocated f is left as it is, which is still correct.
+ */
+void	ir_optimize_calls(Arena *a, IRFunction *f, const CallGraph *calls)
+{
+	CallOpt	o = { .calls = calls, .f = f };
+
+	if (f->total_count == 0 || !flatten(a, f, &o) || !hoist_loops(a, &o))
+		return ;
+	reuse_calls(&o);
+	remove_unused(&o);
+	write_back(f, &o);
+}
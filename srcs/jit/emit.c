@@ -148,6 +148,28 @@ void emit_movzx(uint8_t **buf, size_t *cnt, X86Reg dst, X86Reg src)
 	emit_u8(buf, cnt, MOD_REG | ((dst & 7) << 3) | (src & 7));
 }
 
+// Zero extend the low size bytes of reg into the whole of it
+// "mov r32, r32" or "movzx r64, r8/r16"
+void	emit_zeroext(uint8_t **buf, size_t *cnt, X86Reg reg, int size)
+{
+	if (size == 1)
+		emit_movzx(buf, cnt, reg, reg);
+	else if (size == 2)
+	{
+		emit_u8(buf, cnt, REX_W | ((reg >= 8) ? 0x05 : 0));
+		emit_u8(buf, cnt, OP_PREFIX_0F);
+		emit_u8(buf, cnt, OP_MOVZX_16);
+		emit_u8(buf, cnt, MOD_REG | ((reg & 7) << 3) | (reg & 7));
+	}
+	else if (size == 4)
+	{
+		if (reg >= 8)
+			emit_u8(buf, cnt, REX | 0x05);
+		emit_u8(buf, cnt, MOV_RM_R);
+		emit_u8(buf, cnt, MOD_REG | ((reg & 7) << 3) | (reg & 7));
+	}
+}
+
 void	emit_test(uint8_t **buf, size_t *cnt, X86Reg dst, X86Reg src)
 {
 	uint8_t rex = get_rex(dst, src);
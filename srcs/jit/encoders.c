@@ -201,6 +201,7 @@ size_t	encode_mul(uint8_t *buf, size_t *cnt, IRInstruction *inst, JITContext *ct
 	load_binary_operands(&curr, &size, REG_RAX, REG_RCX, src_1, src_2, &right_reg);
 	
 	emit_imul_r64(&curr, &size, REG_RAX, right_reg);
+	wrap_unsigned(&curr, &size, REG_RAX, inst->type);
 	store_reg_to_location(&curr, &size, dest, REG_RAX);
 
 	return (size);
@@ -251,6 +252,7 @@ size_t encode_neg(uint8_t *buf, size_t *cnt, IRInstruction *inst, JITContext *ct
 	emit_u8(&curr, &size, REX_W);
 	emit_u8(&curr, &size, OP_IDIV);
 	emit_u8(&curr, &size, MOD_REG | (EXT_NEG << 3) | REG_RAX);
+	wrap_unsigned(&curr, &size, REG_RAX, inst->type);
 
 	store_reg_to_location(&curr, &size, dest, REG_RAX);
 	return (size);
@@ -288,6 +290,7 @@ size_t encode_not_bitwise(uint8_t *buf, size_t *cnt, IRInstruction *inst, JITCon
 	emit_u8(&curr, &size, REX_W);
 	emit_u8(&curr, &size, OP_GRP3);
 	emit_u8(&curr, &size, MOD_REG | (EXT_NOT << 3) | REG_RAX);
+	wrap_unsigned(&curr, &size, REG_RAX, inst->type);
 
 	// Store result
 	store_reg_to_location(&curr, &size, dest, REG_RAX);
@@ -336,7 +339,6 @@ size_t encode_call(uint8_t *buf, size_t *cnt, IRInstruction *inst, JITContext *c
 	size_t			size = 0;
 	Location		dest = get_location(ctx, inst->dest);
 	PendingCall		*pc = &ctx->pending_call;
-	CallSiteList	*cs = &ctx->call_sites;
 
 	// 1. Calculate stack arguments
 	size_t	stack_args = (pc->count > SYS_V_MAX_REG_ARGS) 
@@ -386,14 +388,13 @@ size_t encode_call(uint8_t *buf, size_t *cnt, IRInstruction *inst, JITContext *c
 	emit_u8(&curr, &size, MOV_IMM_R + REG_RAX);
 
 	// 6. Record call site for linking
-	if (cs && buf)
+	if (buf)
 	{
-		CallSite site = {
+		jit_add_call_site(ctx, (CallSite){
 			.patch_location = curr,
-			.target_name = inst->func_name
-		};
-		if (cs->count < cs->capacity)
-			cs->sites[cs->count++] = site;
+			.target_name = inst->func_name,
+			.target_atom = inst->func_atom
+		});
 	}
 	emit_u64(&curr, &size, 0xDEADBEEFDEADBEEF); // Placeholder
 	emit_u8(&curr, &size, OP_CALL_IND);
@@ -479,10 +480,14 @@ size_t encode_load(uint8_t *buf, size_t *cnt, IRInstruction *inst, JITContext *c
 	int			data_size = type_size(inst->type);
 	
 	if (dest.type == LOC_REG)
+	{
 		emit_load_signext(&curr, &size, dest.reg, REG_RBP, offset, data_size);
+		wrap_unsigned(&curr, &size, dest.reg, inst->type);
+	}
 	else
 	{
 		emit_load_signext(&curr, &size, REG_RAX, REG_RBP, offset, data_size);
+		wrap_unsigned(&curr, &size, REG_RAX, inst->type);
 		store_reg_to_location(&curr, &size, dest, REG_RAX);
 	}
 	return (size);
@@ -41,6 +41,18 @@ void	store_reg_to_location(uint8_t **buf, size_t *size, Location loc, X86Reg src
 	}
 }
 
+/*
+ * -- Wrap a result of type held in reg, as C does for unsigned types --
+ * Values live in 64-bit registers, and those of unsigned types narrower
+ * than that are kept zero extended: comparisons, division and right
+ * shifts then give what they give on the narrow type.
+ */
+void	wrap_unsigned(uint8_t **buf, size_t *size, X86Reg reg, DataType type)
+{
+	if (type_is_unsigned(type) && type_size(type) < 8)
+		emit_zeroext(buf, size, reg, (int)type_size(type));
+}
+
 /* -- Load two operands for a binary operation -- */
 void	load_binary_operands(uint8_t **buf, size_t *size, X86Reg dst, X86Reg tmp, Location left, Location right, X86Reg *out_right_reg)
 {
@@ -67,6 +79,7 @@ size_t	emit_standard_binary_op(uint8_t *buf, IRInstruction *inst, JITContext *ct
 	X86Reg		right_reg;
 	load_binary_operands(&curr, &size, REG_RAX, REG_RDX, src_1, src_2, &right_reg);
 	emit_alu(&curr, &size, opcode, REG_RAX, right_reg);
+	wrap_unsigned(&curr, &size, REG_RAX, inst->type);
 	store_reg_to_location(&curr, &size, dest, REG_RAX);
 	return (size);
 }
@@ -106,6 +119,7 @@ size_t	emit_shift_op(uint8_t *buf, IRInstruction *inst, JITContext *ctx, X86Exte
 	emit_u8(&curr, &size, OP_SHIFT_CL);
 
 	emit_u8(&curr, &size, MOD_REG | (extension << 3) | REG_RAX);
+	wrap_unsigned(&curr, &size, REG_RAX, inst->type);
 
 	// Store result
 	store_reg_to_location(&curr, &size, dest, REG_RAX);
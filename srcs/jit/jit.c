@@ -4,6 +4,7 @@
 #include "jit_internal.h"
 #include "ir.h"
 #include "layout.h"
+#include "parser.h"
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -131,30 +132,66 @@ static size_t encode_prologue(uint8_t *buf, size_t stack_size, size_t param_coun
 	return (size);
 }
 
-void jit_ctx_init(JITContext *ctx, Arena *data_arena, Arena *exec_arena)
+/*
+ * The call sites grow in link_arena: functions are compiled in regions of
+ * the data arena, which would take anything allocated while they are open
+ * along with them. Compiled code is recorded in global, the program's
+ * function table, for calls to be linked against.
+ */
+void jit_ctx_init(JITContext *ctx, Arena *data_arena, Arena *exec_arena,
+		Arena *link_arena, GlobalScope *global)
 {
 	ctx->data_arena = data_arena;
 	ctx->exec_arena = exec_arena;
-	ctx->registry.capacity = MAX_FUNCTION_COUNT;
-	ctx->registry.count = 0;
-	ctx->registry.functions = arena_alloc(data_arena, sizeof(CompiledFunction) * ctx->registry.capacity);
+	ctx->link_arena = link_arena;
+	ctx->global = global;
 
 	ctx->vreg_map = arena_alloc(data_arena, sizeof(Location) * MAX_VREGS_PER_FUNCTION);
 
-	ctx->call_sites.capacity = MAX_CALL_SITES;
-	ctx->call_sites.count = 0;
-	ctx->call_sites.sites = arena_alloc(data_arena, sizeof(CallSite) * ctx->call_sites.capacity);
+	ctx->call_sites = (CallSiteList){0};
 	memset(&ctx->pending_call, 0, sizeof(PendingCall));
 }
 
+/* Entry point of function name, NULL unless it has been compiled */
+uint8_t	*jit_lookup_function(JITContext *ctx, Atom name)
+{
+	FunctionInfo	*info = semantic_global_lookup_function(ctx->global, name);
+
+	return (info ? info->code : NULL);
+}
 
-static inline void reset_state(JITContext *ctx)
+/* Records a call to patch once every function is compiled */
+void	jit_add_call_site(JITContext *ctx, CallSite site)
+{
+	CallSiteList	*cs = &ctx->call_sites;
+
+	if (cs->count == cs->capacity)
+	{
+		size_t		capacity = cs->capacity ? cs->capacity * 2 : CALL_SITE_TABLE_SIZE;
+		CallSite	*sites = arena_alloc(ctx->link_arena, capacity * sizeof(CallSite));
+
+		if (!sites)
+		{
+			cs->dropped++;
+			return ;
+		}
+		if (cs->count > 0)
+			memcpy(sites, cs->sites, cs->count * sizeof(CallSite));
+		cs->sites = sites;
+		cs->capacity = capacity;
+	}
+	cs->sites[cs->count++] = site;
+}
+
+
+/* Clears the per-function state; only the vregs ir_func uses were touched */
+static inline void reset_state(JITContext *ctx, const IRFunction *ir_func)
 {
 	ctx->pending_call.count = 0;
 	ctx->patches = NULL;
 	memset(ctx->label_offset, 0, sizeof(ctx->label_offset));
 	memset(ctx->label_defined, 0, sizeof(ctx->label_defined));
-	memset(ctx->vreg_map, 0, sizeof(Location) * MAX_VREGS_PER_FUNCTION);
+	memset(ctx->vreg_map, 0, sizeof(Location) * ir_func->vreg_count);
 	memset(ctx->phys_regs, 0, sizeof(ctx->phys_regs));
 }
 
@@ -185,13 +222,15 @@ static inline size_t	calculate_aligned_stack_size(IRFunction *ir_func)
 	return (raw_locals_size + padding);
 }
 
-JITResult jit_compile_function(JITContext *ctx, IRFunction *ir_func, ASTNode *func)
+JITResult jit_compile_function(JITContext *ctx, IRFunction *ir_func,
+		const Ast *ast, NodeId func)
 {
-	StringView func_name = func->function.name;
-	size_t param_count = func->function.param_count;
+	ASTFunction	decl = ast_function(ast, func);
+	StringView	func_name = ast_name(ast, decl.atom);
+	size_t		param_count = decl.param_count;
 
 	JITResult result = {0};
-	reset_state(ctx);
+	reset_state(ctx, ir_func);
 
 	if (ir_func->label_count >= MAX_LABELS)
 	{
@@ -228,7 +267,7 @@ JITResult jit_compile_function(JITContext *ctx, IRFunction *ir_func, ASTNode *fu
 	}
 
 	// === PASS 2: Emit ===
-	reset_state(ctx);
+	reset_state(ctx, ir_func);
 	uint8_t *write_ptr = result.code;
 	size_t prologue_size = encode_prologue(write_ptr, stack_bytes, param_count, ctx);
 	write_ptr += prologue_size;
@@ -275,18 +314,9 @@ JITResult jit_compile_function(JITContext *ctx, IRFunction *ir_func, ASTNode *fu
 	result.size = actual_size;
 
 	// === Register this function ===
-	if (ctx->registry.count >= MAX_FUNCTION_COUNT)
-	{
-		fprintf(stderr, BOLD_RED
-				"  > too many functions (max %d)\n" RESET,
-				MAX_FUNCTION_COUNT);
-		return ((JITResult){0});
-	}
-	ctx->registry.functions[ctx->registry.count++] = (CompiledFunction){
-			.name = func_name,
-			.code_addr = result.code,
-			.code_size = result.size
-	};
+	FunctionInfo *info = semantic_global_lookup_function(ctx->global, decl.atom);
+	if (info)
+		info->code = result.code;
 	return (result);
 }
 
@@ -294,19 +324,16 @@ bool jit_link_all(JITContext *ctx, ErrorContext *errors)
 {
 	bool	success = true;
 
+	if (ctx->call_sites.dropped > 0)
+	{
+		error_add(errors, ERROR_SYSTEM, ERROR_LEVEL_FATAL, NULL, 0, 0,
+				"failed to record %zu call sites", ctx->call_sites.dropped);
+		return (false);
+	}
 	for (size_t i = 0; i < ctx->call_sites.count; ++i)
 	{
-		CallSite *site = &ctx->call_sites.sites[i];
-
-		uint8_t *target_addr = NULL;
-		for (size_t j = 0; j < ctx->registry.count; ++j)
-		{
-			if (sv_eq(site->target_name, ctx->registry.functions[j].name))
-			{
-				target_addr = ctx->registry.functions[j].code_addr;
-				break;
-			}
-		}
+		CallSite			*site = &ctx->call_sites.sites[i];
+		uint8_t		*target_addr = jit_lookup_function(ctx, site->target_atom);
 
 		if (!target_addr)
 		{
@@ -323,45 +350,270 @@ bool jit_link_all(JITContext *ctx, ErrorContext *errors)
 	return (success);
 }
 
+/*
+ * Generates and emits the IR of func, a definition in ast. The IR lives in
+ * a region of the data arena released once the code is emitted: linking
+ * only needs the call sites, which the context keeps.
+ *
+ * With sa, func has not been analyzed yet and ir_gen_fused checks it on
+ * the way. Its diagnostics are then reported and its IR dropped, and once
+ * any error has turned up bodies are only checked, never emitted. The
+ * diagnostics of the IR wait until the checks pass, as they would after
+ * semantic_analyze_function. With calls, the call graph of the program,
+ * its calls are optimized by what their callees may do.
+ */
+static bool	compile_decl(JITContext *jit_ctx, CompilationUnit *unit,
+				const Ast *ast, NodeId func, SemanticAnalyzer *sa,
+				const CallGraph *calls, ErrorContext *errors)
+{
+	StringView		name = ast_name(ast, ast_node(ast, func)->lhs);
+	ArenaTemp		region = arena_temp_begin(jit_ctx->data_arena);
+	size_t			errors_before = errors->error_count;
+	ErrorContext	ir_errors;
+	IRFunction		*ir;
+
+	printf("  :: compiling symbol '%.*s'\n", (int)name.len, name.start);
+	if (sa)
+	{
+		error_context_init(&ir_errors, jit_ctx->data_arena);
+		ir = ir_gen_fused(jit_ctx->data_arena, sa, func, &ir_errors);
+	}
+	else
+		ir = ir_gen(jit_ctx->data_arena, ast, func, errors, &unit->file);
+	if (sa && errors->error_count != errors_before)
+	{
+		arena_temp_end(region);
+		return (false);
+	}
+	if (sa && errors->error_count != 0)
+	{
+		arena_temp_end(region);
+		return (true);
+	}
+	if (sa)
+		error_context_merge(errors, &ir_errors);
+	if (!ir)
+	{
+		fprintf(stderr,  BOLD_RED "  > ir generation failed\n" RESET);
+		error_add_at(errors, ERROR_SYSTEM, ERROR_LEVEL_FATAL,
+				&unit->file, ast_node(ast, func)->offset,
+				"IR generation failed for function '%.*s'",
+				(int)name.len, name.start);
+		arena_temp_end(region);
+		return (false);
+	}
+
+	if (calls)
+		ir_optimize_calls(jit_ctx->data_arena, ir, calls);
+	//if (sv_eq_cstr(func->function.name, "main"))
+		ir_print(ir);
+
+	JITResult jit = jit_compile_function(jit_ctx, ir, ast, func);
+	arena_temp_end(region);
+	if (!jit.code)
+	{
+		fprintf(stderr, BOLD_RED "	> compilation failed\n" RESET);
+		error_add_at(errors, ERROR_SYSTEM, ERROR_LEVEL_FATAL,
+				&unit->file, ast_node(ast, func)->offset,
+				"JIT compilation failed for function '%.*s'",
+				(int)name.len, name.start);
+		return (false);
+	}
+	return (true);
+}
+
+/* First node of the top-level declaration decl, whose subtree ends at it */
+static NodeId	decl_first(const Ast *ast, NodeId decl)
+{
+	uint32_t		count;
+	const NodeId	*decls = ast_list(ast, ast->root, &count);
+
+	for (uint32_t i = 1; i < count; ++i)
+	{
+		if (decls[i] == decl)
+			return (decls[i - 1] + 1);
+	}
+	return (1);
+}
+
+/*
+ * Takes info's definition through the whole pipeline in a region of the
+ * data arena: the declaration is copied into an AST of its own, its lazy
+ * body parsed there and analyzed, the definitions it calls queued, and the
+ * code emitted unless an error has turned up. The region, AST included,
+ * is released before the next function, so memory follows the largest
+ * function rather than the program. Names are interned outside of it.
+ */
+static bool	compile_lazy_decl(JITContext *jit_ctx, CompilationContext *ctx,
+				FunctionInfo *info, FunctionInfo **queue, bool *queued,
+				size_t *count)
+{
+	CompilationUnit	*unit = compile_unit_of(ctx, info->file);
+	const Ast		*skeleton = &unit->ast;
+	ASTNode			*lazy = ast_node(skeleton, ast_function(skeleton, info->node).body);
+	ArenaTemp		region = arena_temp_begin(jit_ctx->data_arena);
+	size_t			errors_before = ctx->errors->error_count;
+	bool			ok = false;
+	Ast				ast;
+
+	if (!ast_init(&ast, jit_ctx->data_arena, ctx->interns, lazy->lhs - lazy->offset))
+	{
+		error_fatal(ctx->errors, unit->file.name, 0, 0, "failed to allocate the AST");
+		arena_temp_end(region);
+		return (false);
+	}
+	NodeId func = ast_copy_subtree(&ast, skeleton,
+			decl_first(skeleton, info->node), info->node, 0);
+	NodeId first = ast.node_count;
+	if (func != NODE_NONE && parser_parse_body(&ast, func, &unit->file,
+				ctx->interns, ctx->errors) != NODE_NONE
+			&& ctx->errors->error_count == errors_before)
+	{
+		SemanticAnalyzer	sa;
+		ScopeTable			scopes = {0};
+		if (ctx->options.fused)
+			ok = semantic_init(&sa, jit_ctx->data_arena, unit, &ast,
+					ctx->errors, &ctx->global);
+		else
+			ok = semantic_analyze_function(jit_ctx->data_arena, &scopes, unit,
+					&ast, func, ctx->errors, &ctx->global);
+		// The body's nodes are the ones parsed after the copy
+		for (NodeId id = first; id < ast.node_count; ++id)
+		{
+			if (ast_type(&ast, id) != AST_CALL)
+				continue;
+			FunctionInfo *callee = semantic_global_lookup_function(&ctx->global,
+					ast_node(&ast, id)->lhs);
+			if (!callee || callee->is_prototype
+					|| queued[callee - ctx->global.functions])
+				continue;
+			queued[callee - ctx->global.functions] = true;
+			queue[(*count)++] = callee;
+		}
+		if (ok && ctx->options.fused)
+			ok = compile_decl(jit_ctx, unit, &ast, func, &sa, NULL, ctx->errors);
+		else if (ok && ctx->errors->error_count == 0)
+			ok = compile_decl(jit_ctx, unit, &ast, func, NULL, NULL, ctx->errors);
+	}
+	else if (func == NODE_NONE)
+		error_fatal(ctx->errors, unit->file.name, 0, 0, "failed to allocate the AST");
+	arena_temp_end(region);
+	return (ok);
+}
+
+/**
+ * @brief Compiles main and everything it may call under --lazy
+ *
+ * Bodies are parsed, analyzed and compiled one function at a time, in the
+ * order calls reach them. The rest stay lazy: nothing links against them
+ * since no compiled body calls them.
+ */
+static bool	compile_reachable(JITContext *jit_ctx, CompilationContext *ctx)
+{
+	size_t			total = ctx->global.function_count;
+	FunctionInfo	**queue = arena_alloc(ctx->arena, (total + 1) * sizeof(FunctionInfo *));
+	bool			*queued = arena_alloc_zeroed(ctx->arena, total + 1);
+	size_t			count = 0;
+	size_t			bodies = 0;
+	bool			ok = true;
+
+	if (!queue || !queued)
+	{
+		error_fatal(ctx->errors, NULL, 0, 0, "failed to allocate the call graph");
+		return (false);
+	}
+	FunctionInfo *entry = semantic_global_lookup_function(&ctx->global,
+			intern_find(ctx->interns, "main", 4));
+	if (entry && !entry->is_prototype)
+	{
+		queued[entry - ctx->global.functions] = true;
+		queue[count++] = entry;
+	}
+	// An error stops code generation, not the search for more of them
+	for (size_t i = 0; i < count && !error_has_fatal(ctx->errors); ++i)
+	{
+		if (!compile_lazy_decl(jit_ctx, ctx, queue[i], queue, queued, &count))
+			ok = false;
+	}
+	for (size_t i = 0; i < total; ++i)
+		bodies += !ctx->global.functions[i].is_prototype;
+	printf("  > compiled %zu of %zu function bodies, the ones reachable from main\n",
+			count, bodies);
+	return (ok);
+}
+
+/* Under --fused, checks func without compiling it */
+static bool	check_decl(JITContext *jit_ctx, NodeId func, SemanticAnalyzer *sa,
+				ErrorContext *errors)
+{
+	ArenaTemp		region = arena_temp_begin(jit_ctx->data_arena);
+	size_t			errors_before = errors->error_count;
+	ErrorContext	ir_errors;
+
+	// Bodies main does not reach are never generated, so neither are
+	// their IR diagnostics
+	error_context_init(&ir_errors, jit_ctx->data_arena);
+	ir_gen_fused(jit_ctx->data_arena, sa, func, &ir_errors);
+	arena_temp_end(region);
+	return (errors->error_count == errors_before);
+}
+
+/**
+ * @brief Compiles every definition main reaches in the call graph
+ *
+ * Under --lazy the graph is not known up front, and compile_reachable
+ * follows calls as bodies get parsed instead.
+ */
 bool	jit_compile_pass(JITContext *jit_ctx, CompilationContext *comp_ctx,
 					ErrorContext *errors)
 {
+	const CallGraph	*calls = &comp_ctx->calls;
+	bool			fused = comp_ctx->options.fused;
+	bool			ok = true;
+	size_t			bodies = 0;
+	size_t			skipped = 0;
+
+	if (comp_ctx->options.lazy)
+		return (compile_reachable(jit_ctx, comp_ctx));
 	for (size_t i = 0; i < comp_ctx->count; ++i)
 	{
-		CompilationUnit *unit = &comp_ctx->units[i];
+		CompilationUnit		*unit = &comp_ctx->units[i];
+		SemanticAnalyzer	sa;
 		if (!unit->parsed_ok)
 			continue;
+		if (fused && !semantic_init(&sa, comp_ctx->arena, unit, &unit->ast,
+					errors, &comp_ctx->global))
+			return (false);
 
-		for (size_t j = 0; j < unit->ast->translation_unit.count; ++j)
+		uint32_t		count;
+		const NodeId	*decls = ast_list(&unit->ast, unit->ast.root, &count);
+		for (size_t j = 0; j < count; ++j)
 		{
-			ASTNode *func = unit->ast->translation_unit.declarations[j];
-			if (func->function.is_prototype)
+			ASTFunction	decl = ast_function(&unit->ast, decls[j]);
+			if (decl.is_prototype)
 				continue;
-			printf("  :: compiling symbol '%.*s'\n", (int)func->function.name.len, func->function.name.start);
-
-			IRFunction *ir = ir_gen(jit_ctx->data_arena, func, errors, unit->file.name);
-			if (!ir)
+			bodies++;
+			FunctionInfo *info = semantic_global_lookup_function(
+					&comp_ctx->global, decl.atom);
+			if (!calls->reachable[info - comp_ctx->global.functions])
 			{
-				fprintf(stderr,  BOLD_RED "  > ir generation failed\n" RESET);
-				error_fatal(errors, unit->file.name, func->line, 0,
-						"IR generation failed for function '%.*s'",
-						(int)func->function.name.len, func->function.name.start);
-				return (false);
+				skipped++;
+				// Under --fused this is the only look the body gets
+				if (fused && !check_decl(jit_ctx, decls[j], &sa, errors))
+					ok = false;
+				continue;
 			}
-
-			//if (sv_eq_cstr(func->function.name, "main"))
-				ir_print(ir);
-
-			JITResult jit = jit_compile_function(jit_ctx, ir, func);
-			if (!jit.code)
+			if (!compile_decl(jit_ctx, unit, &unit->ast, decls[j],
+						fused ? &sa : NULL, calls, errors))
 			{
-				fprintf(stderr, BOLD_RED "	> compilation failed\n" RESET);
-				error_fatal(errors, unit->file.name, func->line, 0,
-						"JIT compilation failed for function '%.*s'",
-						(int)func->function.name.len, func->function.name.start);
-				return (false);
+				// Under --fused the remaining bodies still get checked
+				if (!fused)
+					return (false);
+				ok = false;
 			}
 		}
 	}
-	return (true);
+	printf("  > skipped %zu of %zu function bodies, unreachable from main\n",
+			skipped, bodies);
+	return (ok);
 }
@@ -3,18 +3,48 @@
  * @brief Helper functions for lexer
  */
 
-#include "lexer.h"
+#include "lexer_internal.h"
 
 static inline bool is_comment(Lexer *l);
 
-void lexer_init(Lexer *l, FileMap *file)
+void lexer_init(Lexer *l, FileMap *file, InternTable *interns,
+		ErrorContext *errors)
 {
+	lexer_keywords_init();
+	lexer_operators_init();
 	l->file = file;
+	l->stream = NULL;
+	l->interns = interns;
+	l->errors = errors;
 	l->start = file->data;
 	l->curr = file->data;
 	l->end = file->data + file->length;
-	l->line = 1;
-	l->column = 1;
+	l->base = file->data;
+	l->base_offset = 0;
+	l->use_simd = lexer_simd_available();
+}
+
+/**
+ * @brief Lexes from an InputStream window instead of a mapped file
+ *
+ * interns is required: identifier text is copied into it, since the
+ * window moves under the tokens.
+ */
+void	lexer_init_stream(Lexer *l, InputStream *s, InternTable *interns,
+		ErrorContext *errors)
+{
+	lexer_keywords_init();
+	lexer_operators_init();
+	l->file = s->file;
+	l->stream = s;
+	l->interns = interns;
+	l->errors = errors;
+	l->start = s->buffer;
+	l->curr = s->buffer;
+	l->end = s->buffer + s->filled;
+	l->base = s->buffer;
+	l->base_offset = s->base_offset;
+	l->use_simd = lexer_simd_available();
 }
 
 /**
@@ -45,7 +75,6 @@ char lexer_peek_next(Lexer *l)
 char lexer_advance(Lexer *l)
 {
 	l->curr++;
-	l->column++;
 	return l->curr[-1];
 }
 
@@ -64,12 +93,8 @@ void lexer_skip_whitespace(Lexer *l)
 			case ' ':
 			case '\r':
 			case '\t':
-				lexer_advance(l);
-				break;
 			case '\n':
-				l->line++;
-				l->column = 1;
-				lexer_advance(l);
+				l->curr = lexer_scan_whitespace(l, l->curr);
 				break;
 			case '/':
 				if (is_comment(l))
@@ -77,8 +102,7 @@ void lexer_skip_whitespace(Lexer *l)
 				else				// is division
 					return;
 			case '#':
-				while (lexer_peek(l) != '\n' && l->curr < l->end)
-					lexer_advance(l);
+				l->curr = lexer_scan_line(l, l->curr);
 				break;
 			default:
 				return;
@@ -86,37 +110,58 @@ void lexer_skip_whitespace(Lexer *l)
 	}
 }
 
+/**
+ * @brief Skips the inside of a block whose '{' was the last token lexed
+ *
+ * Stops on the matching '}', which is left for lexer_next. Comments are
+ * skipped as lexer_skip_whitespace does, so braces inside them do not
+ * count; without string or character literals nothing else can hide one.
+ *
+ * @return false if the input ends before the block does
+ */
+bool	lexer_skip_block(Lexer *l)
+{
+	size_t	depth = 1;
+
+	while (l->curr < l->end)
+	{
+		switch (*l->curr)
+		{
+			case '{':
+				depth++;
+				break;
+			case '}':
+				if (--depth == 0)
+					return (true);
+				break;
+			case '#':
+				l->curr = lexer_scan_line(l, l->curr);
+				continue;
+			case '/':
+				if (is_comment(l))
+					continue;
+				break;
+			default:
+				break;
+		}
+		l->curr++;
+	}
+	return (false);
+}
+
 static inline bool is_comment(Lexer *l)
 {
-	bool result = false;
 	if (lexer_peek_next(l) == '/')
 	{
-		result = true;
-		while (lexer_peek(l) != '\n' && l->curr < l->end)
-			lexer_advance(l);
+		l->curr = lexer_scan_line(l, l->curr + 2);
+		return (true);
 	}
-	else if (lexer_peek_next(l) == '*')
+	if (lexer_peek_next(l) == '*')
 	{
-		result = true;
-		lexer_advance(l);
-		lexer_advance(l);
-		while (l->curr < l->end)
-		{
-			if (lexer_peek(l) == '*' && lexer_peek_next(l) == '/')
-			{
-				lexer_advance(l);
-				lexer_advance(l);
-				break;
-			}
-			if (lexer_peek(l) == '\n')
-			{
-				l->line++;
-				l->column = 1;
-			}
-			lexer_advance(l);
-		}
+		l->curr = lexer_scan_block_comment(l, l->curr + 2);
+		return (true);
 	}
-	return (result);
+	return (false);
 }
 
 /**
@@ -132,14 +177,13 @@ Token	lexer_make_token(Lexer *l, TokenType type, StringView text)
 	Token result = {
 		.type = type,
 		.text = text,
-		.line = l->line,
-		.column = l->column 
+		.offset = l->base_offset + (uint32_t)(l->start - l->base)
 	};
 	return (result);
 }
 
 /**
- * @brief Makes a token without a text field
+ * @brief Makes a token whose text is everything consumed since l->start
  *
  * @param l 
  * @param type 
@@ -149,8 +193,8 @@ Token	lexer_make_token_no_sv(Lexer *l, TokenType type)
 {
 	Token result = {
 		.type = type,
-		.line = l->line,
-		.column = l->column 
+		.text = { .start = l->start, .len = (size_t)(l->curr - l->start) },
+		.offset = l->base_offset + (uint32_t)(l->start - l->base)
 	};
 	return (result);
 }
@@ -0,0 +1,144 @@
+/**
+ * @file
+ * @brief Windowed file reader for --stream
+ *
+ * Instead of mapping the whole file, the lexer works over a fixed-size
+ * window that is refilled with read(2) as it advances. Bytes before the
+ * token being lexed are dropped on every refill, so the input costs
+ * STREAM_WINDOW_SIZE bytes of memory however large the file is. The newline
+ * index diagnostics need is built from each chunk as it is read, since the
+ * text is gone by the time errors are printed.
+ */
+
+#include "lexer_internal.h"
+#include "defines.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define LINE_INDEX_MIN_CAPACITY	1024
+
+static char	*window_map(size_t size)
+{
+	char *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return (p == MAP_FAILED ? NULL : p);
+}
+
+/* Appends the start of every line that begins in buffer[from, to) */
+static bool	index_lines(InputStream *s, size_t from, size_t to)
+{
+	FileMap		*file = s->file;
+	const char	*p = s->buffer + from;
+	const char	*end = s->buffer + to;
+	const char	*nl;
+
+	while (p < end && (nl = memchr(p, '\n', end - p)) != NULL)
+	{
+		if (file->line_count >= s->line_capacity)
+		{
+			size_t capacity = s->line_capacity * 2;
+			uint32_t *offsets = arena_alloc(s->arena, capacity * sizeof(uint32_t));
+			if (!offsets)
+				return (false);
+			memcpy(offsets, file->line_offsets, file->line_count * sizeof(uint32_t));
+			file->line_offsets = offsets;
+			s->line_capacity = capacity;
+		}
+		file->line_offsets[file->line_count++]
+			= s->base_offset + (uint32_t)(nl - s->buffer) + 1;
+		p = nl + 1;
+	}
+	return (true);
+}
+
+/**
+ * @brief Sets up the window for fd and reads the first chunk
+ *
+ * The caller keeps ownership of fd. file->data stays NULL; only the line
+ * index is filled in.
+ */
+bool	input_stream_open(InputStream *s, int fd, FileMap *file, Arena *a)
+{
+	*s = (InputStream){
+		.fd = fd,
+		.capacity = STREAM_WINDOW_SIZE,
+		.line_capacity = LINE_INDEX_MIN_CAPACITY,
+		.file = file,
+		.arena = a
+	};
+	s->buffer = window_map(s->capacity);
+	file->line_offsets = arena_alloc(a, s->line_capacity * sizeof(uint32_t));
+	if (!s->buffer || !file->line_offsets)
+	{
+		input_stream_close(s);
+		return (false);
+	}
+	file->line_offsets[0] = 0;
+	file->line_count = 1;
+#ifdef __APPLE__
+	fcntl(fd, F_RDAHEAD, 1);
+#else
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	return (input_stream_refill(s, 0));
+}
+
+/**
+ * @brief Drops the bytes before keep_from and reads as much as fits
+ *
+ * When nothing can be dropped and the window is full, a single token or
+ * comment is longer than the window, which then doubles.
+ *
+ * @return false on read or allocation failure, with errno set
+ */
+bool	input_stream_refill(InputStream *s, size_t keep_from)
+{
+	size_t kept = s->filled - keep_from;
+
+	memmove(s->buffer, s->buffer + keep_from, kept);
+	s->base_offset += (uint32_t)keep_from;
+	s->filled = kept;
+	if (s->filled == s->capacity && !s->eof)
+	{
+		char *buffer = window_map(s->capacity * 2);
+		if (!buffer)
+			return (false);
+		memcpy(buffer, s->buffer, s->filled);
+		munmap(s->buffer, s->capacity);
+		s->buffer = buffer;
+		s->capacity *= 2;
+	}
+	while (!s->eof && s->filled < s->capacity)
+	{
+		ssize_t n = read(s->fd, s->buffer + s->filled, s->capacity - s->filled);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return (false);
+		if (n == 0)
+		{
+			s->eof = true;
+			break;
+		}
+		// Token offsets are 32-bit
+		if ((uint64_t)s->base_offset + s->filled + (size_t)n > UINT32_MAX)
+		{
+			errno = EFBIG;
+			return (false);
+		}
+		if (!index_lines(s, s->filled, s->filled + n))
+			return (false);
+		s->filled += n;
+	}
+	return (true);
+}
+
+void	input_stream_close(InputStream *s)
+{
+	if (s->buffer)
+		munmap(s->buffer, s->capacity);
+	s->buffer = NULL;
+	s->filled = 0;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file
+ * @brief Perfect-hash keyword lookup generated from lexer_tokens.def
+ *
+ * Every X_TOKEN entry flagged is_keyword lands in a small slot table. The
+ * hash mixes the length with the first and last character; the multiplier
+ * is searched once at startup until no two keywords share a slot, so a
+ * lookup is a single probe plus one memcmp. Adding a keyword to the .def
+ * file is enough to include it.
+ */
+
+#include "lexer_internal.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define KEYWORD_TABLE_SIZE	64
+#define KEYWORD_MAX_SEED	4096
+
+typedef struct {
+	const char	*str;
+	size_t		len;
+	TokenType	type;
+	bool		is_keyword;
+} KeywordEntry;
+
+static const KeywordEntry	token_strings[] = {
+	#define X_TOKEN(name, str, is_keyword, prec, prefix_fn, infix_fn, stmt_fn) \
+		{ str, sizeof(str) - 1, name, is_keyword },
+	#include "lexer_tokens.def"
+	#undef X_TOKEN
+};
+
+_Static_assert((KEYWORD_TABLE_SIZE & (KEYWORD_TABLE_SIZE - 1)) == 0,
+			   "KEYWORD_TABLE_SIZE must be power of 2");
+_Static_assert(sizeof(token_strings) / sizeof(token_strings[0]) < UINT8_MAX,
+			   "token table index must fit in uint8_t");
+
+// Slot holds index + 1 into token_strings, 0 means empty
+static uint8_t			keyword_slots[KEYWORD_TABLE_SIZE];
+static uint32_t			keyword_seed;
+static pthread_once_t	keyword_once = PTHREAD_ONCE_INIT;
+
+static inline uint32_t	keyword_hash(const char *s, size_t len, uint32_t seed)
+{
+	uint32_t h = (uint8_t)s[0] * seed + (uint8_t)s[len - 1] * 31 + (uint32_t)len;
+	return ((h ^ (h >> 5)) & (KEYWORD_TABLE_SIZE - 1));
+}
+
+static bool	try_seed(uint32_t seed)
+{
+	size_t count = sizeof(token_strings) / sizeof(token_strings[0]);
+
+	memset(keyword_slots, 0, sizeof(keyword_slots));
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (!token_strings[i].is_keyword)
+			continue;
+		uint32_t slot = keyword_hash(token_strings[i].str, token_strings[i].len, seed);
+		if (keyword_slots[slot] != 0)
+			return (false);
+		keyword_slots[slot] = (uint8_t)(i + 1);
+	}
+	return (true);
+}
+
+static void	keyword_table_build(void)
+{
+	for (uint32_t seed = 1; seed < KEYWORD_MAX_SEED; ++seed)
+	{
+		if (try_seed(seed))
+		{
+			keyword_seed = seed;
+			return;
+		}
+	}
+	fprintf(stderr, "Fatal: no perfect hash for keywords "
+			"(increase KEYWORD_TABLE_SIZE)\n");
+	exit(1);
+}
+
+void	lexer_keywords_init(void)
+{
+	pthread_once(&keyword_once, keyword_table_build);
+}
+
+TokenType	lexer_keyword_lookup(const char *s, size_t len)
+{
+	uint8_t slot = keyword_slots[keyword_hash(s, len, keyword_seed)];
+	if (slot == 0)
+		return (TOKEN_IDENTIFIER);
+
+	const KeywordEntry *kw = &token_strings[slot - 1];
+	if (kw->len == len && memcmp(kw->str, s, len) == 0)
+		return (kw->type);
+	return (TOKEN_IDENTIFIER);
+}
+
+/**
+ * @brief Static spelling of a keyword or punctuator, as written in the .def
+ */
+const char	*lexer_token_spelling(TokenType type)
+{
+	return (token_strings[type].str);
+}
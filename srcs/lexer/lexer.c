@@ -1,6 +1,10 @@
-#include "lexer.h"
+#include "lexer_internal.h"
+#include "defines.h"
+#include <errno.h>
 
-static TokenType check_keyword(StringView text);
+static Token	lex_number(Lexer *l);
+static Token	lex_token(Lexer *l);
+static Token	lex_streaming(Lexer *l);
 
 /**
  * @brief Lexer works on a as-requested basis,
@@ -10,101 +14,167 @@ static TokenType check_keyword(StringView text);
  * @return Token
  */
 Token lexer_next(Lexer *l)
+{
+	if (l->stream)
+		return (lex_streaming(l));
+	return (lex_token(l));
+}
+
+/* Refills the window keeping everything from `from` on */
+static bool	lexer_slide(Lexer *l, const char *from)
+{
+	InputStream	*s = l->stream;
+	bool		ok = input_stream_refill(s, from - s->buffer);
+
+	l->base = s->buffer;
+	l->base_offset = s->base_offset;
+	l->start = s->buffer;
+	l->curr = s->buffer;
+	l->end = s->buffer + s->filled;
+	return (ok);
+}
+
+/**
+ * @brief lexer_next over an InputStream window
+ *
+ * The window is topped up whenever fewer than STREAM_LOOKAHEAD bytes are
+ * left. A token or comment that still runs into the window end is lexed
+ * again once more input is in. Identifier and punctuator text is pointed
+ * at interned or static storage; number text is only valid until the
+ * next call.
+ */
+static Token	lex_streaming(Lexer *l)
+{
+	while (true)
+	{
+		if (l->end - l->curr < STREAM_LOOKAHEAD && !l->stream->eof
+				&& !lexer_slide(l, l->curr))
+			break;
+		const char *mark = l->curr;
+		Token token = lex_token(l);
+		if (!lexer_window_cut(l))
+		{
+			if (token.type == TOKEN_IDENTIFIER)
+				token.text = atom_sv(l->interns, token.atom);
+			else if (token.type != TOKEN_NUMBER && token.type != TOKEN_ERROR)
+				token.text.start = lexer_token_spelling(token.type);
+			return (token);
+		}
+		if (!lexer_slide(l, mark))
+			break;
+	}
+	if (l->errors)
+		error_add_at(l->errors, ERROR_SYSTEM, ERROR_LEVEL_FATAL, l->file,
+				l->base_offset + (uint32_t)(l->curr - l->base),
+				"failed to read input: %s", strerror(errno));
+	l->stream->eof = true;
+	l->start = l->curr;
+	l->end = l->curr;
+	return (lexer_make_token_no_sv(l, TOKEN_EOF));
+}
+
+static Token	lex_token(Lexer *l)
 {
 	lexer_skip_whitespace(l);
+	l->start = l->curr;
 
 	if (l->curr >= l->end)
 		return (lexer_make_token_no_sv(l, TOKEN_EOF));
 
 	char c = *l->curr;
 	if (isdigit(c))
-	{
-		const char *start = l->curr;
-		while (l->curr < l->end && isdigit(*l->curr))
-			lexer_advance(l);
-		StringView text = { .start = start, .len = l->curr - start };
-		return (lexer_make_token(l, TOKEN_NUMBER, text));
-	}
+		return (lex_number(l));
 
 	if (isalpha(c) || c == '_')
 	{
 		const char *start = l->curr;
-		while (l->curr < l->end && (isalnum(*l->curr) || *l->curr == '_'))
-			lexer_advance(l);
+		l->curr = lexer_scan_identifier(l, l->curr + 1);
 
 		StringView	text = {.start = start, .len = l->curr - start};
-		TokenType	type = check_keyword(text);
+		TokenType	type = lexer_keyword_lookup(text.start, text.len);
 
-		return (lexer_make_token(l, type, text));
+		Token token = lexer_make_token(l, type, text);
+		if (type == TOKEN_IDENTIFIER && l->interns && !lexer_window_cut(l))
+			token.atom = l->stream ? intern_copy(l->interns, text.start, text.len)
+				: intern(l->interns, text.start, text.len);
+		return (token);
 	}
 
-	lexer_advance(l);
-	StringView text = { .start = l->curr - 1, .len = 1 };
+	TokenType type = lexer_scan_operator(l);
+	return (lexer_make_token_no_sv(l, type));
+}
 
-	switch (c)
+/* Reads an integer suffix (u, l, ll, in either order); false if malformed */
+static bool	lex_suffix(const char *p, const char *end, uint8_t *flags)
+{
+	*flags = 0;
+	while (p < end)
 	{
-		case '+': return (lexer_make_token(l, TOKEN_PLUS, text));
-		case '-': return (lexer_make_token(l, TOKEN_MINUS, text));
-		case '*': return (lexer_make_token(l, TOKEN_STAR, text));
-		case '/': return (lexer_make_token(l, TOKEN_SLASH, text));
-		case '(': return (lexer_make_token(l, TOKEN_LPAREN, text));
-		case ')': return (lexer_make_token(l, TOKEN_RPAREN, text));
-		case '{': return (lexer_make_token(l, TOKEN_LBRACE, text));
-		case '}': return (lexer_make_token(l, TOKEN_RBRACE, text));
-		case ';': return (lexer_make_token(l, TOKEN_SEMICOLON, text));
-		case ',': return (lexer_make_token(l, TOKEN_COMMA, text));
-		case '!':
-			if (lexer_peek(l) == '=')
-			{
-				lexer_advance(l);
-				return (lexer_make_token_no_sv(l, TOKEN_BANG_EQUAL));
-			}
-			return (lexer_make_token_no_sv(l, TOKEN_BANG));
-		case '=':
-			if (lexer_peek(l) == '=')
-			{
-				lexer_advance(l);
-				return (lexer_make_token_no_sv(l, TOKEN_EQUAL_EQUAL));
-			}
-			return (lexer_make_token_no_sv(l, TOKEN_EQUAL));
-		case '>':
-			if (lexer_peek(l) == '=')
-			{
-				lexer_advance(l);
-				return (lexer_make_token_no_sv(l, TOKEN_GREATER_EQUAL));
-			}
-			if (lexer_peek(l) == '>')
-			{
-				lexer_advance(l);
-				return (lexer_make_token_no_sv(l, TOKEN_RSHIFT));
-			}
-			return (lexer_make_token_no_sv(l, TOKEN_GREATER));
-		case '<':
-			if (lexer_peek(l) == '=')
-			{
-				lexer_advance(l); 
-				return (lexer_make_token_no_sv(l, TOKEN_LESS_EQUAL));
-			}
-			if (lexer_peek(l) == '<')
-			{
-				lexer_advance(l);
-				return (lexer_make_token_no_sv(l, TOKEN_LSHIFT));
-			}
-			return (lexer_make_token_no_sv(l, TOKEN_LESS));
-		// TODO Logical && and ||
-		case '&': return (lexer_make_token(l, TOKEN_BIT_AND, text));
-		case '|': return (lexer_make_token(l, TOKEN_BIT_OR, text));
-		case '^': return (lexer_make_token(l, TOKEN_BIT_XOR, text));
-		case '~': return (lexer_make_token(l, TOKEN_BIT_NOT, text));
-		default:  return (lexer_make_token_no_sv(l, TOKEN_ERROR));
+		if ((*p == 'u' || *p == 'U') && !(*flags & LITERAL_UNSIGNED))
+		{
+			*flags |= LITERAL_UNSIGNED;
+			p++;
+		}
+		else if ((*p == 'l' || *p == 'L') && !(*flags & LITERAL_LONG))
+		{
+			*flags |= LITERAL_LONG;
+			// "ll" and "LL" only, mixed case is not a suffix
+			p += (p + 1 < end && p[1] == p[0]) ? 2 : 1;
+		}
+		else
+			return (false);
 	}
+	return (true);
 }
 
-static TokenType check_keyword(StringView text)
+/**
+ * @brief Lexes a decimal literal and its value
+ *
+ * The value is computed here, once; later phases read Token.value. A
+ * literal that does not fit 64 bits, or a signed one above INT64_MAX, is
+ * reported and lexed as 0 so parsing can go on.
+ */
+static Token	lex_number(Lexer *l)
 {
-	#define X_TOKEN(name, str, is_keyword, prec, prefix_fn, infix_fn, stmt_fn) \
-		if (is_keyword && sv_eq_cstr(text, str)) return (name);
-	#include "lexer_tokens.def"
-	#undef X_TOKEN
-	return (TOKEN_IDENTIFIER);
+	const char	*start = l->curr;
+	const char	*digits_end = lexer_scan_digits(l, start);
+	uint64_t	value = 0;
+	bool		overflow = false;
+
+	for (const char *p = start; p < digits_end; ++p)
+	{
+		if (__builtin_mul_overflow(value, 10, &value)
+				|| __builtin_add_overflow(value, (uint64_t)(*p - '0'), &value))
+			overflow = true;
+	}
+	// The suffix, and any junk glued to the literal, is part of the token
+	l->curr = lexer_scan_identifier(l, digits_end);
+
+	StringView	text = { .start = start, .len = l->curr - start };
+	Token		token = lexer_make_token(l, TOKEN_NUMBER, text);
+	uint32_t	offset = token.offset;
+
+	// A cut-off literal is lexed again, report it then
+	if (lexer_window_cut(l))
+		return (token);
+	if (!lex_suffix(digits_end, l->curr, &token.literal_flags))
+	{
+		if (l->errors)
+			error_lexer(l->errors, l->file, offset,
+					"invalid suffix '%.*s' on integer literal",
+					(int)(l->curr - digits_end), digits_end);
+		token.literal_flags = 0;
+		value = 0;
+	}
+	else if (overflow || (!(token.literal_flags & LITERAL_UNSIGNED)
+				&& value > INT64_MAX))
+	{
+		if (l->errors)
+			error_lexer(l->errors, l->file, offset,
+					"integer literal '%.*s' is too large for its type",
+					(int)text.len, text.start);
+		value = 0;
+	}
+	token.value = value;
+	return (token);
 }
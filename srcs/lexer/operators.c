@@ -0,0 +1,124 @@
+/**
+ * @file
+ * @brief Longest-match operator DFA generated from lexer_tokens.def
+ *
+ * Every non-keyword X_TOKEN whose spelling is all punctuation is inserted
+ * into a trie once at startup. Bytes are first mapped to a small class
+ * (0 for bytes no operator uses), so the transition table stays a few
+ * kilobytes. Matching walks the table until a byte has no transition and
+ * keeps the last accepting state, which gives C's maximal munch: "<<="
+ * beats "<<" beats "<". Adding an operator to the .def file is enough to
+ * lex it.
+ */
+
+#include "lexer_internal.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define OP_MAX_STATES	64
+#define OP_MAX_CLASSES	32
+
+typedef struct {
+	const char	*str;
+	TokenType	type;
+	bool		is_keyword;
+} OperatorEntry;
+
+static const OperatorEntry	op_tokens[] = {
+	#define X_TOKEN(name, str, is_keyword, prec, prefix_fn, infix_fn, stmt_fn) \
+		{ str, name, is_keyword },
+	#include "lexer_tokens.def"
+	#undef X_TOKEN
+};
+
+// State 0 is the start state, so 0 in op_next also means "no transition"
+static uint8_t			op_class[256];
+static uint8_t			op_next[OP_MAX_STATES][OP_MAX_CLASSES];
+static uint8_t			op_accept[OP_MAX_STATES];
+static pthread_once_t	op_once = PTHREAD_ONCE_INIT;
+
+static bool	is_operator_spelling(const char *s)
+{
+	for (; *s; ++s)
+	{
+		if (!ispunct((unsigned char)*s))
+			return (false);
+	}
+	return (true);
+}
+
+static void	operator_table_overflow(void)
+{
+	fprintf(stderr, "Fatal: operator DFA too large "
+			"(increase OP_MAX_STATES or OP_MAX_CLASSES)\n");
+	exit(1);
+}
+
+static void	operator_table_build(void)
+{
+	size_t	count = sizeof(op_tokens) / sizeof(op_tokens[0]);
+	uint8_t	classes = 1;
+	uint8_t	states = 1;
+
+	memset(op_accept, TOKEN_ERROR, sizeof(op_accept));
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (op_tokens[i].is_keyword || !is_operator_spelling(op_tokens[i].str))
+			continue;
+		uint8_t state = 0;
+		for (const char *s = op_tokens[i].str; *s; ++s)
+		{
+			uint8_t *cls = &op_class[(uint8_t)*s];
+			if (*cls == 0)
+			{
+				if (classes >= OP_MAX_CLASSES)
+					operator_table_overflow();
+				*cls = classes++;
+			}
+			uint8_t *next = &op_next[state][*cls];
+			if (*next == 0)
+			{
+				if (states >= OP_MAX_STATES)
+					operator_table_overflow();
+				*next = states++;
+			}
+			state = *next;
+		}
+		op_accept[state] = (uint8_t)op_tokens[i].type;
+	}
+}
+
+void	lexer_operators_init(void)
+{
+	pthread_once(&op_once, operator_table_build);
+}
+
+/**
+ * @brief Consumes the longest operator at l->curr
+ *
+ * A byte that starts no operator is consumed alone as TOKEN_ERROR.
+ */
+TokenType	lexer_scan_operator(Lexer *l)
+{
+	const char	*p = l->curr;
+	const char	*match_end = p + 1;
+	TokenType	match = TOKEN_ERROR;
+	uint8_t		state = 0;
+
+	while (p < l->end)
+	{
+		state = op_next[state][op_class[(uint8_t)*p]];
+		if (state == 0)
+			break;
+		p++;
+		if (op_accept[state] != TOKEN_ERROR)
+		{
+			match = (TokenType)op_accept[state];
+			match_end = p;
+		}
+	}
+	l->curr = match_end;
+	return (match);
+}
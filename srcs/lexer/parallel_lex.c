@@ -0,0 +1,208 @@
+/**
+ * @file
+ * @brief Speculative parallel tokenizing of a single large file
+ *
+ * The file is cut just after lines holding a lone '}' in column 1, which in
+ * practice close top-level definitions. Every chunk is lexed on its own
+ * thread, with its own arena, intern table and error list, on the
+ * assumption that it starts between tokens. That holds exactly when the
+ * previous chunk's last token is the '}' the cut was placed after; a brace
+ * inside a block comment breaks it. Once all chunks are lexed the cuts are
+ * checked, and a single miss throws the chunks away for a sequential pass.
+ *
+ * Stitching interns each chunk's names into the shared table in chunk
+ * order, so atoms come out the same as with lexer_tokenize.
+ */
+
+#include "lexer_internal.h"
+#include "defines.h"
+#include "parallel.h"
+
+typedef struct {
+	size_t			begin;
+	size_t			end;
+	uint32_t		brace;		// offset of the '}' the chunk ends on
+	Arena			arena;
+	InternTable		interns;
+	ErrorContext	errors;
+	TokenStream		tokens;
+	bool			ok;
+} LexChunk;
+
+typedef struct {
+	FileMap		*file;
+	LexChunk	*chunks;
+} ParallelLex;
+
+/* First cut at or after `from`: just past a "}\n" with the brace in column 1 */
+static size_t	find_cut(const FileMap *file, size_t from, uint32_t *brace)
+{
+	const char	*data = file->data;
+	const char	*end = data + file->length;
+	const char	*p = data + from;
+
+	while (p < end && (p = memchr(p, '}', end - p)) != NULL)
+	{
+		const char *after = p + 1;
+		if (after < end && *after == '\r')
+			after++;
+		if ((p == data || p[-1] == '\n') && after < end && *after == '\n')
+		{
+			*brace = (uint32_t)(p - data);
+			return ((size_t)(after + 1 - data));
+		}
+		p++;
+	}
+	return (file->length);
+}
+
+static size_t	split_chunks(const FileMap *file, size_t jobs, LexChunk *chunks)
+{
+	size_t target = file->length / jobs;
+	size_t count = 0;
+	size_t begin = 0;
+
+	if (target < PARALLEL_LEX_MIN_CHUNK)
+		target = PARALLEL_LEX_MIN_CHUNK;
+	while (begin < file->length && count < jobs)
+	{
+		uint32_t	brace = 0;
+		size_t		end = file->length;
+
+		if (count + 1 < jobs && file->length - begin > target)
+			end = find_cut(file, begin + target, &brace);
+		chunks[count++] = (LexChunk){ .begin = begin, .end = end, .brace = brace };
+		begin = end;
+	}
+	return (count);
+}
+
+static void	lex_chunk(void *ctx, size_t index)
+{
+	ParallelLex	*pl = ctx;
+	LexChunk	*c = &pl->chunks[index];
+	Lexer		lexer;
+
+	c->arena = arena_init(PROT_READ | PROT_WRITE);
+	error_context_init(&c->errors, &c->arena);
+	if (!intern_init(&c->interns, &c->arena))
+		return;
+	lexer_init(&lexer, pl->file, &c->interns, &c->errors);
+	lexer.start = pl->file->data + c->begin;
+	lexer.curr = lexer.start;
+	lexer.end = pl->file->data + c->end;
+	c->ok = lexer_tokenize(&lexer, &c->arena, &c->tokens);
+}
+
+/* Every chunk but the last must end on the brace it was cut after */
+static bool	cuts_hold(const LexChunk *chunks, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		const TokenStream *t = &chunks[i].tokens;
+		if (!chunks[i].ok)
+			return (false);
+		if (i + 1 == count)
+			break;
+		if (t->count < 2 || t->types[t->count - 2] != TOKEN_RBRACE
+				|| t->offsets[t->count - 2] != chunks[i].brace)
+			return (false);
+	}
+	return (true);
+}
+
+static bool	stitch(LexChunk *chunks, size_t count, InternTable *interns,
+				ErrorContext *errors, Arena *a, TokenStream *out)
+{
+	size_t total = 0;
+	size_t literals = 0;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		// Only the last chunk keeps its TOKEN_EOF
+		total += chunks[i].tokens.count - (i + 1 < count);
+		literals += chunks[i].tokens.literal_count;
+	}
+	out->types = arena_alloc(a, total * sizeof(uint8_t));
+	out->offsets = arena_alloc(a, total * sizeof(uint32_t));
+	out->lengths = arena_alloc(a, total * sizeof(uint32_t));
+	out->payloads = arena_alloc(a, total * sizeof(uint32_t));
+	out->literals = arena_alloc(a, (literals + 1) * sizeof(TokenLiteral));
+	if (!out->types || !out->offsets || !out->lengths || !out->payloads
+			|| !out->literals)
+		return (false);
+	out->capacity = total;
+	out->literal_capacity = literals + 1;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		LexChunk	*c = &chunks[i];
+		TokenStream	*t = &c->tokens;
+		size_t		n = t->count - (i + 1 < count);
+		Atom		*remap = arena_alloc(&c->arena, c->interns.count * sizeof(Atom));
+
+		if (!remap)
+			return (false);
+		remap[ATOM_NONE] = ATOM_NONE;
+		for (Atom atom = 1; atom < c->interns.count; ++atom)
+		{
+			StringView name = atom_sv(&c->interns, atom);
+			remap[atom] = intern(interns, name.start, name.len);
+		}
+		memcpy(out->types + out->count, t->types, n * sizeof(uint8_t));
+		memcpy(out->offsets + out->count, t->offsets, n * sizeof(uint32_t));
+		memcpy(out->lengths + out->count, t->lengths, n * sizeof(uint32_t));
+		for (size_t j = 0; j < n; ++j)
+		{
+			uint32_t payload = t->payloads[j];
+			if (t->types[j] == TOKEN_NUMBER)
+				payload += (uint32_t)out->literal_count;
+			else
+				payload = remap[payload];
+			out->payloads[out->count + j] = payload;
+		}
+		memcpy(out->literals + out->literal_count, t->literals,
+				t->literal_count * sizeof(TokenLiteral));
+		out->count += n;
+		out->literal_count += t->literal_count;
+	}
+	for (size_t i = 0; errors && i < count; ++i)
+		error_context_merge(errors, &chunks[i].errors);
+	return (true);
+}
+
+/**
+ * @brief lexer_tokenize for file, split across up to `jobs` threads
+ *
+ * Falls back to one sequential pass when the file is too small to split,
+ * when no cut point is found, or when a cut turns out to sit inside a
+ * comment. The result, diagnostics included, matches lexer_tokenize.
+ */
+bool	lexer_tokenize_parallel(FileMap *file, InternTable *interns,
+			ErrorContext *errors, Arena *a, size_t jobs, TokenStream *out)
+{
+	LexChunk	chunks[MAX_JOBS];
+	ParallelLex	pl = { .file = file, .chunks = chunks };
+	size_t		count = 0;
+	bool		ok = false;
+
+	if (jobs > MAX_JOBS)
+		jobs = MAX_JOBS;
+	if (jobs > 1 && file->length < UINT32_MAX)
+		count = split_chunks(file, jobs, chunks);
+	if (count > 1)
+	{
+		parallel_for(count, jobs, lex_chunk, &pl);
+		*out = (TokenStream){ .file = file };
+		ok = cuts_hold(chunks, count)
+			&& stitch(chunks, count, interns, errors, a, out);
+		for (size_t i = 0; i < count; ++i)
+			arena_free(&chunks[i].arena);
+	}
+	if (ok)
+		return (true);
+
+	Lexer lexer;
+	lexer_init(&lexer, file, interns, errors);
+	return (lexer_tokenize(&lexer, a, out));
+}
@@ -0,0 +1,250 @@
+/**
+ * @file
+ * @brief Bulk scanners for the lexer hot loop
+ *
+ * Whitespace runs, identifier/number bodies and comment bodies are
+ * classified a vector at a time (32 bytes with AVX2, 16 with SSE2).
+ * Scalar loops handle the tail of the buffer and targets without SIMD.
+ */
+
+#include "lexer_internal.h"
+#include <stdint.h>
+
+#if defined(__AVX2__)
+# include <immintrin.h>
+# define LEXER_SIMD		1
+# define VEC_SIZE		32
+# define VEC_FULL_MASK	0xFFFFFFFFu
+
+typedef __m256i	Vec;
+
+static inline Vec		vec_load(const char *p)
+{
+	return (_mm256_loadu_si256((const __m256i *)p));
+}
+
+static inline Vec		vec_splat(int c)
+{
+	return (_mm256_set1_epi8((char)c));
+}
+
+static inline uint32_t	vec_mask(Vec v)
+{
+	return ((uint32_t)_mm256_movemask_epi8(v));
+}
+
+static inline Vec		vec_cmpeq(Vec a, Vec b)	{ return (_mm256_cmpeq_epi8(a, b)); }
+static inline Vec		vec_cmpgt(Vec a, Vec b)	{ return (_mm256_cmpgt_epi8(a, b)); }
+static inline Vec		vec_add(Vec a, Vec b)	{ return (_mm256_add_epi8(a, b)); }
+static inline Vec		vec_or(Vec a, Vec b)	{ return (_mm256_or_si256(a, b)); }
+
+#elif defined(__SSE2__)
+# include <emmintrin.h>
+# define LEXER_SIMD		1
+# define VEC_SIZE		16
+# define VEC_FULL_MASK	0xFFFFu
+
+typedef __m128i	Vec;
+
+static inline Vec		vec_load(const char *p)
+{
+	return (_mm_loadu_si128((const __m128i *)p));
+}
+
+static inline Vec		vec_splat(int c)
+{
+	return (_mm_set1_epi8((char)c));
+}
+
+static inline uint32_t	vec_mask(Vec v)
+{
+	return ((uint32_t)_mm_movemask_epi8(v));
+}
+
+static inline Vec		vec_cmpeq(Vec a, Vec b)	{ return (_mm_cmpeq_epi8(a, b)); }
+static inline Vec		vec_cmpgt(Vec a, Vec b)	{ return (_mm_cmpgt_epi8(a, b)); }
+static inline Vec		vec_add(Vec a, Vec b)	{ return (_mm_add_epi8(a, b)); }
+static inline Vec		vec_or(Vec a, Vec b)	{ return (_mm_or_si128(a, b)); }
+
+#else
+# define LEXER_SIMD		0
+#endif
+
+bool	lexer_simd_available(void)
+{
+	return (LEXER_SIMD);
+}
+
+static inline bool	is_ident_char(char c)
+{
+	return ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+			|| (c >= '0' && c <= '9') || c == '_');
+}
+
+#if LEXER_SIMD
+
+static inline uint32_t	match_byte(Vec v, int c)
+{
+	return (vec_mask(vec_cmpeq(v, vec_splat(c))));
+}
+
+/* Bytes in [lo, hi]: bias into signed range so a single cmpgt suffices */
+static inline uint32_t	match_range(Vec v, int lo, int hi)
+{
+	Vec biased = vec_add(v, vec_splat(0x80 - lo));
+	return (vec_mask(vec_cmpgt(vec_splat(hi - lo - 127), biased)));
+}
+
+static inline uint32_t	match_ident(Vec v)
+{
+	Vec lower = vec_or(v, vec_splat(0x20));
+	return (match_range(lower, 'a', 'z') | match_range(v, '0', '9')
+			| match_byte(v, '_'));
+}
+
+static const char	*scan_whitespace_simd(Lexer *l, const char *p)
+{
+	while (p + VEC_SIZE <= l->end)
+	{
+		Vec			v = vec_load(p);
+		uint32_t	ws = match_byte(v, '\n') | match_byte(v, ' ')
+			| match_byte(v, '\t') | match_byte(v, '\r');
+		uint32_t	stop = ~ws & VEC_FULL_MASK;
+
+		if (stop)
+			return (p + __builtin_ctz(stop));
+		p += VEC_SIZE;
+	}
+	return (p);
+}
+
+static const char	*scan_class_simd(Lexer *l, const char *p, bool digits_only)
+{
+	while (p + VEC_SIZE <= l->end)
+	{
+		Vec			v = vec_load(p);
+		uint32_t	hits = digits_only ? match_range(v, '0', '9') : match_ident(v);
+		uint32_t	stop = ~hits & VEC_FULL_MASK;
+
+		if (stop)
+			return (p + __builtin_ctz(stop));
+		p += VEC_SIZE;
+	}
+	return (p);
+}
+
+static const char	*scan_line_simd(Lexer *l, const char *p)
+{
+	while (p + VEC_SIZE <= l->end)
+	{
+		uint32_t nl = match_byte(vec_load(p), '\n');
+		if (nl)
+			return (p + __builtin_ctz(nl));
+		p += VEC_SIZE;
+	}
+	return (p);
+}
+
+static const char	*scan_block_comment_simd(Lexer *l, const char *p, bool *closed)
+{
+	while (p + VEC_SIZE <= l->end)
+	{
+		uint32_t star = match_byte(vec_load(p), '*');
+
+		while (star)
+		{
+			unsigned pos = __builtin_ctz(star);
+			if (p + pos + 1 < l->end && p[pos + 1] == '/')
+			{
+				*closed = true;
+				return (p + pos + 2);
+			}
+			star &= star - 1;
+		}
+		p += VEC_SIZE;
+	}
+	return (p);
+}
+
+#endif // LEXER_SIMD
+
+/**
+ * @brief Skips a run of ' ', '\t', '\r' and '\n'
+ */
+const char	*lexer_scan_whitespace(Lexer *l, const char *p)
+{
+#if LEXER_SIMD
+	if (l->use_simd)
+		p = scan_whitespace_simd(l, p);
+#endif
+	while (p < l->end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+		p++;
+	return (p);
+}
+
+/**
+ * @brief Skips the body of an identifier ([A-Za-z0-9_]*)
+ */
+const char	*lexer_scan_identifier(Lexer *l, const char *p)
+{
+#if LEXER_SIMD
+	if (l->use_simd)
+		p = scan_class_simd(l, p, false);
+#endif
+	while (p < l->end && is_ident_char(*p))
+		p++;
+	return (p);
+}
+
+/**
+ * @brief Skips a run of decimal digits
+ */
+const char	*lexer_scan_digits(Lexer *l, const char *p)
+{
+#if LEXER_SIMD
+	if (l->use_simd)
+		p = scan_class_simd(l, p, true);
+#endif
+	while (p < l->end && *p >= '0' && *p <= '9')
+		p++;
+	return (p);
+}
+
+/**
+ * @brief Finds the end of the current line, leaving the '\n' unconsumed
+ */
+const char	*lexer_scan_line(Lexer *l, const char *p)
+{
+#if LEXER_SIMD
+	if (l->use_simd)
+		p = scan_line_simd(l, p);
+#endif
+	while (p < l->end && *p != '\n')
+		p++;
+	return (p);
+}
+
+/**
+ * @brief Skips a block comment body, p points just past the opening "/ *"
+ *
+ * @return pointer past the closing "* /", or the end of input if unterminated
+ */
+const char	*lexer_scan_block_comment(Lexer *l, const char *p)
+{
+#if LEXER_SIMD
+	bool closed = false;
+	if (l->use_simd)
+	{
+		p = scan_block_comment_simd(l, p, &closed);
+		if (closed)
+			return (p);
+	}
+#endif
+	while (p < l->end)
+	{
+		if (*p == '*' && p + 1 < l->end && p[1] == '/')
+			return (p + 2);
+		p++;
+	}
+	return (p);
+}
@@ -0,0 +1,143 @@
+/**
+ * @file
+ * @brief Pre-tokenized structure-of-arrays token stream
+ *
+ * lexer_tokenize lexes a whole FileMap up front into parallel arrays
+ * (type byte, 32-bit offset, 32-bit length, 32-bit payload). The parser
+ * then walks the arrays with a TokenCursor, which rebuilds Tokens on
+ * demand and gives cheap lookahead by index.
+ */
+
+#include "lexer_internal.h"
+#include <stdint.h>
+
+#define TOKEN_STREAM_MIN_CAPACITY	64
+
+_Static_assert(TOKEN_ERROR <= UINT8_MAX, "token types must fit in uint8_t");
+
+static bool	stream_reserve(TokenStream *ts, Arena *a, size_t capacity)
+{
+	uint8_t		*types = arena_alloc(a, capacity * sizeof(uint8_t));
+	uint32_t	*offsets = arena_alloc(a, capacity * sizeof(uint32_t));
+	uint32_t	*lengths = arena_alloc(a, capacity * sizeof(uint32_t));
+	uint32_t	*payloads = arena_alloc(a, capacity * sizeof(uint32_t));
+
+	if (!types || !offsets || !lengths || !payloads)
+		return (false);
+	if (ts->count > 0)
+	{
+		memcpy(types, ts->types, ts->count * sizeof(uint8_t));
+		memcpy(offsets, ts->offsets, ts->count * sizeof(uint32_t));
+		memcpy(lengths, ts->lengths, ts->count * sizeof(uint32_t));
+		memcpy(payloads, ts->payloads, ts->count * sizeof(uint32_t));
+	}
+	ts->types = types;
+	ts->offsets = offsets;
+	ts->lengths = lengths;
+	ts->payloads = payloads;
+	ts->capacity = capacity;
+	return (true);
+}
+
+/* Appends a numeric literal to the side table, returning its index */
+static bool	stream_push_literal(TokenStream *ts, Arena *a, const Token *t,
+				uint32_t *index)
+{
+	if (ts->literal_count >= ts->literal_capacity)
+	{
+		size_t capacity = ts->literal_capacity
+			? ts->literal_capacity * 2 : TOKEN_STREAM_MIN_CAPACITY;
+		TokenLiteral *literals = arena_alloc(a, capacity * sizeof(TokenLiteral));
+		if (!literals)
+			return (false);
+		if (ts->literal_count > 0)
+			memcpy(literals, ts->literals, ts->literal_count * sizeof(TokenLiteral));
+		ts->literals = literals;
+		ts->literal_capacity = capacity;
+	}
+	*index = (uint32_t)ts->literal_count;
+	ts->literals[ts->literal_count++] = (TokenLiteral){
+		.value = t->value,
+		.flags = t->literal_flags
+	};
+	return (true);
+}
+
+/**
+ * @brief Lexes the rest of l into out, up to and including TOKEN_EOF
+ *
+ * Error tokens are dropped, matching what parser_advance does with them.
+ *
+ * @return false on allocation failure or if offsets would not fit 32 bits
+ */
+bool	lexer_tokenize(Lexer *l, Arena *a, TokenStream *out)
+{
+	*out = (TokenStream){ .file = l->file };
+	if (l->file->length >= UINT32_MAX)
+		return (false);
+	// Roughly one token per four bytes of C source
+	if (!stream_reserve(out, a, (l->end - l->curr) / 4 + TOKEN_STREAM_MIN_CAPACITY))
+		return (false);
+
+	while (true)
+	{
+		Token t = lexer_next(l);
+		if (t.type == TOKEN_ERROR)
+			continue;
+		if (out->count >= out->capacity
+				&& !stream_reserve(out, a, out->capacity * 2))
+			return (false);
+		out->types[out->count] = (uint8_t)t.type;
+		out->offsets[out->count] = t.offset;
+		out->lengths[out->count] = (uint32_t)t.text.len;
+		out->payloads[out->count] = t.atom;
+		if (t.type == TOKEN_NUMBER
+				&& !stream_push_literal(out, a, &t, &out->payloads[out->count]))
+			return (false);
+		out->count++;
+		if (t.type == TOKEN_EOF)
+			return (true);
+	}
+}
+
+void	token_cursor_init(TokenCursor *c, TokenStream *stream)
+{
+	c->stream = stream;
+	c->index = 0;
+}
+
+/**
+ * @brief Returns the next token, repeating TOKEN_EOF once the stream is done
+ */
+Token	token_cursor_next(TokenCursor *c)
+{
+	TokenStream	*ts = c->stream;
+	size_t		i = c->index;
+
+	if (i + 1 < ts->count)
+		c->index++;
+	Token result = {
+		.type = (TokenType)ts->types[i],
+		.text = { .start = ts->file->data + ts->offsets[i], .len = ts->lengths[i] },
+		.offset = ts->offsets[i]
+	};
+	if (result.type == TOKEN_NUMBER)
+	{
+		result.value = ts->literals[ts->payloads[i]].value;
+		result.literal_flags = ts->literals[ts->payloads[i]].flags;
+	}
+	else
+		result.atom = ts->payloads[i];
+	return (result);
+}
+
+/**
+ * @brief Type of the token `ahead` positions past the next one
+ */
+TokenType	token_cursor_peek(TokenCursor *c, size_t ahead)
+{
+	size_t i = c->index + ahead;
+	if (i >= c->stream->count)
+		i = c->stream->count - 1;
+	return ((TokenType)c->stream->types[i]);
+}
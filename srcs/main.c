@@ -7,17 +7,20 @@
 #include "utils.h"
 #include "error_handler.h"
 #include "cleanup.h"
+#include "session.h"
 #include <string.h>
 #include <stdio.h>
 #include <sys/mman.h>
 
-int main(int argc, char **argv)
+/* One compile and run of the files in argv; --watch calls it again on change */
+static int	compile_and_run(int argc, char **argv, CompileSession *session)
 {
 	int	exit_code = 1;
 
 	Arena ast_arena = arena_init(PROT_READ | PROT_WRITE);
 	Arena jit_data_arena = arena_init(PROT_READ | PROT_WRITE);
 	Arena jit_exec_arena = arena_init(PROT_READ | PROT_WRITE);
+	Arena jit_link_arena = arena_init(PROT_READ | PROT_WRITE);
 
 	ErrorContext	errors;
 	error_context_init(&errors, &ast_arena);
@@ -27,8 +30,13 @@ int main(int argc, char **argv)
 	print_header();
 	
 	print_phase(1, "INITIALIZATION");
-	CompilationContext ctx;
-	if (!compile_ctx_init(&ctx, &ast_arena, &errors, argc - 1))
+	CompileOptions		options;
+	size_t				file_count;
+	CompilationContext	ctx = {0};
+	if (!compile_parse_options(&options, argc, argv, &errors, &file_count)
+		|| (options.watch && !session_start(session))
+		|| !compile_ctx_init(&ctx, &ast_arena, &errors, &options, file_count,
+				options.watch ? session : NULL))
 	{
 		fprintf(stderr, BOLD_RED "\n  > initialization failed\n" RESET);
 		goto cleanup;
@@ -36,6 +44,8 @@ int main(int argc, char **argv)
 
 	for (int i = 1; i < argc; ++i)
 	{
+		if (strncmp(argv[i], "--", 2) == 0)
+			continue;
 		if (!compile_ctx_add_file(&ctx, argv[i], &resources))
 		{
 			fprintf(stderr, BOLD_RED "\n  > initialization failed\n" RESET);
@@ -59,7 +69,8 @@ int main(int argc, char **argv)
 
 	print_phase(4, "JIT");
 	JITContext jit_ctx;
-	jit_ctx_init(&jit_ctx, &jit_data_arena, &jit_exec_arena);
+	jit_ctx_init(&jit_ctx, &jit_data_arena, &jit_exec_arena, &jit_link_arena,
+			&ctx.global);
 	if (!jit_compile_pass(&jit_ctx, &ctx, &errors))
 		goto cleanup;
 
@@ -77,23 +88,18 @@ int main(int argc, char **argv)
 
 	print_phase(5, "EXECUTION");
 	
-	bool found_main = false;
-	for (size_t i = 0; i < jit_ctx.registry.count; i++)
+	uint8_t *entry = jit_lookup_function(&jit_ctx,
+			intern_find(ctx.interns, "main", 4));
+	if (entry)
 	{
-		if (sv_eq_cstr(jit_ctx.registry.functions[i].name, "main"))
-		{
-			JITFunc main_func = (JITFunc)jit_ctx.registry.functions[i].code_addr;
-			int64_t result = main_func();
-			printf(GREEN "  -----------------------------------------\n");
-			printf("   RETURN CODE >> " BOLD_WHITE "%lld" RESET "\n", result);
-			printf(GREEN "  -----------------------------------------\n" RESET);
-			found_main = true;
-			exit_code = 0;
-			break;
-		}
+		JITFunc main_func = (JITFunc)entry;
+		int64_t result = main_func();
+		printf(GREEN "  -----------------------------------------\n");
+		printf("   RETURN CODE >> " BOLD_WHITE "%lld" RESET "\n", result);
+		printf(GREEN "  -----------------------------------------\n" RESET);
+		exit_code = 0;
 	}
-
-	if (!found_main)
+	else
 	{
 		error_fatal(&errors, NULL, 0, 0, "No 'main' function found.");
 		goto cleanup;
@@ -104,9 +110,29 @@ cleanup:
 		|| error_has_warnings(&errors))
 		error_print_all(&errors);
 	resource_cleanup_all(&resources);
+	compile_ctx_free(&ctx);
 	arena_free(&ast_arena);
 	arena_free(&jit_data_arena);
 	arena_free(&jit_exec_arena);
+	arena_free(&jit_link_arena);
+
+	return (exit_code);
+}
+
+int main(int argc, char **argv)
+{
+	CompileSession	session;
+	int				exit_code;
 
+	session_init(&session);
+	while (true)
+	{
+		session_stamp_files(&session, argc, argv);
+		exit_code = compile_and_run(argc, argv, &session);
+		if (!session.watch)
+			break;
+		session_wait_for_change(&session, argc, argv);
+	}
+	session_free(&session);
 	return (exit_code);
 }
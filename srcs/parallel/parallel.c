@@ -0,0 +1,110 @@
+/**
+ * @file
+ * @brief Minimal fork-join helper over pthreads
+ *
+ * Workers pull indices from a shared atomic counter until the range is
+ * exhausted, so uneven work items balance themselves. The calling thread
+ * is one of the workers; if no thread can be started the whole range runs
+ * on it, which keeps callers free of an error path.
+ */
+
+#include "parallel.h"
+#include "defines.h"
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct {
+	ParallelWorkerFn	fn;
+	void				*ctx;
+	size_t				count;
+	size_t				next;
+} ParallelJob;
+
+typedef struct {
+	pthread_t	thread;
+	ParallelJob	*job;
+	size_t		worker;
+} ParallelThread;
+
+typedef struct {
+	ParallelFn	fn;
+	void		*ctx;
+} PlainJob;
+
+static void	*parallel_worker(void *arg)
+{
+	ParallelThread	*self = arg;
+	ParallelJob		*job = self->job;
+	size_t			i;
+
+	while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->count)
+		job->fn(job->ctx, self->worker, i);
+	return (NULL);
+}
+
+/**
+ * @brief Runs fn(ctx, worker, i) for every i in [0, count) on up to `jobs`
+ * threads
+ *
+ * The calling thread is worker 0. Returns once every call has finished.
+ * Calls may run in any order, but two calls with the same worker never
+ * overlap, so per-worker state needs no locking.
+ */
+void	parallel_for_workers(size_t count, size_t jobs, ParallelWorkerFn fn,
+			void *ctx)
+{
+	ParallelJob		job = { .fn = fn, .ctx = ctx, .count = count, .next = 0 };
+	ParallelThread	threads[MAX_JOBS];
+	size_t			started = 0;
+
+	if (jobs > count)
+		jobs = count;
+	if (jobs > MAX_JOBS)
+		jobs = MAX_JOBS;
+	threads[0] = (ParallelThread){ .job = &job, .worker = 0 };
+	while (started + 1 < jobs)
+	{
+		threads[started + 1] = (ParallelThread){ .job = &job, .worker = started + 1 };
+		if (pthread_create(&threads[started + 1].thread, NULL, parallel_worker,
+					&threads[started + 1]) != 0)
+			break;
+		started++;
+	}
+	parallel_worker(&threads[0]);
+	for (size_t i = 1; i <= started; ++i)
+		pthread_join(threads[i].thread, NULL);
+}
+
+static void	run_plain(void *ctx, size_t worker, size_t index)
+{
+	PlainJob	*plain = ctx;
+
+	(void)worker;
+	plain->fn(plain->ctx, index);
+}
+
+/**
+ * @brief Runs fn(ctx, i) for every i in [0, count) on up to `jobs` threads
+ *
+ * Returns once every call has finished. Calls may run in any order.
+ */
+void	parallel_for(size_t count, size_t jobs, ParallelFn fn, void *ctx)
+{
+	PlainJob	plain = { .fn = fn, .ctx = ctx };
+
+	parallel_for_workers(count, jobs, run_plain, &plain);
+}
+
+/**
+ * @brief Number of online CPUs, clamped to [1, MAX_JOBS]
+ */
+size_t	parallel_default_jobs(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (n < 1)
+		return (1);
+	if (n > MAX_JOBS)
+		return (MAX_JOBS);
+	return ((size_t)n);
+}
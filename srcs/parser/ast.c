@@ -0,0 +1,274 @@
+/**
+ * @file
+ * @brief Storage for the index-based AST
+ *
+ * Nodes, side data and parameters each live in one array that doubles in
+ * the arena when full, the same way the intern table grows. Nodes refer to
+ * each other by index, so growing never invalidates a link; only raw
+ * ASTNode pointers held across an ast_add_* call go stale.
+ *
+ * Dense code comes to about one node per three source bytes, so the node
+ * array starts at one slot per two bytes and rarely has to grow. Arena
+ * blocks are anonymous mappings, and the slots never written are never
+ * paged in.
+ */
+
+#include "ast.h"
+
+#define AST_MIN_NODES		256
+#define AST_MIN_EXTRA		256
+// Bigger inputs (--stream) start here and grow
+#define AST_MAX_NODES		(1u << 24)
+#define AST_INITIAL_PARAMS	32
+
+static bool	ast_reserve(Ast *ast, void **array, uint32_t *capacity,
+				uint32_t count, uint32_t needed, size_t size)
+{
+	uint32_t	new_capacity = *capacity;
+
+	if (needed > UINT32_MAX - count)
+		return (false);
+	if (count + needed <= *capacity)
+		return (true);
+	while (new_capacity < count + needed)
+		new_capacity = new_capacity > UINT32_MAX / 2 ? UINT32_MAX : new_capacity * 2;
+	void *grown = arena_alloc(ast->arena, (size_t)new_capacity * size);
+	if (!grown)
+		return (false);
+	if (count > 0)
+		memcpy(grown, *array, (size_t)count * size);
+	*array = grown;
+	*capacity = new_capacity;
+	return (true);
+}
+
+/**
+ * @brief Sets up an empty AST sized for source_size bytes of input
+ */
+bool	ast_init(Ast *ast, Arena *a, const InternTable *interns, size_t source_size)
+{
+	size_t nodes = source_size / 2 > AST_MIN_NODES ? source_size / 2 : AST_MIN_NODES;
+	size_t extra = source_size / 16 > AST_MIN_EXTRA ? source_size / 16 : AST_MIN_EXTRA;
+
+	*ast = (Ast){ .arena = a, .interns = interns };
+	if (nodes > AST_MAX_NODES)
+		nodes = AST_MAX_NODES;
+	if (extra > AST_MAX_NODES / 8)
+		extra = AST_MAX_NODES / 8;
+	ast->nodes = arena_alloc(a, nodes * sizeof(ASTNode));
+	ast->extra = arena_alloc(a, extra * sizeof(uint32_t));
+	ast->params = arena_alloc(a, AST_INITIAL_PARAMS * sizeof(Parameter));
+	if (!ast->nodes || !ast->extra || !ast->params)
+		return (false);
+	ast->node_capacity = (uint32_t)nodes;
+	ast->extra_capacity = (uint32_t)extra;
+	ast->param_capacity = AST_INITIAL_PARAMS;
+	// Node 0 is NODE_NONE
+	ast->nodes[0] = (ASTNode){0};
+	ast->node_count = 1;
+	return (true);
+}
+
+/**
+ * @return the new node's id, or NODE_NONE on allocation failure
+ */
+NodeId	ast_add_node(Ast *ast, ASTNode node)
+{
+	if (!ast_reserve(ast, (void **)&ast->nodes, &ast->node_capacity,
+				ast->node_count, 1, sizeof(ASTNode)))
+		return (NODE_NONE);
+	ast->nodes[ast->node_count] = node;
+	return (ast->node_count++);
+}
+
+/**
+ * @brief Appends words to Ast.extra
+ *
+ * @return index of the first word, or UINT32_MAX on allocation failure
+ */
+uint32_t	ast_add_extra(Ast *ast, const uint32_t *words, uint32_t count)
+{
+	uint32_t	start = ast->extra_count;
+
+	if (!ast_reserve(ast, (void **)&ast->extra, &ast->extra_capacity,
+				ast->extra_count, count, sizeof(uint32_t)))
+		return (UINT32_MAX);
+	if (count > 0)
+		memcpy(ast->extra + start, words, count * sizeof(uint32_t));
+	ast->extra_count += count;
+	return (start);
+}
+
+/**
+ * @return index of the first parameter, or UINT32_MAX on allocation failure
+ */
+uint32_t	ast_add_params(Ast *ast, const Parameter *params, uint32_t count)
+{
+	uint32_t	start = ast->param_count;
+
+	if (!ast_reserve(ast, (void **)&ast->params, &ast->param_capacity,
+				ast->param_count, count, sizeof(Parameter)))
+		return (UINT32_MAX);
+	if (count > 0)
+		memcpy(ast->params + start, params, count * sizeof(Parameter));
+	ast->param_count += count;
+	return (start);
+}
+
+/**
+ * @brief Renames every atom of ast through remap, indexed by old atom
+ */
+void	ast_remap_atoms(Ast *ast, const Atom *remap)
+{
+	for (NodeId id = 1; id < ast->node_count; ++id)
+	{
+		ASTNode *node = &ast->nodes[id];
+		switch (node->type)
+		{
+			case AST_IDENTIFIER:
+			case AST_CALL:
+			case AST_FUNCTION:
+				node->lhs = remap[node->lhs];
+				break;
+			default:
+				break;
+		}
+	}
+	for (uint32_t i = 0; i < ast->param_count; ++i)
+		ast->params[i].atom = remap[ast->params[i].atom];
+}
+
+/**
+ * @brief Re-interns every name of ast into `interns` and switches ast over
+ *
+ * For an AST parsed against a private table. Names are added in the order
+ * the private table first saw them, so atoms match a parse done directly
+ * against `interns`.
+ *
+ * @return false on allocation failure, leaving ast unchanged
+ */
+bool	ast_move_atoms(Ast *ast, InternTable *interns)
+{
+	const InternTable	*from = ast->interns;
+	Atom				*remap = arena_alloc(ast->arena, from->count * sizeof(Atom));
+
+	if (!remap)
+		return (false);
+	remap[ATOM_NONE] = ATOM_NONE;
+	for (Atom atom = 1; atom < from->count; ++atom)
+	{
+		StringView name = atom_sv(from, atom);
+		remap[atom] = intern(interns, name.start, name.len);
+		if (remap[atom] == ATOM_NONE)
+			return (false);
+	}
+	ast_remap_atoms(ast, remap);
+	ast->interns = interns;
+	return (true);
+}
+
+static inline NodeId	rebase(NodeId id, NodeId first, uint32_t base)
+{
+	return (id == NODE_NONE ? NODE_NONE : id - first + base);
+}
+
+/* Copies n words of src->extra from `at`, rebasing node ids from `skip` on */
+static uint32_t	copy_list(Ast *dst, const Ast *src, uint32_t at, uint32_t n,
+					uint32_t skip, NodeId first, uint32_t base)
+{
+	uint32_t start = ast_add_extra(dst, &src->extra[at], n);
+
+	if (start == UINT32_MAX)
+		return (UINT32_MAX);
+	for (uint32_t i = skip; i < n; ++i)
+		dst->extra[start + i] = rebase(dst->extra[start + i], first, base);
+	return (start);
+}
+
+/* Points node's links into dst, copying the lists and parameters it owns */
+static bool	copy_links(Ast *dst, const Ast *src, ASTNode *node, NodeId first,
+				uint32_t base, int64_t offset_delta)
+{
+	uint32_t	list;
+
+	switch ((ASTNodeType)node->type)
+	{
+		case AST_NUMBER:
+		case AST_IDENTIFIER:
+			return (true);
+		case AST_NEGATE:
+		case AST_NOT:
+		case AST_BIT_NOT:
+		case AST_RETURN:
+			node->lhs = rebase(node->lhs, first, base);
+			return (true);
+		case AST_IF:
+			node->lhs = rebase(node->lhs, first, base);
+			list = copy_list(dst, src, node->rhs, 2, 0, first, base);
+			node->rhs = list;
+			return (list != UINT32_MAX);
+		case AST_BLOCK:
+			// A lazy block holds the offset its text ends at, not a list
+			if (node->flags & AST_FLAG_LAZY)
+			{
+				node->lhs = (uint32_t)((int64_t)node->lhs + offset_delta);
+				return (true);
+			}
+			list = copy_list(dst, src, node->lhs, node->rhs, 0, first, base);
+			node->lhs = list;
+			return (list != UINT32_MAX);
+		case AST_CALL:
+			list = copy_list(dst, src, node->rhs, 1 + src->extra[node->rhs], 1,
+					first, base);
+			node->rhs = list;
+			return (list != UINT32_MAX);
+		case AST_FUNCTION:
+		{
+			const uint32_t	*extra = &src->extra[node->rhs];
+			uint32_t		params = ast_add_params(dst, &src->params[extra[1]], extra[2]);
+			uint32_t		words[4] = {
+				rebase(extra[0], first, base), params, extra[2],
+				(uint32_t)((int64_t)extra[3] + offset_delta)
+			};
+
+			if (params == UINT32_MAX)
+				return (false);
+			node->rhs = ast_add_extra(dst, words, 4);
+			return (node->rhs != UINT32_MAX);
+		}
+		case AST_TRANSLATION_UNIT:
+			return (false);
+		default:
+			// Binary operators and AST_WHILE: two child nodes
+			node->lhs = rebase(node->lhs, first, base);
+			node->rhs = rebase(node->rhs, first, base);
+			return (true);
+	}
+}
+
+/**
+ * @brief Appends a copy of src's nodes [first, root] to dst
+ *
+ * The range has to be exactly root's subtree, which holds for every
+ * top-level declaration: the parser appends its nodes one after another,
+ * children first. Links are rebased onto dst, owned lists and parameters
+ * come along, and every source offset moves by offset_delta. Atoms are
+ * kept as they are, so both ASTs must name through the same intern table.
+ *
+ * @return the copy of root, or NODE_NONE on allocation failure
+ */
+NodeId	ast_copy_subtree(Ast *dst, const Ast *src, NodeId first, NodeId root,
+			int64_t offset_delta)
+{
+	uint32_t	base = dst->node_count;
+
+	for (NodeId id = first; id <= root; ++id)
+	{
+		ASTNode node = src->nodes[id];
+		node.offset = (uint32_t)((int64_t)node.offset + offset_delta);
+		if (!copy_links(dst, src, &node, first, base, offset_delta)
+				|| ast_add_node(dst, node) == NODE_NONE)
+			return (NODE_NONE);
+	}
+	return (root - first + base);
+}
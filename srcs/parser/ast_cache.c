@@ -0,0 +1,517 @@
+/**
+ * @file
+ * @brief On-disk AST cache, loaded with mmap instead of parsing (--ast-cache)
+ *
+ * A file is keyed by a hash of the source it was parsed from, so
+ * an edited file simply misses and a reverted one hits again. Entries are
+ * written to a temporary name and renamed into place, so a reader never
+ * sees half a file, and nothing ever needs to be invalidated.
+ *
+ * Loading maps the file privately and points the Ast straight at it.
+ * Semantic analysis writing value types only copies the pages it touches.
+ * The one fixup is for atoms: the names are interned again and, if the
+ * table hands out different atoms than the writer's did, the AST's names
+ * are rewritten through ast_remap_atoms. Everything else is indices.
+ *
+ * The cache directory is not trusted to be intact: every link, list and
+ * name is bounds-checked before the AST is handed out, and a file that
+ * fails any check is treated as a miss. The header also holds a checksum
+ * of the rest, for the damage no bound shows, a number or a name changed.
+ */
+
+#include "ast_cache.h"
+#include "defines.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define AST_CACHE_MAGIC		0x54534154u		// "TAST" in a little-endian dump
+// Bounds the atom remap table a cache file can make us allocate
+#define AST_CACHE_MAX_ATOMS	(1u << 24)
+
+static const uint8_t	cache_types[] = {
+	#define X_TYPE(enum_name, str_name, size, is_signed) enum_name,
+	#include "types.def"
+	#undef X_TYPE
+};
+
+#define CACHE_TYPE_COUNT	(sizeof(cache_types) / sizeof(cache_types[0]))
+
+/* The sections of a mapped cache file */
+typedef struct {
+	const AstCacheHeader	*header;
+	ASTNode					*nodes;
+	Parameter				*params;
+	uint32_t				*extra;
+	const AstCacheName		*names;
+	const char				*text;
+} CacheView;
+
+/*
+ * Keys entries by content, and checksums them continuing from seed. Eight
+ * bytes per step with a multiply and a shift to mix, so hashing stays a
+ * small part of a warm load; the header also records the length, which a
+ * collision would have to match.
+ */
+static uint64_t	content_hash(const void *data, size_t len, uint64_t seed)
+{
+	const char	*s = data;
+	uint64_t	hash = 0x9e3779b97f4a7c15ull ^ seed ^ len;
+	uint64_t	word;
+	size_t		i = 0;
+
+	for (; i + 8 <= len; i += 8)
+	{
+		memcpy(&word, s + i, 8);
+		hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+		hash ^= hash >> 32;
+	}
+	word = 0;
+	memcpy(&word, s + i, len - i);
+	hash = (hash ^ word) * 0xc4ceb9fe1a85ec53ull;
+	return (hash ^ (hash >> 29));
+}
+
+/* Checksum of the sections after the header, in file order */
+static uint32_t	payload_hash(const AstCacheHeader *h, const ASTNode *nodes,
+					const Parameter *params, const uint32_t *extra,
+					const AstCacheName *names, const char *text)
+{
+	uint64_t	hash = 0;
+
+	hash = content_hash(nodes, (size_t)h->node_count * sizeof(ASTNode), hash);
+	hash = content_hash(params, (size_t)h->param_count * sizeof(Parameter), hash);
+	hash = content_hash(extra, (size_t)h->extra_count * sizeof(uint32_t), hash);
+	hash = content_hash(names, (size_t)h->name_count * sizeof(AstCacheName), hash);
+	hash = content_hash(text, h->text_size, hash);
+	return ((uint32_t)(hash ^ (hash >> 32)));
+}
+
+static bool	cache_path(char *out, const char *dir, uint64_t hash)
+{
+	int n = snprintf(out, PATH_MAX, "%s/%016llx.ast", dir, (unsigned long long)hash);
+
+	return (n > 0 && n < PATH_MAX);
+}
+
+static bool	is_named(ASTNodeType type)
+{
+	return (type == AST_IDENTIFIER || type == AST_CALL || type == AST_FUNCTION);
+}
+
+/* ---------------------------------------------------------------- */
+/*  Loading                                                         */
+/* ---------------------------------------------------------------- */
+
+/*
+ * Splits data into its sections; false unless the sizes add up exactly
+ * and the sections are the ones written
+ */
+static bool	view_init(CacheView *v, uint8_t *data, size_t size,
+				const FileMap *file, uint64_t hash)
+{
+	const AstCacheHeader	*h = (const AstCacheHeader *)data;
+	uint64_t				expected = sizeof(AstCacheHeader);
+
+	if (size < sizeof(AstCacheHeader) || h->magic != AST_CACHE_MAGIC
+			|| h->version != AST_CACHE_VERSION
+			|| h->node_size != sizeof(ASTNode)
+			|| h->param_size != sizeof(Parameter)
+			|| h->source_hash != hash || h->source_length != file->length
+			|| h->node_count < 2 || h->root >= h->node_count
+			|| h->atom_limit > AST_CACHE_MAX_ATOMS)
+		return (false);
+	expected += (uint64_t)h->node_count * sizeof(ASTNode);
+	expected += (uint64_t)h->param_count * sizeof(Parameter);
+	expected += (uint64_t)h->extra_count * sizeof(uint32_t);
+	expected += (uint64_t)h->name_count * sizeof(AstCacheName);
+	expected += h->text_size;
+	if (expected != size)
+		return (false);
+	v->header = h;
+	v->nodes = (ASTNode *)(data + sizeof(AstCacheHeader));
+	v->params = (Parameter *)(v->nodes + h->node_count);
+	v->extra = (uint32_t *)(v->params + h->param_count);
+	v->names = (const AstCacheName *)(v->extra + h->extra_count);
+	v->text = (const char *)(v->names + h->name_count);
+	return (payload_hash(h, v->nodes, v->params, v->extra, v->names, v->text)
+		== h->payload_hash);
+}
+
+/* Marks every named atom in remap; names must be in range and distinct */
+static bool	check_names(const CacheView *v, Atom *remap)
+{
+	const AstCacheHeader *h = v->header;
+
+	for (uint32_t i = 0; i < h->name_count; ++i)
+	{
+		const AstCacheName *n = &v->names[i];
+		if (n->atom == ATOM_NONE || n->atom >= h->atom_limit
+				|| remap[n->atom] != ATOM_NONE || n->length == 0
+				|| n->offset > h->text_size
+				|| n->length > h->text_size - n->offset)
+			return (false);
+		remap[n->atom] = n->atom;
+	}
+	return (true);
+}
+
+static bool	check_atom(const CacheView *v, const Atom *remap, uint32_t atom)
+{
+	return (atom < v->header->atom_limit && remap[atom] != ATOM_NONE);
+}
+
+/* Children always precede their parent, which also rules out cycles */
+static bool	check_child(NodeId child, NodeId parent)
+{
+	return (child < parent);
+}
+
+static bool	check_range(uint32_t start, uint64_t count, uint32_t limit)
+{
+	return (start <= limit && count <= limit - start);
+}
+
+static bool	check_list(const CacheView *v, NodeId id, uint32_t start,
+				uint32_t count)
+{
+	if (!check_range(start, count, v->header->extra_count))
+		return (false);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (!check_child(v->extra[start + i], id))
+			return (false);
+	}
+	return (true);
+}
+
+static bool	check_function(const CacheView *v, const Atom *remap, NodeId id)
+{
+	const ASTNode	*node = &v->nodes[id];
+	const uint32_t	*words;
+
+	if (!check_range(node->rhs, 4, v->header->extra_count))
+		return (false);
+	words = &v->extra[node->rhs];
+	if (!check_child(words[0], id) || words[2] > MAX_PARAMS_PER_FUNCTION
+			|| !check_range(words[1], words[2], v->header->param_count))
+		return (false);
+	for (uint32_t i = 0; i < words[2]; ++i)
+	{
+		const Parameter *p = &v->params[words[1] + i];
+		if (!check_atom(v, remap, p->atom) || (uint32_t)p->type >= CACHE_TYPE_COUNT)
+			return (false);
+	}
+	return (true);
+}
+
+/* Mirrors the layout table in ast.h */
+static bool	check_node(const CacheView *v, const Atom *remap, NodeId id)
+{
+	const ASTNode	*node = &v->nodes[id];
+
+	if (node->value_type >= CACHE_TYPE_COUNT)
+		return (false);
+	if (is_named((ASTNodeType)node->type) && !check_atom(v, remap, node->lhs))
+		return (false);
+	switch ((ASTNodeType)node->type)
+	{
+		case AST_NUMBER:
+		case AST_IDENTIFIER:
+			return (true);
+		case AST_VAR_DECL:
+		case AST_ASSIGNMENT:
+			// Checked before id, so the identifier's own fields already are
+			return (check_child(node->lhs, id) && check_child(node->rhs, id)
+				&& v->nodes[node->lhs].type == AST_IDENTIFIER);
+		case AST_NEGATE:
+		case AST_NOT:
+		case AST_BIT_NOT:
+		case AST_RETURN:
+			return (check_child(node->lhs, id));
+		case AST_IF:
+			return (check_child(node->lhs, id) && check_list(v, id, node->rhs, 2));
+		case AST_BLOCK:
+			return (check_list(v, id, node->lhs, node->rhs));
+		case AST_CALL:
+			return (node->rhs < v->header->extra_count
+				&& check_list(v, id, node->rhs + 1, v->extra[node->rhs]));
+		case AST_FUNCTION:
+			return (check_function(v, remap, id));
+		case AST_TRANSLATION_UNIT:
+			return (id == v->header->root
+				&& check_list(v, id, node->lhs, node->rhs));
+		case AST_ADD: case AST_SUB: case AST_MUL: case AST_DIV:
+		case AST_EQUAL: case AST_NOT_EQUAL: case AST_LESS: case AST_LESS_EQUAL:
+		case AST_GREATER: case AST_GREATER_EQUAL:
+		case AST_LOGICAL_AND: case AST_LOGICAL_OR:
+		case AST_BIT_AND: case AST_BIT_OR: case AST_BIT_XOR:
+		case AST_LSHIFT: case AST_RSHIFT:
+		case AST_WHILE:
+			return (check_child(node->lhs, id) && check_child(node->rhs, id));
+	}
+	return (false);
+}
+
+static bool	check_nodes(const CacheView *v, const Atom *remap)
+{
+	const ASTNode *none = &v->nodes[NODE_NONE];
+
+	if (none->type != AST_NUMBER || none->lhs != 0 || none->rhs != 0
+			|| v->nodes[v->header->root].type != AST_TRANSLATION_UNIT)
+		return (false);
+	for (NodeId id = 1; id < v->header->node_count; ++id)
+	{
+		if (!check_node(v, remap, id))
+			return (false);
+	}
+	return (true);
+}
+
+/*
+ * Interns the names, filling remap. Spellings point into the mapping,
+ * which has to stay around for as long as the table does.
+ */
+static bool	intern_names(const CacheView *v, InternTable *interns, Atom *remap,
+				bool *identity)
+{
+	*identity = true;
+	for (uint32_t i = 0; i < v->header->name_count; ++i)
+	{
+		const AstCacheName *n = &v->names[i];
+		remap[n->atom] = intern(interns, v->text + n->offset, n->length);
+		if (remap[n->atom] == ATOM_NONE)
+			return (false);
+		if (remap[n->atom] != n->atom)
+			*identity = false;
+	}
+	return (true);
+}
+
+/**
+ * @brief Loads the cached AST of file from dir, if there is a valid one
+ *
+ * ast ends up pointing into the mapping, with names in `interns` and any
+ * growth allocated from a. On success map holds the mapping, to be passed
+ * to ast_cache_release once the AST is no longer used. It is also set,
+ * with false returned, if names were already interned when allocation
+ * failed; releasing it is always safe.
+ *
+ * @return false on a miss, leaving ast untouched
+ */
+bool	ast_cache_load(const char *dir, const FileMap *file, InternTable *interns,
+			Arena *a, Ast *ast, AstCacheMap *map)
+{
+	char		path[PATH_MAX];
+	struct stat	st;
+	CacheView	v;
+	uint64_t	hash = content_hash(file->data, file->length, 0);
+
+	*map = (AstCacheMap){0};
+	if (!cache_path(path, dir, hash))
+		return (false);
+	int fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return (false);
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(AstCacheHeader))
+	{
+		close(fd);
+		return (false);
+	}
+	size_t size = (size_t)st.st_size;
+	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return (false);
+
+	// Not scratch: interning may grow the table in the same arena
+	Atom		*remap = NULL;
+	bool		identity;
+	if (!view_init(&v, data, size, file, hash)
+			|| !(remap = arena_alloc_zeroed(a, (v.header->atom_limit + 1) * sizeof(Atom)))
+			|| !check_names(&v, remap) || !check_nodes(&v, remap))
+	{
+		munmap(data, size);
+		return (false);
+	}
+	*map = (AstCacheMap){ data, size };
+	if (!intern_names(&v, interns, remap, &identity))
+		return (false);
+	*ast = (Ast){
+		.nodes = v.nodes,
+		.node_count = v.header->node_count,
+		.node_capacity = v.header->node_count,
+		.extra = v.extra,
+		.extra_count = v.header->extra_count,
+		.extra_capacity = v.header->extra_count,
+		.params = v.params,
+		.param_count = v.header->param_count,
+		.param_capacity = v.header->param_count,
+		.root = v.header->root,
+		.arena = a,
+		.interns = interns
+	};
+	if (!identity)
+		ast_remap_atoms(ast, remap);
+	return (true);
+}
+
+void	ast_cache_release(AstCacheMap *map)
+{
+	if (map->data)
+		munmap(map->data, map->size);
+	*map = (AstCacheMap){0};
+}
+
+/* ---------------------------------------------------------------- */
+/*  Storing                                                         */
+/* ---------------------------------------------------------------- */
+
+static bool	write_all(int fd, const void *data, size_t size)
+{
+	const char *p = data;
+
+	while (size > 0)
+	{
+		ssize_t n = write(fd, p, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return (false);
+		p += n;
+		size -= (size_t)n;
+	}
+	return (true);
+}
+
+/* Collects the atoms ast uses, in atom order, with their spellings */
+static bool	collect_names(const Ast *ast, Arena *scratch, AstCacheHeader *h,
+				AstCacheName **names, char **text)
+{
+	const InternTable	*interns = ast->interns;
+	uint8_t				*used = arena_alloc_zeroed(scratch, interns->count);
+
+	if (!used)
+		return (false);
+	for (NodeId id = 1; id < ast->node_count; ++id)
+	{
+		if (is_named((ASTNodeType)ast->nodes[id].type))
+			used[ast->nodes[id].lhs] = 1;
+	}
+	for (uint32_t i = 0; i < ast->param_count; ++i)
+		used[ast->params[i].atom] = 1;
+	uint64_t text_size = 0;
+	for (Atom atom = 1; atom < interns->count; ++atom)
+	{
+		if (!used[atom])
+			continue;
+		h->name_count++;
+		h->atom_limit = atom + 1;
+		text_size += atom_sv(interns, atom).len;
+	}
+	if (text_size > UINT32_MAX || h->atom_limit > AST_CACHE_MAX_ATOMS)
+		return (false);
+	h->text_size = (uint32_t)text_size;
+	*names = arena_alloc(scratch, (h->name_count + 1) * sizeof(AstCacheName));
+	*text = arena_alloc(scratch, h->text_size + 1);
+	if (!*names || !*text)
+		return (false);
+	uint32_t n = 0;
+	uint32_t offset = 0;
+	for (Atom atom = 1; atom < h->atom_limit; ++atom)
+	{
+		if (!used[atom])
+			continue;
+		StringView sv = atom_sv(interns, atom);
+		memcpy(*text + offset, sv.start, sv.len);
+		(*names)[n++] = (AstCacheName){ atom, offset, sv.len };
+		offset += sv.len;
+	}
+	return (true);
+}
+
+static bool	write_entry(int fd, const Ast *ast, const AstCacheHeader *h,
+				const AstCacheName *names, const char *text)
+{
+	return (write_all(fd, h, sizeof(*h))
+		&& write_all(fd, ast->nodes, (size_t)ast->node_count * sizeof(ASTNode))
+		&& write_all(fd, ast->params, (size_t)ast->param_count * sizeof(Parameter))
+		&& write_all(fd, ast->extra, (size_t)ast->extra_count * sizeof(uint32_t))
+		&& write_all(fd, names, (size_t)h->name_count * sizeof(AstCacheName))
+		&& write_all(fd, text, h->text_size));
+}
+
+/**
+ * @brief Writes the freshly parsed ast of file to dir, creating dir if needed
+ *
+ * Call it before semantic analysis, while the only value types are those
+ * the parser set. A failed store leaves no file behind.
+ *
+ * @return false, with errno set, if the entry could not be written
+ */
+bool	ast_cache_store(const char *dir, const FileMap *file, const Ast *ast,
+			Arena *scratch)
+{
+	char			path[PATH_MAX];
+	char			tmp[PATH_MAX];
+	ArenaTemp		temp = arena_temp_begin(scratch);
+	AstCacheName	*names;
+	char			*text;
+	AstCacheHeader	h = {
+		.magic = AST_CACHE_MAGIC,
+		.version = AST_CACHE_VERSION,
+		.node_size = sizeof(ASTNode),
+		.param_size = sizeof(Parameter),
+		.source_hash = content_hash(file->data, file->length, 0),
+		.source_length = file->length,
+		.node_count = ast->node_count,
+		.param_count = ast->param_count,
+		.extra_count = ast->extra_count,
+		.root = ast->root
+	};
+
+	if (!collect_names(ast, scratch, &h, &names, &text))
+	{
+		arena_temp_end(temp);
+		errno = ENOMEM;
+		return (false);
+	}
+	h.payload_hash = payload_hash(&h, ast->nodes, ast->params, ast->extra,
+			names, text);
+	int n = snprintf(tmp, PATH_MAX, "%s/.%016llx.%ld.tmp", dir,
+			(unsigned long long)h.source_hash, (long)getpid());
+	if (!cache_path(path, dir, h.source_hash) || n <= 0 || n >= PATH_MAX)
+	{
+		arena_temp_end(temp);
+		errno = ENAMETOOLONG;
+		return (false);
+	}
+	if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+	{
+		arena_temp_end(temp);
+		return (false);
+	}
+	int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1)
+	{
+		arena_temp_end(temp);
+		return (false);
+	}
+	bool ok = write_entry(fd, ast, &h, names, text);
+	int saved = errno;
+	ok = (close(fd) == 0) && ok;
+	if (!ok || rename(tmp, path) != 0)
+	{
+		saved = ok ? errno : saved;
+		unlink(tmp);
+		errno = saved;
+		ok = false;
+	}
+	arena_temp_end(temp);
+	return (ok);
+}
@@ -10,45 +10,116 @@ const ParseRule rules[] = {
 	#undef X_TOKEN
 };
 
-ASTNode	*parser_parse(Lexer *lexer, Arena *arena, ErrorContext *errors)
+static NodeId	parse_translation_unit(Parser *parser);
+
+NodeId	parser_parse(Lexer *lexer, Ast *ast, ErrorContext *errors)
+{
+	Parser parser = {0};
+	parser.lexer = lexer;
+	parser.file = lexer->file;
+	parser.arena = ast->arena;
+	parser.ast = ast;
+	parser.errors = errors;
+	return (parse_translation_unit(&parser));
+}
+
+NodeId	parser_parse_stream(TokenStream *ts, Ast *ast, ErrorContext *errors)
+{
+	TokenCursor	cursor;
+	token_cursor_init(&cursor, ts);
+
+	Parser parser = {0};
+	parser.cursor = &cursor;
+	parser.file = ts->file;
+	parser.arena = ast->arena;
+	parser.ast = ast;
+	parser.errors = errors;
+	return (parse_translation_unit(&parser));
+}
+
+/**
+ * @brief parser_parse that only delimits function bodies
+ *
+ * Each body becomes an AST_BLOCK flagged AST_FLAG_LAZY that records where
+ * it sits in the file, for parser_parse_body to parse when it is needed.
+ */
+NodeId	parser_parse_lazy(Lexer *lexer, Ast *ast, ErrorContext *errors)
 {
 	Parser parser = {0};
 	parser.lexer = lexer;
-	parser.arena = arena;
+	parser.file = lexer->file;
+	parser.arena = ast->arena;
+	parser.ast = ast;
+	parser.errors = errors;
+	parser.lazy = true;
+	return (parse_translation_unit(&parser));
+}
+
+/**
+ * @brief Parses the lazy body of func from file, which must be mapped
+ *
+ * The block is appended to ast and replaces the lazy one.
+ *
+ * @return the block, or NODE_NONE if it could not be built
+ */
+NodeId	parser_parse_body(Ast *ast, NodeId func, FileMap *file,
+			InternTable *interns, ErrorContext *errors)
+{
+	NodeId	lazy = ast_function(ast, func).body;
+	Lexer	lexer;
+
+	lexer_init(&lexer, file, interns, errors);
+	lexer.start = file->data + ast_node(ast, lazy)->offset;
+	lexer.curr = lexer.start;
+	lexer.end = file->data + ast_node(ast, lazy)->lhs;
+
+	Parser parser = {0};
+	parser.lexer = &lexer;
+	parser.file = file;
+	parser.arena = ast->arena;
+	parser.ast = ast;
 	parser.errors = errors;
 	parser_advance(&parser);
+	NodeId body = parse_block(&parser);
+	if (body != NODE_NONE)
+		ast->extra[ast_node(ast, func)->rhs] = body;
+	return (body);
+}
+
+static NodeId	parse_translation_unit(Parser *parser)
+{
+	parser_advance(parser);
 
-	ASTNode **declarations = arena_alloc(
-			arena, sizeof(ASTNode*) * MAX_FUNCTION_COUNT);
-	size_t count = 0;
+	uint32_t count = 0;
 
-	while (!check(&parser, TOKEN_EOF))
+	while (!check(parser, TOKEN_EOF))
 	{
-		if (count >= MAX_FUNCTION_COUNT)
+		if (is_type_keyword(parser->next.text))
 		{
-			parser_error(&parser, "too many global declarations (max %d)",
-					MAX_FUNCTION_COUNT);
-			return (NULL);
+			NodeId func = parse_function(parser);
+			if (func != NODE_NONE)
+			{
+				if (!parser_scratch_push(parser, func))
+					return (NODE_NONE);
+				count++;
+			}
 		}
-		if (is_type_keyword(parser.next.text))
-			declarations[count++] = parse_function(&parser);
 		else
 		{
-			parser_error(&parser, "expected function declaration.");
-			return (NULL);
+			parser_error(parser, "expected function declaration.");
+			return (NODE_NONE);
 		}
 	}
 
-	ASTNode *node = arena_alloc(arena, sizeof(ASTNode));
-	*node = (ASTNode){
+	uint32_t start = parser_scratch_flush(parser, 0, false);
+	if (start == UINT32_MAX)
+		return (NODE_NONE);
+	parser->ast->root = parser_add_node(parser, (ASTNode){
 		.type = AST_TRANSLATION_UNIT,
-		.translation_unit = {
-			.declarations = declarations,
-			.count = count
-		}
-	};
-
-	return (node);
+		.lhs = start,
+		.rhs = count
+	});
+	return (parser->ast->root);
 }
 
 const char	*token_type_name(TokenType type)
@@ -1,167 +1,320 @@
+/**
+ * @file
+ * @brief Pratt expression parser with an explicit operator stack
+ *
+ * The prefix and infix rules come from rules[], as in a recursive Pratt
+ * parser, but a rule that needs an operand does not parse it. It pushes
+ * an ExprFrame and returns NODE_PENDING, and parse_expression carries on
+ * with the operand at the precedence the rule asked for. When the operand
+ * is complete, expr_close pops the frame and builds the node. Nesting is
+ * limited only by memory, and nodes are added in the order the recursive
+ * version added them, so the AST is the same.
+ */
+
 #include "parser_internal.h"
+#include <limits.h>
 
-ASTNode	*parse_expression(Parser *parser, Precedence precedence)
+static bool	expr_grow(Parser *parser)
 {
-	if (parser->expr_depth >= MAX_EXPRESSION_DEPTH)
+	uint32_t	capacity = parser->frame_capacity ? parser->frame_capacity * 2 : 32;
+	ExprFrame	*frames = arena_alloc(parser->arena, capacity * sizeof(ExprFrame));
+
+	if (!frames)
 	{
-		parser_error(parser, 
-				"Expression too deeply nested (max %d)",
-				MAX_EXPRESSION_DEPTH);
-		return (NULL);
+		parser_error(parser, "out of memory while building the AST");
+		return (false);
 	}
-	parser->expr_depth++;
-	parser_advance(parser);
-	ParsePrefixFn prefix = rules[parser->current.type].prefix;
+	if (parser->frame_count > 0)
+		memcpy(frames, parser->frames, parser->frame_count * sizeof(ExprFrame));
+	parser->frames = frames;
+	parser->frame_capacity = capacity;
+	return (true);
+}
 
-	if (prefix == NULL)
+/**
+ * @brief Defers the rest of a rule until its operand is parsed
+ *
+ * @return NODE_PENDING, or NODE_NONE if the stack could not grow
+ */
+static inline NodeId	expr_open(Parser *parser, ExprFrame frame,
+							Precedence precedence)
+{
+	if (parser->frame_count >= parser->frame_capacity && !expr_grow(parser))
+		return (NODE_NONE);
+	frame.precedence = (uint8_t)parser->expr_prec;
+	parser->frames[parser->frame_count++] = frame;
+	parser->expr_prec = precedence;
+	return (NODE_PENDING);
+}
+
+static NodeId	finish_call(Parser *parser, const ExprFrame *frame)
+{
+	parser_consume(parser, TOKEN_RPAREN, "Expected ')' after arguments");
+	uint32_t args = parser_scratch_flush(parser, frame->top, true);
+	if (args == UINT32_MAX)
+		return (NODE_NONE);
+	return (parser_add_node(parser, (ASTNode){
+		.type = AST_CALL,
+		.offset = frame->offset,
+		.lhs = frame->lhs,
+		.rhs = args
+	}));
+}
+
+/**
+ * @brief Completes the innermost pending rule with its operand
+ *
+ * @return the finished node, or NODE_PENDING when a call goes on to its
+ * next argument
+ */
+static inline NodeId	expr_close(Parser *parser, NodeId operand)
+{
+	ExprFrame	frame = parser->frames[--parser->frame_count];
+	NodeId		value;
+
+	parser->expr_prec = (Precedence)frame.precedence;
+	switch ((ExprFrameKind)frame.kind)
 	{
-		parser_error(parser, "Expect expression");
-		parser->expr_depth--;
-		return (NULL);
+		case EXPR_UNARY:
+			return (parser_fold(parser, (ASTNode){
+				.type = frame.op, .offset = frame.offset, .lhs = operand }));
+		case EXPR_BINARY:
+			return (parser_fold(parser, (ASTNode){
+				.type = frame.op, .offset = frame.offset,
+				.lhs = frame.lhs, .rhs = operand }));
+		case EXPR_ASSIGN:
+			return (parser_add_node(parser, (ASTNode){
+				.type = AST_ASSIGNMENT, .offset = frame.offset,
+				.lhs = frame.lhs, .rhs = operand }));
+		case EXPR_COMPOUND:
+			value = parser_add_node(parser, (ASTNode){
+				.type = frame.op, .offset = frame.offset,
+				.lhs = frame.lhs, .rhs = operand });
+			return (parser_add_node(parser, (ASTNode){
+				.type = AST_ASSIGNMENT, .offset = frame.offset,
+				.lhs = frame.lhs, .rhs = value }));
+		case EXPR_GROUP:
+			parser_consume(parser, TOKEN_RPAREN, "Expect ')' after expression.");
+			return (operand);
+		case EXPR_CALL:
+			if (operand == NODE_NONE)
+				parser_synchronize(parser);
+			else if (parser_scratch_push(parser, operand)
+					&& match(parser, TOKEN_COMMA))
+				return (expr_open(parser, frame, PREC_ASSIGNMENT));
+			return (finish_call(parser, &frame));
 	}
+	return (NODE_NONE);
+}
 
-	ASTNode *left = prefix(parser);
-	while (precedence < get_token_precedence(parser->next.type))
+/* Applies infix rules to left while they bind tighter than the operand */
+static inline NodeId	parse_infix(Parser *parser, NodeId left)
+{
+	while (parser->expr_prec < rules[parser->next.type].prec)
 	{
 		parser_advance(parser);
 		ParseInfixFn infix = rules[parser->current.type].infix;
 		if (infix)
+		{
 			left = infix(parser, left);
+			if (left == NODE_PENDING)
+				break;
+		}
 	}
-	parser->expr_depth--;
 	return (left);
 }
 
-ASTNode	*parse_assignment(Parser *parser, ASTNode *left)
+NodeId	parse_expression(Parser *parser, Precedence precedence)
 {
-	if (left->type != AST_IDENTIFIER)
+	uint32_t	base = parser->frame_count;
+	Precedence	outer = parser->expr_prec;
+	NodeId		left;
+
+	parser->expr_prec = precedence;
+	while (true)
+	{
+		parser_advance(parser);
+		ParsePrefixFn prefix = rules[parser->current.type].prefix;
+		if (!prefix)
+		{
+			parser_error(parser, "Expect expression");
+			left = NODE_NONE;
+		}
+		else if ((left = prefix(parser)) != NODE_PENDING)
+			left = parse_infix(parser, left);
+		// Close finished operands until a rule asks for another one
+		while (left != NODE_PENDING && parser->frame_count > base)
+		{
+			left = expr_close(parser, left);
+			if (left != NODE_PENDING)
+				left = parse_infix(parser, left);
+		}
+		if (left != NODE_PENDING)
+			break;
+	}
+	parser->expr_prec = outer;
+	return (left);
+}
+
+NodeId	parse_assignment(Parser *parser, NodeId left)
+{
+	if (left == NODE_NONE || ast_type(parser->ast, left) != AST_IDENTIFIER)
 	{
 		parser_error(parser, "Invalid assignment target");
-		return (NULL);
+		return (NODE_NONE);
 	}
-	ASTNode *node = arena_alloc(parser->arena, sizeof(ASTNode));
-	node->type = AST_ASSIGNMENT;
-	node->assignment.var_name = left->identifier.name;
-	node->assignment.value = parse_expression(parser, PREC_ASSIGNMENT);
-	return (node);
+	return (expr_open(parser, (ExprFrame){
+		.kind = EXPR_ASSIGN,
+		.offset = ast_node(parser->ast, left)->offset,
+		.lhs = left
+	}, PREC_ASSIGNMENT));
 }
 
-ASTNode	*parse_unary(Parser *parser)
+/**
+ * @brief x op= e, desugared into x = x op e
+ */
+NodeId	parse_compound_assignment(Parser *parser, NodeId left)
 {
-	TokenType operator_type = parser->current.type;
-	ASTNode *node = arena_alloc(parser->arena, sizeof(ASTNode));
+	TokenType	operator_type = parser->current.type;
+	ASTNodeType	op;
 
+	if (left == NODE_NONE || ast_type(parser->ast, left) != AST_IDENTIFIER)
+	{
+		parser_error(parser, "Invalid assignment target");
+		return (NODE_NONE);
+	}
 	switch (operator_type)
 	{
-		case TOKEN_MINUS:	node->type = AST_NEGATE; break;
-		case TOKEN_BANG:	node->type = AST_NOT; break;
-		case TOKEN_BIT_NOT:	node->type = AST_BIT_NOT; break;
-		default:			node->type = AST_NUMBER; break;
+		case TOKEN_PLUS_EQUAL:		op = AST_ADD; break;
+		case TOKEN_MINUS_EQUAL:		op = AST_SUB; break;
+		case TOKEN_STAR_EQUAL:		op = AST_MUL; break;
+		case TOKEN_SLASH_EQUAL:		op = AST_DIV; break;
+		case TOKEN_AND_EQUAL:		op = AST_BIT_AND; break;
+		case TOKEN_OR_EQUAL:		op = AST_BIT_OR; break;
+		case TOKEN_XOR_EQUAL:		op = AST_BIT_XOR; break;
+		case TOKEN_LSHIFT_EQUAL:	op = AST_LSHIFT; break;
+		case TOKEN_RSHIFT_EQUAL:	op = AST_RSHIFT; break;
+		default:
+			parser_error(parser, "invalid assignment operator");
+			return (NODE_NONE);
 	}
+	return (expr_open(parser, (ExprFrame){
+		.kind = EXPR_COMPOUND,
+		.op = op,
+		.offset = ast_node(parser->ast, left)->offset,
+		.lhs = left
+	}, PREC_ASSIGNMENT));
+}
+
+NodeId	parse_unary(Parser *parser)
+{
+	ExprFrame	frame = { .kind = EXPR_UNARY, .offset = parser->current.offset };
 
-	node->unary.operand = parse_expression(parser, PREC_UNARY);
-	return (node);
+	switch (parser->current.type)
+	{
+		case TOKEN_MINUS:	frame.op = AST_NEGATE; break;
+		case TOKEN_BANG:	frame.op = AST_NOT; break;
+		case TOKEN_BIT_NOT:	frame.op = AST_BIT_NOT; break;
+		default:			frame.op = AST_NUMBER; break;
+	}
+	return (expr_open(parser, frame, PREC_UNARY));
 }
 
-ASTNode	*parse_binary(Parser *parser, ASTNode *left)
+NodeId	parse_binary(Parser *parser, NodeId left)
 {
-	TokenType operator_type = parser->current.type;
-	ASTNode *node = arena_alloc(parser->arena, sizeof(ASTNode));
+	TokenType	operator_type = parser->current.type;
+	ExprFrame	frame = {
+		.kind = EXPR_BINARY,
+		.offset = left != NODE_NONE
+			? ast_node(parser->ast, left)->offset : parser->current.offset,
+		.lhs = left
+	};
 
 	switch (operator_type)
 	{
-		case TOKEN_PLUS:			node->type = AST_ADD; break;
-		case TOKEN_MINUS:			node->type = AST_SUB; break;
-		case TOKEN_STAR:			node->type = AST_MUL; break;
-		case TOKEN_SLASH:			node->type = AST_DIV; break;
-		case TOKEN_EQUAL_EQUAL:		node->type = AST_EQUAL; break;
-		case TOKEN_BANG_EQUAL:		node->type = AST_NOT_EQUAL; break;
-		case TOKEN_LESS:			node->type = AST_LESS; break;
-		case TOKEN_LESS_EQUAL:		node->type = AST_LESS_EQUAL; break;
-		case TOKEN_GREATER:			node->type = AST_GREATER; break;
-		case TOKEN_GREATER_EQUAL:	node->type = AST_GREATER_EQUAL; break;
-		case TOKEN_LSHIFT:			node->type = AST_LSHIFT; break;
-		case TOKEN_RSHIFT:			node->type = AST_RSHIFT; break;
-		case TOKEN_BIT_AND:			node->type = AST_BIT_AND; break;
-		case TOKEN_BIT_OR:			node->type = AST_BIT_OR; break;
-		case TOKEN_BIT_XOR:			node->type = AST_BIT_XOR; break;
+		case TOKEN_PLUS:			frame.op = AST_ADD; break;
+		case TOKEN_MINUS:			frame.op = AST_SUB; break;
+		case TOKEN_STAR:			frame.op = AST_MUL; break;
+		case TOKEN_SLASH:			frame.op = AST_DIV; break;
+		case TOKEN_EQUAL_EQUAL:		frame.op = AST_EQUAL; break;
+		case TOKEN_BANG_EQUAL:		frame.op = AST_NOT_EQUAL; break;
+		case TOKEN_LESS:			frame.op = AST_LESS; break;
+		case TOKEN_LESS_EQUAL:		frame.op = AST_LESS_EQUAL; break;
+		case TOKEN_GREATER:			frame.op = AST_GREATER; break;
+		case TOKEN_GREATER_EQUAL:	frame.op = AST_GREATER_EQUAL; break;
+		case TOKEN_LSHIFT:			frame.op = AST_LSHIFT; break;
+		case TOKEN_RSHIFT:			frame.op = AST_RSHIFT; break;
+		case TOKEN_BIT_AND:			frame.op = AST_BIT_AND; break;
+		case TOKEN_BIT_OR:			frame.op = AST_BIT_OR; break;
+		case TOKEN_BIT_XOR:			frame.op = AST_BIT_XOR; break;
+		case TOKEN_AND_AND:			frame.op = AST_LOGICAL_AND; break;
+		case TOKEN_OR_OR:			frame.op = AST_LOGICAL_OR; break;
 		default: 
 			parser_error(parser, "invalid binary operator");
-			return (NULL);
+			return (NODE_NONE);
 	}
+	return (expr_open(parser, frame, rules[operator_type].prec));
+}
 
-	Precedence precedence = get_token_precedence(operator_type);
-	node->binary.left = left;
-	node->binary.right = parse_expression(parser, (Precedence)(precedence));
-	return (node);
+/* Types a literal as C would, int64 standing in for long where unsuffixed */
+static DataType	literal_type(uint64_t value, uint8_t flags)
+{
+	if (flags & LITERAL_UNSIGNED)
+	{
+		if ((flags & LITERAL_LONG) || value > UINT32_MAX)
+			return (TYPE_UINT64);
+		return (TYPE_UINT32);
+	}
+	if (flags & LITERAL_LONG)
+		return (TYPE_LONG);
+	if ((int64_t)value >= INT_MIN && (int64_t)value <= INT_MAX)
+		return (TYPE_INT);
+	return (TYPE_INT64);
 }
 
-ASTNode	*parse_number(Parser *parser)
+NodeId	parse_number(Parser *parser)
 {
-	ASTNode	*node = arena_alloc(parser->arena, sizeof(ASTNode));
-	node->type = AST_NUMBER;
-	node->number.value = parser->current.text;
-	node->line = parser->current.line;
-	return (node);
+	uint64_t value = parser->current.value;
+	uint8_t flags = parser->current.literal_flags;
+	return (parser_add_node(parser, (ASTNode){
+		.type = AST_NUMBER,
+		.value_type = literal_type(value, flags),
+		.flags = flags,
+		.offset = parser->current.offset,
+		.lhs = (uint32_t)value,
+		.rhs = (uint32_t)(value >> 32)
+	}));
 }
 
-ASTNode	*parse_grouping(Parser *parser)
+NodeId	parse_grouping(Parser *parser)
 {
-	ASTNode	*expression = parse_expression(parser, PREC_NONE);
-	parser_consume(parser, TOKEN_RPAREN, "Expect ')' after expression.");
-	return (expression);
+	return (expr_open(parser, (ExprFrame){ .kind = EXPR_GROUP }, PREC_NONE));
 }
 
-ASTNode	*parse_identifier(Parser *parser)
+NodeId	parse_identifier(Parser *parser)
 {
-	ASTNode *node = arena_alloc(parser->arena, sizeof(ASTNode));
-	node->type = AST_IDENTIFIER;
-	node->identifier.name = parser->current.text;
-	node->line = parser->current.line;
-	return (node);
+	return (parser_add_node(parser, (ASTNode){
+		.type = AST_IDENTIFIER,
+		.offset = parser->current.offset,
+		.lhs = parser->current.atom
+	}));
 }
 
-ASTNode	*parse_call(Parser *parser, ASTNode *callee)
+NodeId	parse_call(Parser *parser, NodeId callee)
 {
-	if (callee->type != AST_IDENTIFIER)
+	if (callee == NODE_NONE || ast_type(parser->ast, callee) != AST_IDENTIFIER)
 	{
 		parser_error(parser, "Can only call functions");
-		return (NULL);
+		return (NODE_NONE);
 	}
 
-	ASTNode *node = arena_alloc(parser->arena, sizeof(ASTNode));
-	node->type = AST_CALL;
-	node->call.function_name = callee->identifier.name;
-	node->line = callee->line;
-	node->column = callee->column;
-
-	ASTNode **args = arena_alloc(parser->arena, sizeof(ASTNode*) * MAX_PARAMS_PER_FUNCTION);
-	size_t arg_count = 0;
-
-	if (!check(parser, TOKEN_RPAREN))
-	{
-		do
-		{
-			if (arg_count >= MAX_PARAMS_PER_FUNCTION)
-			{
-				parser_error(parser, "Too many arguments (max %d)",
-						MAX_PARAMS_PER_FUNCTION);
-				parser_synchronize(parser);
-				break;
-			}
-			ASTNode *arg = parse_expression(parser, PREC_ASSIGNMENT);
-			if (!arg)
-			{
-				parser_synchronize(parser);
-				break;
-			}
-			args[arg_count++] = arg;
-		} while (match(parser, TOKEN_COMMA));
-	}
-
-	parser_consume(parser, TOKEN_RPAREN, "Expected ')' after arguments");
-	node->call.args = args;
-	node->call.arg_count = arg_count;
-
-	return (node);
+	ExprFrame frame = {
+		.kind = EXPR_CALL,
+		.offset = ast_node(parser->ast, callee)->offset,
+		.lhs = ast_node(parser->ast, callee)->lhs,
+		.top = parser->scratch_count
+	};
+	if (check(parser, TOKEN_RPAREN))
+		return (finish_call(parser, &frame));
+	return (expr_open(parser, frame, PREC_ASSIGNMENT));
 }
@@ -0,0 +1,256 @@
+/**
+ * @file
+ * @brief Constant folding of literal-only expressions while parsing
+ *
+ * An operator whose operands are both AST_NUMBER becomes a single
+ * AST_NUMBER. Its value_type is the type semantic analysis gives the
+ * operator, and its value is what C computes: operands go through the
+ * usual arithmetic conversions, unsigned results wrap, comparisons and
+ * logical operators give 0 or 1 and right shifts of signed values are
+ * arithmetic. Signed overflow, division by zero and shifts by a negative
+ * count or by the width of the type or more have no value in C, so such
+ * an operator is kept and evaluated at run time, as is a result its
+ * operator type cannot hold.
+ */
+
+#include "parser_internal.h"
+
+static uint64_t	type_mask(DataType type)
+{
+	if (type_size(type) >= 8)
+		return (UINT64_MAX);
+	return ((1ull << (type_size(type) * 8)) - 1);
+}
+
+/* value converted to type, keeping the low bits as C implementations do */
+static int64_t	wrap(uint64_t value, DataType type)
+{
+	uint64_t	mask = type_mask(type);
+
+	value &= mask;
+	if (type_is_signed(type) && (value & ~(mask >> 1)))
+		value |= ~mask;
+	return ((int64_t)value);
+}
+
+/* Whether value, unsigned or not, is one of type's values */
+static bool	holds(DataType type, int64_t value, bool is_unsigned)
+{
+	uint64_t	max = type_is_signed(type) ? type_mask(type) >> 1 : type_mask(type);
+
+	if (is_unsigned || value >= 0)
+		return ((uint64_t)value <= max);
+	return (type_is_signed(type) && value >= -(int64_t)max - 1);
+}
+
+static bool	fold_arithmetic(ASTNodeType op, int64_t a, int64_t b,
+				DataType type, int64_t *out)
+{
+	if (type_is_unsigned(type))
+	{
+		uint64_t	x = (uint64_t)a;
+		uint64_t	y = (uint64_t)b;
+
+		switch (op)
+		{
+			case AST_ADD:	*out = wrap(x + y, type); return (true);
+			case AST_SUB:	*out = wrap(x - y, type); return (true);
+			case AST_MUL:	*out = wrap(x * y, type); return (true);
+			case AST_DIV:
+				if (y == 0)
+					return (false);
+				*out = wrap(x / y, type);
+				return (true);
+			default:		return (false);
+		}
+	}
+	switch (op)
+	{
+		case AST_ADD:
+			return (!__builtin_add_overflow(a, b, out) && holds(type, *out, false));
+		case AST_SUB:
+			return (!__builtin_sub_overflow(a, b, out) && holds(type, *out, false));
+		case AST_MUL:
+			return (!__builtin_mul_overflow(a, b, out) && holds(type, *out, false));
+		case AST_DIV:
+			if (b == 0 || (a == INT64_MIN && b == -1))
+				return (false);
+			*out = a / b;
+			return (holds(type, *out, false));
+		default:
+			return (false);
+	}
+}
+
+static bool	fold_shift(ASTNodeType op, int64_t a, int64_t b, bool b_unsigned,
+				DataType type, int64_t *out)
+{
+	int		bits = (int)type_size(type) * 8;
+
+	if ((!b_unsigned && b < 0) || (uint64_t)b >= (uint64_t)bits)
+		return (false);
+	if (type_is_unsigned(type))
+	{
+		uint64_t x = (uint64_t)a;
+		*out = wrap(op == AST_LSHIFT ? x << b : x >> b, type);
+		return (true);
+	}
+	if (op == AST_RSHIFT)
+	{
+		*out = a >> b;
+		return (true);
+	}
+	// A signed left shift is defined while the result is representable
+	if (a < 0 || (uint64_t)a > (type_mask(type) >> 1) >> b)
+		return (false);
+	*out = (int64_t)((uint64_t)a << b);
+	return (true);
+}
+
+static bool	fold_compare(ASTNodeType op, int64_t a, int64_t b, bool is_unsigned)
+{
+	int	order;
+
+	if (is_unsigned)
+		order = ((uint64_t)a > (uint64_t)b) - ((uint64_t)a < (uint64_t)b);
+	else
+		order = (a > b) - (a < b);
+	switch (op)
+	{
+		case AST_EQUAL:			return (order == 0);
+		case AST_NOT_EQUAL:		return (order != 0);
+		case AST_LESS:			return (order < 0);
+		case AST_LESS_EQUAL:	return (order <= 0);
+		case AST_GREATER:		return (order > 0);
+		default:				return (order >= 0);
+	}
+}
+
+/**
+ * @brief Value and type of binary op on two numbers
+ *
+ * The result type follows semantic analysis: the larger operand for
+ * arithmetic, the left one promoted to int for bitwise operators and
+ * shifts, int64 for comparisons and logical operators.
+ */
+static bool	fold_binary(const ASTNode *node, const ASTNode *l, const ASTNode *r,
+				ASTNode *out)
+{
+	DataType	lt = (DataType)l->value_type;
+	DataType	rt = (DataType)r->value_type;
+	DataType	common = type_promote(lt, rt);
+	int64_t		a = wrap((uint64_t)ast_number(l), common);
+	int64_t		b = wrap((uint64_t)ast_number(r), common);
+	int64_t		value;
+	DataType	type;
+
+	switch ((ASTNodeType)node->type)
+	{
+		case AST_ADD: case AST_SUB: case AST_MUL: case AST_DIV:
+			type = type_size(lt) >= type_size(rt) ? lt : rt;
+			if (!fold_arithmetic(node->type, a, b, common, &value)
+					|| !holds(type, value, type_is_unsigned(common)))
+				return (false);
+			break;
+		case AST_BIT_AND: case AST_BIT_OR: case AST_BIT_XOR:
+			type = type_size(lt) < type_size(TYPE_INT) ? TYPE_INT : lt;
+			if (node->type == AST_BIT_AND)
+				value = a & b;
+			else if (node->type == AST_BIT_OR)
+				value = a | b;
+			else
+				value = a ^ b;
+			if (!holds(type, value, type_is_unsigned(common)))
+				return (false);
+			break;
+		case AST_LSHIFT: case AST_RSHIFT:
+			type = type_size(lt) < type_size(TYPE_INT) ? TYPE_INT : lt;
+			if (!fold_shift(node->type, ast_number(l), ast_number(r),
+						type_is_unsigned(rt), type, &value))
+				return (false);
+			break;
+		case AST_EQUAL: case AST_NOT_EQUAL: case AST_LESS: case AST_LESS_EQUAL:
+		case AST_GREATER: case AST_GREATER_EQUAL:
+			type = TYPE_INT64;
+			value = fold_compare(node->type, a, b, type_is_unsigned(common));
+			break;
+		case AST_LOGICAL_AND:
+			type = TYPE_INT64;
+			value = ast_number(l) != 0 && ast_number(r) != 0;
+			break;
+		case AST_LOGICAL_OR:
+			type = TYPE_INT64;
+			value = ast_number(l) != 0 || ast_number(r) != 0;
+			break;
+		default:
+			return (false);
+	}
+	out->value_type = type;
+	out->lhs = (uint32_t)value;
+	out->rhs = (uint32_t)((uint64_t)value >> 32);
+	return (true);
+}
+
+static bool	fold_unary(const ASTNode *node, const ASTNode *operand, ASTNode *out)
+{
+	DataType	type = (DataType)operand->value_type;
+	int64_t		a = ast_number(operand);
+	int64_t		value;
+
+	switch ((ASTNodeType)node->type)
+	{
+		case AST_NEGATE:
+			if (type_is_unsigned(type))
+				value = wrap(-(uint64_t)a, type);
+			else if (a == INT64_MIN || !holds(type, -a, false))
+				return (false);
+			else
+				value = -a;
+			break;
+		case AST_BIT_NOT:
+			value = wrap(~(uint64_t)a, type);
+			break;
+		case AST_NOT:
+			type = TYPE_INT64;
+			value = (a == 0);
+			break;
+		default:
+			return (false);
+	}
+	out->value_type = type;
+	out->lhs = (uint32_t)value;
+	out->rhs = (uint32_t)((uint64_t)value >> 32);
+	return (true);
+}
+
+static bool	is_number(const Parser *parser, NodeId id)
+{
+	return (id != NODE_NONE && ast_type(parser->ast, id) == AST_NUMBER);
+}
+
+/**
+ * @brief Adds a unary or binary operator node, or the number it folds to
+ *
+ * The operands of a folded node are the last nodes added whenever they
+ * are numbers themselves, so their slots are reused and a constant
+ * subexpression ends up as one node.
+ */
+NodeId	parser_fold(Parser *parser, ASTNode node)
+{
+	Ast		*ast = parser->ast;
+	bool	binary = (node.type != AST_NEGATE && node.type != AST_NOT
+				&& node.type != AST_BIT_NOT);
+	ASTNode	folded = { .type = AST_NUMBER, .offset = node.offset };
+
+	if (!is_number(parser, node.lhs) || (binary && !is_number(parser, node.rhs)))
+		return (parser_add_node(parser, node));
+	if (binary ? !fold_binary(&node, ast_node(ast, node.lhs),
+				ast_node(ast, node.rhs), &folded)
+			: !fold_unary(&node, ast_node(ast, node.lhs), &folded))
+		return (parser_add_node(parser, node));
+	if (binary && node.lhs + 2 == ast->node_count && node.rhs + 1 == ast->node_count)
+		ast->node_count = node.lhs;
+	else if (!binary && node.lhs + 1 == ast->node_count)
+		ast->node_count = node.lhs;
+	return (parser_add_node(parser, folded));
+}
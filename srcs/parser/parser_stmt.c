@@ -1,7 +1,7 @@
 #include "ast.h"
 #include "parser_internal.h"
 
-ASTNode	*parse_statement(Parser *parser)
+NodeId	parse_statement(Parser *parser)
 {
 	TokenType type = parser->next.type;
 	ParseStmtFn stmt_fn = rules[type].stmt;
@@ -11,62 +11,77 @@ ASTNode	*parse_statement(Parser *parser)
 	return (parse_expr_stmt(parser));
 }
 
-ASTNode* parse_block(Parser *parser)
+NodeId	parse_block(Parser *parser)
 {
 	parser_consume(parser, TOKEN_LBRACE, "Expected '{'");
+	uint32_t block_offset = parser->current.offset;
 	
-	ASTNode **stmts = arena_alloc(
-			parser->arena, sizeof(ASTNode*) * MAX_BLOCK_STATEMENTS);
-	size_t count = 0;
+	uint32_t top = parser->scratch_count;
 	
 	while (!check(parser, TOKEN_RBRACE) 
 			&& !check(parser, TOKEN_EOF))
 	{
-		if (count >= MAX_BLOCK_STATEMENTS)
-		{
-			parser_error(parser, 
-					"Block too large (max %d statements)",
-					MAX_BLOCK_STATEMENTS);
+		NodeId stmt = parse_statement(parser);
+		if (stmt == NODE_NONE)
 			parser_synchronize(parser);
+		else if (!parser_scratch_push(parser, stmt))
 			break;
-		}
-		ASTNode *stmt = parse_statement(parser);
-		if (stmt)
-			stmts[count++] = stmt;
-		else
-			parser_synchronize(parser);
 	}
 	
 	parser_consume(parser, TOKEN_RBRACE, "Expected '}'");
-	ASTNode *node = arena_alloc(parser->arena, sizeof(ASTNode));
-	*node = (ASTNode){
+	uint32_t count = parser->scratch_count - top;
+	uint32_t start = parser_scratch_flush(parser, top, false);
+	if (start == UINT32_MAX)
+		return (NODE_NONE);
+	return (parser_add_node(parser, (ASTNode){
 		.type = AST_BLOCK,
-		.block = {
-			.statements = stmts,
-			.count = count
-		}
-	};
-	return (node);
+		.offset = block_offset,
+		.lhs = start,
+		.rhs = count
+	}));
 }
 
-ASTNode	*parse_function(Parser *parser)
+/* Records where a body starts and ends, see parser_parse_lazy */
+static NodeId	skip_body(Parser *parser)
 {
+	uint32_t	open = parser->next.offset;
+	const char	*inside = parser->lexer->curr;
+
+	// A malformed body is parsed after all, for the usual diagnostics
+	if (!check(parser, TOKEN_LBRACE) || !lexer_skip_block(parser->lexer))
+	{
+		parser->lexer->curr = inside;
+		return (parse_block(parser));
+	}
+	parser_advance(parser);
+	parser_consume(parser, TOKEN_RBRACE, "Expected '}'");
+	return (parser_add_node(parser, (ASTNode){
+		.type = AST_BLOCK,
+		.flags = AST_FLAG_LAZY,
+		.offset = open,
+		.lhs = parser->current.offset + 1
+	}));
+}
+
+NodeId	parse_function(Parser *parser)
+{
+	uint32_t decl_offset = parser->next.offset;
 	DataType return_type = parse_type(parser);
 	if (parser->panic_mode)
-		return (NULL);
+		return (NODE_NONE);
 
 	parser_consume(parser, TOKEN_IDENTIFIER, "expected function name.");
-	StringView func_name = parser->current.text;
-	int func_line = parser->current.line;
+	Atom func_atom = parser->current.atom;
+	uint32_t func_offset = parser->current.offset;
 
 	parser_consume(parser, TOKEN_LPAREN, "expected '(' after function name.");
 
-	Parameter *params = NULL;
+	// Nothing else adds parameters until the body, so they go straight in
+	uint32_t first_param = parser->ast->param_count;
 	size_t param_count = 0;
 
 	if (!check(parser, TOKEN_RPAREN))
 	{
-		params = arena_alloc(parser->arena, sizeof(Parameter) * 16);
 		if (check(parser, TOKEN_VOID))
 			parser_advance(parser);
 		else
@@ -75,128 +90,129 @@ ASTNode	*parse_function(Parser *parser)
 			{
 				DataType param_type = parse_type(parser);
 				parser_consume(parser, TOKEN_IDENTIFIER, "expected parameter name");
-				params[param_count++] = (Parameter){
-					.name = parser->current.text,
+				Parameter param = {
+					.atom = parser->current.atom,
 					.type = param_type
 				};
+				if (ast_add_params(parser->ast, &param, 1) == UINT32_MAX)
+				{
+					parser_error(parser, "out of memory while building the AST");
+					return (NODE_NONE);
+				}
+				param_count++;
 			} while (match(parser, TOKEN_COMMA));
 		}
 	}
 
 	parser_consume(parser, TOKEN_RPAREN, "expected ')' after parameters.");
 
-	ASTNode *body = NULL;
+	NodeId body = NODE_NONE;
 	bool is_prototype = false;
 	if (match(parser, TOKEN_SEMICOLON))
 		is_prototype = true;
+	else if (parser->lazy)
+		body = skip_body(parser);
 	else
 		body = parse_block(parser);
 
-	ASTNode *node = arena_alloc(parser->arena, sizeof(ASTNode));
-	*node = (ASTNode){
+	uint32_t extra[4] = { body, first_param, (uint32_t)param_count, decl_offset };
+	uint32_t start = parser_add_extra(parser, extra, 4);
+	if (start == UINT32_MAX)
+		return (NODE_NONE);
+	return (parser_add_node(parser, (ASTNode){
 		.type = AST_FUNCTION,
 		.value_type = return_type,
-		.line = func_line,
-		.column = parser->current.column,
-		.function = {
-			.name = func_name,
-			.return_type = return_type,
-			.params = params,
-			.param_count = param_count,
-			.body = body,
-			.is_prototype = is_prototype
-		}
-	};
-	return (node);
+		.flags = is_prototype ? AST_FLAG_PROTOTYPE : 0,
+		.offset = func_offset,
+		.lhs = func_atom,
+		.rhs = start
+	}));
 }
 
-ASTNode	*parse_var_decl(Parser *parser)
+NodeId	parse_var_decl(Parser *parser)
 {
 	DataType	var_type = parse_type(parser);
 
 	if (parser->panic_mode)
-		return (NULL);
+		return (NODE_NONE);
 	parser_consume(parser, TOKEN_IDENTIFIER, "expected variable name");
-	StringView var_name = parser->current.text;
-	int var_line = parser->current.line;
-	ASTNode *init = NULL;
+	uint32_t var_offset = parser->current.offset;
+	NodeId name = parser_add_node(parser, (ASTNode){
+		.type = AST_IDENTIFIER,
+		.offset = var_offset,
+		.lhs = parser->current.atom
+	});
+	NodeId init = NODE_NONE;
 	if (match(parser, TOKEN_EQUAL))
 		init = parse_expression(parser, PREC_NONE);
 	parser_consume(parser, TOKEN_SEMICOLON, "expected ';'");
-	ASTNode *node = arena_alloc(parser->arena, sizeof(ASTNode));
-	*node = (ASTNode){
+	return (parser_add_node(parser, (ASTNode){
 		.type = AST_VAR_DECL,
 		.value_type = var_type,
-		.line = var_line,
-		.var_decl = { 
-			.var_name = var_name, 
-			.var_type = var_type,
-			.initializer = init 
-		}
-	};
-	return (node);
+		.offset = var_offset,
+		.lhs = name,
+		.rhs = init
+	}));
 }
 
-ASTNode	*parse_return(Parser *parser)
+NodeId	parse_return(Parser *parser)
 {
 	parser_consume(parser, TOKEN_RETURN, "expected 'return'");
-	int ret_line = parser->current.line;
-	ASTNode *expr = NULL;
+	uint32_t ret_offset = parser->current.offset;
+	NodeId expr = NODE_NONE;
 	if (!check(parser, TOKEN_SEMICOLON))
 		expr = parse_expression(parser, PREC_NONE);
 	parser_consume(parser, TOKEN_SEMICOLON, "expected ';'");
-	ASTNode *node = arena_alloc(parser->arena, sizeof(ASTNode));
-	*node = (ASTNode){
+	return (parser_add_node(parser, (ASTNode){
 		.type = AST_RETURN,
 		.value_type = TYPE_VOID,
-		.line = ret_line,
-		.return_stmt = { .expression = expr }
-	};
-	return (node);
+		.offset = ret_offset,
+		.lhs = expr
+	}));
 }
 
-ASTNode	*parse_if(Parser *parser)
+NodeId	parse_if(Parser *parser)
 {
 	parser_consume(parser, TOKEN_IF, "expected 'if'");
-	int if_line = parser->current.line;
+	uint32_t if_offset = parser->current.offset;
 	parser_consume(parser, TOKEN_LPAREN, "expected '('");
-	ASTNode *condition = parse_expression(parser, PREC_NONE);
+	NodeId condition = parse_expression(parser, PREC_NONE);
 	parser_consume(parser, TOKEN_RPAREN, "expected ')'");
-	ASTNode *then_branch = parse_statement(parser);
-	ASTNode *else_branch = NULL;
+	NodeId branches[2] = { parse_statement(parser), NODE_NONE };
 	if (match(parser, TOKEN_ELSE))
-		else_branch = parse_statement(parser);
-	ASTNode *node = arena_alloc(parser->arena, sizeof(ASTNode));
-	*node = (ASTNode){
+		branches[1] = parse_statement(parser);
+	uint32_t start = parser_add_extra(parser, branches, 2);
+	if (start == UINT32_MAX)
+		return (NODE_NONE);
+	return (parser_add_node(parser, (ASTNode){
 		.type = AST_IF,
 		.value_type = TYPE_VOID,
-		.line = if_line,
-		.if_stmt = { condition, then_branch, else_branch }
-	};
-	return (node);
+		.offset = if_offset,
+		.lhs = condition,
+		.rhs = start
+	}));
 }
 
-ASTNode	*parse_while(Parser *parser)
+NodeId	parse_while(Parser *parser)
 {
 	parser_consume(parser, TOKEN_WHILE, "expected 'while'");
-	int while_line = parser->current.line;
+	uint32_t while_offset = parser->current.offset;
 	parser_consume(parser, TOKEN_LPAREN, "expected '('");
-	ASTNode *condition = parse_expression(parser, PREC_NONE);
+	NodeId condition = parse_expression(parser, PREC_NONE);
 	parser_consume(parser, TOKEN_RPAREN, "expected ')'");
-	ASTNode *body = parse_statement(parser);
-	ASTNode *node = arena_alloc(parser->arena, sizeof(ASTNode));
-	*node = (ASTNode){
+	NodeId body = parse_statement(parser);
+	return (parser_add_node(parser, (ASTNode){
 		.type = AST_WHILE,
 		.value_type = TYPE_VOID,
-		.line = while_line,
-		.while_stmt = { condition, body }
-	};
-	return (node);
+		.offset = while_offset,
+		.lhs = condition,
+		.rhs = body
+	}));
 }
 
-ASTNode	*parse_expr_stmt(Parser *parser)
+NodeId	parse_expr_stmt(Parser *parser)
 {
-	ASTNode *expr = parse_expression(parser, PREC_NONE);
+	NodeId expr = parse_expression(parser, PREC_NONE);
 	parser_consume(parser, TOKEN_SEMICOLON, "expected ';'");
 	return (expr);
 }
@@ -3,6 +3,11 @@
 void	parser_advance(Parser *parser)
 {
 	parser->current = parser->next;
+	if (parser->cursor)
+	{
+		parser->next = token_cursor_next(parser->cursor);
+		return;
+	}
 	while (true)
 	{
 		parser->next = lexer_next(parser->lexer);
@@ -35,8 +40,9 @@ void parser_error(Parser *parser, const char *fmt, ...)
 	vsnprintf(buffer, sizeof(buffer), fmt, args);
 	va_end(args);
 
-	error_parser(parser->errors, parser->lexer->file->name,
-			parser->current.line, parser->current.column,
+	// Anchor just past the current token, where the expected one was missing
+	error_parser(parser->errors, parser->file,
+			parser->current.offset + (uint32_t)parser->current.text.len,
 			"%s", buffer);
 }
 
@@ -88,3 +94,67 @@ DataType	parse_type(Parser *parser)
 	return (TYPE_VOID);
 }
 
+
+NodeId	parser_add_node(Parser *parser, ASTNode node)
+{
+	NodeId id = ast_add_node(parser->ast, node);
+	if (id == NODE_NONE)
+		parser_error(parser, "out of memory while building the AST");
+	return (id);
+}
+
+uint32_t	parser_add_extra(Parser *parser, const uint32_t *words, uint32_t count)
+{
+	uint32_t start = ast_add_extra(parser->ast, words, count);
+	if (start == UINT32_MAX)
+		parser_error(parser, "out of memory while building the AST");
+	return (start);
+}
+
+/**
+ * @brief Pushes a child onto the list being collected
+ *
+ * Lists nest, so a block, call or translation unit remembers scratch_count
+ * when it opens and flushes everything above that when it closes. The
+ * stack is reused for the whole parse and only grows with nesting.
+ */
+bool	parser_scratch_push(Parser *parser, NodeId id)
+{
+	if (parser->scratch_count >= parser->scratch_capacity)
+	{
+		uint32_t capacity = parser->scratch_capacity
+			? parser->scratch_capacity * 2 : 64;
+		NodeId *scratch = arena_alloc(parser->arena, capacity * sizeof(NodeId));
+		if (!scratch)
+		{
+			parser_error(parser, "out of memory while building the AST");
+			return (false);
+		}
+		if (parser->scratch_count > 0)
+			memcpy(scratch, parser->scratch, parser->scratch_count * sizeof(NodeId));
+		parser->scratch = scratch;
+		parser->scratch_capacity = capacity;
+	}
+	parser->scratch[parser->scratch_count++] = id;
+	return (true);
+}
+
+/**
+ * @brief Moves the list above top into Ast.extra, exactly sized
+ *
+ * @param counted prefix the list with its length, as AST_CALL expects
+ * @return index of the list in Ast.extra, or UINT32_MAX on failure
+ */
+uint32_t	parser_scratch_flush(Parser *parser, uint32_t top, bool counted)
+{
+	uint32_t	count = parser->scratch_count - top;
+	uint32_t	start = parser->ast->extra_count;
+
+	parser->scratch_count = top;
+	if (counted && parser_add_extra(parser, &count, 1) == UINT32_MAX)
+		return (UINT32_MAX);
+	if (count > 0
+			&& parser_add_extra(parser, parser->scratch + top, count) == UINT32_MAX)
+		return (UINT32_MAX);
+	return (start);
+}
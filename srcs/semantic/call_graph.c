@@ -0,0 +1,287 @@
+/**
+ * @file
+ * @brief Call graph of the whole program, what its entry point reaches and
+ * what each call may do
+ *
+ * Edges come from the AST_CALL nodes of each definition. The subtree of a
+ * top-level declaration is the run of nodes after the root of the one
+ * before it, so the calls of a function are found by scanning that run
+ * rather than walking its tree. Calls to names that are not declared,
+ * which semantic analysis reports, have no edge.
+ *
+ * The same scan gives the effects of a body on its own. A call has those
+ * of the callee and of everything the callee calls, and a function without
+ * a definition, which is defined outside the program, may do anything.
+ * Nothing in the language reaches outside a function's frame yet, so only
+ * such functions are impure; a global or a pointer would add to
+ * body_effect.
+ */
+
+#include "semantic.h"
+#include "compile.h"
+#include <string.h>
+
+/* What node may do on its own, leaving aside any call */
+static uint8_t	body_effect(const Ast *ast, const ASTNode *node)
+{
+	const ASTNode	*divisor;
+
+	switch (node->type)
+	{
+		case AST_WHILE:
+			return (EFFECT_LOOPS);
+		case AST_DIV:
+			// Only a constant other than 0 and -1 cannot fault
+			divisor = ast_node(ast, node->rhs);
+			if (divisor->type == AST_NUMBER && ast_number(divisor) != 0
+					&& ast_number(divisor) != -1)
+				return (0);
+			return (EFFECT_TRAPS);
+		default:
+			return (0);
+	}
+}
+
+/*
+ * Visits the callees of the definition whose nodes are [from, to] that
+ * seen does not hold stamp for yet. With fill they are stored from *fill
+ * on, otherwise only counted into first[caller + 1]. Returns the effects
+ * of the body itself.
+ */
+static uint8_t	scan_definition(CallGraph *graph, GlobalScope *global,
+				const Ast *ast, NodeId from, NodeId to, uint32_t *seen,
+				uint32_t stamp, uint32_t *fill)
+{
+	uint8_t	effects = 0;
+
+	for (NodeId id = from; id <= to; ++id)
+	{
+		effects |= body_effect(ast, ast_node(ast, id));
+		if (ast_type(ast, id) != AST_CALL)
+			continue;
+		FunctionInfo *callee = semantic_global_lookup_function(global,
+				ast_node(ast, id)->lhs);
+		if (!callee)
+			continue;
+		uint32_t index = (uint32_t)(callee - global->functions);
+		if (seen[index] == stamp)
+			continue;
+		seen[index] = stamp;
+		if (fill)
+			graph->callees[(*fill)++] = index;
+		else
+			graph->first[stamp]++;
+	}
+	return (effects);
+}
+
+/* One pass over every definition: counting the edges, or with fill storing them */
+static void	scan_program(CallGraph *graph, GlobalScope *global,
+				CompilationUnit *units, size_t unit_count, uint32_t *seen,
+				bool fill)
+{
+	memset(seen, 0, graph->function_count * sizeof(uint32_t));
+	for (size_t i = 0; i < unit_count; ++i)
+	{
+		const Ast		*ast = &units[i].ast;
+		uint32_t		count;
+		const NodeId	*decls;
+
+		if (!units[i].parsed_ok)
+			continue;
+		decls = ast_list(ast, ast->root, &count);
+		for (uint32_t j = 0; j < count; ++j)
+		{
+			NodeId			from = j > 0 ? decls[j - 1] + 1 : 1;
+			FunctionInfo	*info = semantic_global_lookup_function(global,
+					ast_node(ast, decls[j])->lhs);
+
+			if (!info || ast_function(ast, decls[j]).is_prototype)
+				continue;
+			// Stamps are caller + 1, which also indexes its count in first
+			uint32_t caller = (uint32_t)(info - global->functions);
+			uint32_t next = graph->first[caller];
+			graph->effects[caller] = scan_definition(graph, global, ast, from,
+					decls[j], seen, caller + 1, fill ? &next : NULL);
+		}
+	}
+}
+
+/**
+ * @brief Builds graph from the definitions of units
+ *
+ * Every function in global gets an entry, prototypes with no callees.
+ * The graph lives in a and indices stay valid as long as global does.
+ * Effects are those of each body alone until call_graph_find_effects.
+ */
+bool	call_graph_build(CallGraph *graph, Arena *a, GlobalScope *global,
+			CompilationUnit *units, size_t unit_count, ErrorContext *errors)
+{
+	size_t		n = global->function_count;
+	size_t		calls = 0;
+	uint32_t	*seen = arena_alloc(a, (n + 1) * sizeof(uint32_t));
+
+	*graph = (CallGraph){ .function_count = n, .global = global };
+	graph->first = arena_alloc_zeroed(a, (n + 1) * sizeof(uint32_t));
+	graph->effects = arena_alloc(a, n + 1);
+	for (size_t i = 0; i < unit_count; ++i)
+	{
+		for (NodeId id = 1; units[i].parsed_ok && id < units[i].ast.node_count; ++id)
+			calls += (ast_type(&units[i].ast, id) == AST_CALL);
+	}
+	graph->callees = arena_alloc(a, (calls + 1) * sizeof(uint32_t));
+	if (!seen || !graph->first || !graph->callees || !graph->effects)
+	{
+		error_fatal(errors, NULL, 0, 0, "failed to allocate the call graph");
+		return (false);
+	}
+	memset(graph->effects, EFFECT_UNKNOWN, n);
+	scan_program(graph, global, units, unit_count, seen, false);
+	for (size_t i = 0; i < n; ++i)
+		graph->first[i + 1] += graph->first[i];
+	scan_program(graph, global, units, unit_count, seen, true);
+	return (true);
+}
+
+/**
+ * @brief Marks the functions entry calls, directly or not, entry included
+ *
+ * entry is an index into the graph, or UINT32_MAX when the program has no
+ * entry point and nothing is reachable.
+ */
+bool	call_graph_mark_reachable(CallGraph *graph, Arena *a, uint32_t entry,
+			ErrorContext *errors)
+{
+	size_t		n = graph->function_count;
+	uint32_t	*queue = arena_alloc(a, (n + 1) * sizeof(uint32_t));
+	size_t		count = 0;
+
+	graph->reachable = arena_alloc_zeroed(a, n + 1);
+	if (!queue || !graph->reachable)
+	{
+		error_fatal(errors, NULL, 0, 0, "failed to allocate the call graph");
+		return (false);
+	}
+	if (entry < n)
+	{
+		graph->reachable[entry] = true;
+		queue[count++] = entry;
+	}
+	for (size_t i = 0; i < count; ++i)
+	{
+		for (uint32_t e = graph->first[queue[i]]; e < graph->first[queue[i] + 1]; ++e)
+		{
+			uint32_t callee = graph->callees[e];
+			if (graph->reachable[callee])
+				continue;
+			graph->reachable[callee] = true;
+			queue[count++] = callee;
+		}
+	}
+	return (true);
+}
+
+/*
+ * Gives every member of the strongly connected component members the
+ * effects of all of them and of their callees, which are final since
+ * Tarjan's algorithm completes a component after everything it reaches.
+ * Members of a cycle call each other forever unless something stops them.
+ */
+static void	merge_component(CallGraph *graph, const uint32_t *members,
+				size_t count)
+{
+	uint8_t	effects = count > 1 ? EFFECT_LOOPS : 0;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint32_t f = members[i];
+		effects |= graph->effects[f];
+		for (uint32_t e = graph->first[f]; e < graph->first[f + 1]; ++e)
+		{
+			effects |= graph->effects[graph->callees[e]];
+			if (graph->callees[e] == f)
+				effects |= EFFECT_LOOPS;
+		}
+	}
+	for (size_t i = 0; i < count; ++i)
+		graph->effects[members[i]] = effects;
+}
+
+/**
+ * @brief Extends the effects of each function with those of its callees
+ *
+ * An iterative Tarjan's algorithm: order[f] is f's visiting order plus
+ * one, 0 until visited, low[f] the lowest order f reaches among
+ * functions still on the stack, and edge[f] the next edge to follow.
+ */
+bool	call_graph_find_effects(CallGraph *graph, Arena *a, ErrorContext *errors)
+{
+	size_t		n = graph->function_count;
+	uint32_t	*order = arena_alloc_zeroed(a, (n + 1) * sizeof(uint32_t));
+	uint32_t	*low = arena_alloc(a, (n + 1) * sizeof(uint32_t));
+	uint32_t	*edge = arena_alloc(a, (n + 1) * sizeof(uint32_t));
+	uint32_t	*path = arena_alloc(a, (n + 1) * sizeof(uint32_t));
+	uint32_t	*stack = arena_alloc(a, (n + 1) * sizeof(uint32_t));
+	bool		*on_stack = arena_alloc_zeroed(a, n + 1);
+	uint32_t	visited = 0;
+
+	if (!order || !low || !edge || !path || !stack || !on_stack)
+	{
+		error_fatal(errors, NULL, 0, 0, "failed to allocate the call graph");
+		return (false);
+	}
+	for (uint32_t root = 0; root < n; ++root)
+	{
+		size_t depth = 0;
+		size_t top = 0;
+
+		if (order[root] != 0)
+			continue;
+		path[depth++] = root;
+		order[root] = low[root] = ++visited;
+		edge[root] = graph->first[root];
+		stack[top++] = root;
+		on_stack[root] = true;
+		while (depth > 0)
+		{
+			uint32_t f = path[depth - 1];
+			if (edge[f] < graph->first[f + 1])
+			{
+				uint32_t callee = graph->callees[edge[f]++];
+				if (order[callee] == 0)
+				{
+					order[callee] = low[callee] = ++visited;
+					edge[callee] = graph->first[callee];
+					stack[top++] = callee;
+					on_stack[callee] = true;
+					path[depth++] = callee;
+				}
+				else if (on_stack[callee] && order[callee] < low[f])
+					low[f] = order[callee];
+				continue;
+			}
+			depth--;
+			if (depth > 0 && low[f] < low[path[depth - 1]])
+				low[path[depth - 1]] = low[f];
+			if (low[f] != order[f])
+				continue;
+			size_t start = top;
+			while (stack[--start] != f)
+				on_stack[stack[start]] = false;
+			on_stack[f] = false;
+			merge_component(graph, stack + start, top - start);
+			top = start;
+		}
+	}
+	return (true);
+}
+
+/* Effects of calling callee, all of them for a name the graph does not know */
+uint8_t	call_graph_effects(const CallGraph *graph, Atom callee)
+{
+	FunctionInfo *info = semantic_global_lookup_function(graph->global, callee);
+
+	if (!info || !graph->effects)
+		return (EFFECT_UNKNOWN);
+	return (graph->effects[info - graph->global->functions]);
+}
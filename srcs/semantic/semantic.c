@@ -10,81 +10,151 @@
 #include <stdint.h>
 #include <stdio.h>
 
-Scope *semantic_scope_enter(SemanticAnalyzer *sa)
+/* Slot of atom, or the empty slot it would take */
+static ScopeSlot	*scope_probe(const ScopeTable *t, Atom atom)
 {
-	Scope *new_scope = arena_alloc(sa->arena, sizeof(Scope));
-	new_scope->parent = sa->current;
-	new_scope->var_count = 0;
-	memset(new_scope->entries, 0, sizeof(new_scope->entries));
-	sa->current = new_scope;
-	return (new_scope);
+	uint32_t	curr = atom_slot(atom, t->capacity - 1);
+
+	while (t->slots[curr].atom != ATOM_NONE && t->slots[curr].atom != atom)
+		curr = (curr + 1) & (t->capacity - 1);
+	return (&t->slots[curr]);
 }
 
-void semantic_scope_exit(SemanticAnalyzer *sa)
+/* Keeps the slots at most half full, rehashing into a table twice the size */
+static bool	scope_reserve_slot(SemanticAnalyzer *sa)
+{
+	ScopeTable	*t = &sa->scopes;
+	uint32_t	capacity = t->capacity ? t->capacity * 2 : SCOPE_HASH_SIZE;
+	ScopeSlot	*old = t->slots;
+	uint32_t	old_capacity = t->capacity;
+
+	if ((t->used + 1) * 2 <= t->capacity)
+		return (true);
+	if (t->capacity > UINT32_MAX / 2)
+		return (false);
+	t->slots = arena_alloc_zeroed(sa->arena, capacity * sizeof(ScopeSlot));
+	if (!t->slots)
+	{
+		t->slots = old;
+		return (false);
+	}
+	t->capacity = capacity;
+	for (uint32_t i = 0; i < old_capacity; ++i)
+	{
+		if (old[i].atom != ATOM_NONE)
+			*scope_probe(t, old[i].atom) = old[i];
+	}
+	return (true);
+}
+
+static bool	scope_reserve_var(SemanticAnalyzer *sa)
+{
+	ScopeTable	*t = &sa->scopes;
+	uint32_t	capacity = t->var_capacity ? t->var_capacity * 2 : SCOPE_HASH_SIZE / 2;
+	ScopeVar	*vars;
+
+	if (t->var_count < t->var_capacity)
+		return (true);
+	if (t->var_capacity > UINT32_MAX / 2)
+		return (false);
+	vars = arena_alloc(sa->arena, capacity * sizeof(ScopeVar));
+	if (!vars)
+		return (false);
+	if (t->var_count > 0)
+		memcpy(vars, t->vars, t->var_count * sizeof(ScopeVar));
+	t->vars = vars;
+	t->var_capacity = capacity;
+	return (true);
+}
+
+void semantic_scope_enter(SemanticAnalyzer *sa)
 {
-	if (sa->current)
-		sa->current = sa->current->parent;
+	sa->scopes.depth++;
 }
 
-VarInfo *semantic_scope_lookup(Scope *scope, StringView name)
+void semantic_scope_exit(SemanticAnalyzer *sa)
 {
-	uint32_t	idx;
-	size_t		curr;
+	ScopeTable *t = &sa->scopes;
 
-	while (scope)
+	while (t->var_count > 0 && t->vars[t->var_count - 1].depth == t->depth)
 	{
-		idx = hash_sv(name) & (SCOPE_HASH_SIZE - 1);
-		for (size_t i = 0; i < SCOPE_HASH_SIZE; ++i)
-		{
-			curr = (idx + i) & (SCOPE_HASH_SIZE - 1);
-			if (!scope->entries[curr].occupied)
-				break;
-			if (sv_eq(scope->entries[curr].info.name, name))
-				return (&scope->entries[curr].info);
-		}
-		scope = scope->parent;
+		ScopeVar *var = &t->vars[--t->var_count];
+		scope_probe(t, var->info.atom)->var = var->shadowed;
 	}
-	return (NULL);
+	if (t->depth > 0)
+		t->depth--;
 }
 
-bool semantic_scope_declare(SemanticAnalyzer *sa, StringView name, 
-							DataType type, int line)
+VarInfo *semantic_scope_lookup(SemanticAnalyzer *sa, Atom name)
 {
-	uint32_t	idx;
-	size_t		curr;
+	ScopeTable	*t = &sa->scopes;
+	ScopeSlot	*slot;
+
+	if (t->capacity == 0)
+		return (NULL);
+	slot = scope_probe(t, name);
+	if (slot->var == 0)
+		return (NULL);
+	return (&t->vars[slot->var - 1].info);
+}
 
-	Scope *scope = sa->current;
-	if (!scope)
-		return (false);
+VarInfo *semantic_scope_declare(SemanticAnalyzer *sa, StringView name, Atom atom,
+							DataType type, uint32_t offset)
+{
+	ScopeTable	*t = &sa->scopes;
+	ScopeSlot	*slot;
 
-	idx = hash_sv(name) & (SCOPE_HASH_SIZE - 1);
-	for (size_t i = 0; i < SCOPE_HASH_SIZE; ++i)
+	if (t->depth == 0)
+		return (NULL);
+	if (!scope_reserve_slot(sa) || !scope_reserve_var(sa))
 	{
-		curr = (idx + i) & (SCOPE_HASH_SIZE - 1);
-		if (!scope->entries[curr].occupied)
-		{
-			scope->entries[curr].occupied = true;
-			scope->entries[curr].info = (VarInfo){
-				.name = name,
-				.type = type,
-				.initialized = false,
-				.line = line
-			};
-			scope->var_count++;
-			return (true);
-		}
-		if (sv_eq(scope->entries[curr].info.name, name))
-		{
-			error_semantic(sa->errors, sa->filename, line, 0,
-					"redeclaration of variable '%.*s' (first declared at line %d)",
-					(int)name.len, name.start, scope->entries[curr].info.line);
-			return (false);
-		}
+		error_fatal(sa->errors, sa->file->name, 0, 0,
+				"failed to allocate the scope table");
+		return (NULL);
+	}
+	slot = scope_probe(t, atom);
+	if (slot->var != 0 && t->vars[slot->var - 1].depth == t->depth)
+	{
+		SourcePos first = file_map_position(sa->file, sa->errors->arena,
+				t->vars[slot->var - 1].info.offset);
+		error_semantic(sa->errors, sa->file, offset,
+				"redeclaration of variable '%.*s' (first declared at line %d)",
+				(int)name.len, name.start, first.line);
+		return (NULL);
+	}
+	if (slot->atom == ATOM_NONE)
+	{
+		slot->atom = atom;
+		t->used++;
 	}
+	t->vars[t->var_count++] = (ScopeVar){
+		.info = {
+			.name = name,
+			.atom = atom,
+			.type = type,
+			.initialized = false,
+			.offset = offset,
+			.index = t->declared++
+		},
+		.depth = t->depth,
+		.shadowed = slot->var
+	};
+	slot->var = t->var_count;
+	return (&t->vars[t->var_count - 1].info);
+}
 
-	error_semantic(sa->errors, sa->filename, line, 0,
-			"too many variables in scope (max %d)", SCOPE_HASH_SIZE);
-	return (false);
+static Atom	*visible_probe(const VisibleSet *set, Atom name)
+{
+	uint32_t	curr = atom_slot(name, set->capacity - 1);
+
+	while (set->atoms[curr] != ATOM_NONE && set->atoms[curr] != name)
+		curr = (curr + 1) & (set->capacity - 1);
+	return (&set->atoms[curr]);
+}
+
+static bool	visible_has(const VisibleSet *set, Atom name)
+{
+	return (*visible_probe(set, name) == name);
 }
 
 /*
@@ -122,82 +192,16 @@ bool semantic_scope_declare(SemanticAnalyzer *sa, StringView name,
 }
 */
 
-static bool	evaluate_const_expression(Arena *a, ASTNode *node, int64_t *out_val)
+static bool	check_type_compatibility(SemanticAnalyzer *sa, DataType dest, DataType src, NodeId id)
 {
-	if (!node)
-		return (false);
-	switch (node->type)
-	{
-		case AST_NUMBER:
-			*out_val = sv_to_int64(a, node->number.value);
-			return (true);
-		case AST_NEGATE:
-		{
-			int64_t val;
-			if (evaluate_const_expression(a, node->unary.operand, &val))
-			{
-				*out_val = -val;
-				return (true);
-			}
-			return (false);
-		}
-		case AST_BIT_NOT:
-		{
-			int64_t val;
-			if (evaluate_const_expression(a, node->unary.operand, &val))
-			{
-				*out_val = ~val;
-				return (true);
-			}
-			return (false);
-		}
-		case AST_ADD:
-		case AST_SUB:
-		case AST_MUL:
-		case AST_DIV:
-		case AST_LSHIFT:
-		case AST_RSHIFT:
-		case AST_BIT_AND:
-		case AST_BIT_OR:
-		case AST_BIT_XOR:
-		{
-			int64_t left;
-			int64_t right;
-			if (evaluate_const_expression(a, node->binary.left, &left)
-					&& evaluate_const_expression(a, node->binary.right, &right))
-			{
-				switch (node->type)
-				{
-					case AST_ADD:	*out_val = left + right; break;
-					case AST_SUB:	*out_val = left - right; break;
-					case AST_MUL:	*out_val = left * right; break;
-					case AST_DIV:
-						if (right == 0) return (false);
-						*out_val = left / right;
-						break;
-					case AST_LSHIFT:	*out_val = left << right; break;
-					case AST_RSHIFT:	*out_val = left >> right; break;
-					case AST_BIT_AND:	*out_val = left & right; break;
-					case AST_BIT_OR:	*out_val = left | right; break;
-					case AST_BIT_XOR:	*out_val = left ^ right; break;
-					default: return (false);
-				}
-				return (true);
-			}
-			return (false);
-		}
-		default: return (false);
-	}
-}
+	uint32_t offset = ast_node(sa->ast, id)->offset;
 
-static bool	check_type_compatibility(SemanticAnalyzer *sa, DataType dest, DataType src, ASTNode *node)
-{
 	if (dest == src)
 		return (true);
 
 	if (src == TYPE_VOID || dest == TYPE_VOID)
 	{
-		error_semantic(sa->errors, sa->filename, node->line, node->column,
+		error_semantic(sa->errors, sa->file, offset,
 				"invalid use of void expression");
 		return (false);
 	}
@@ -206,11 +210,13 @@ static bool	check_type_compatibility(SemanticAnalyzer *sa, DataType dest, DataTy
 	{
 		if (type_size(dest) < type_size(src))
 		{
-			int64_t	const_val;
 			bool	safe_conversion = false;
 
-			if (evaluate_const_expression(sa->arena, node, &const_val))
+			// Constant subexpressions were folded into one number by the parser
+			if (ast_type(sa->ast, id) == AST_NUMBER)
 			{
+				int64_t	const_val = ast_number(ast_node(sa->ast, id));
+
 				switch (type_size(dest))
 				{
 					case 1:
@@ -227,111 +233,179 @@ static bool	check_type_compatibility(SemanticAnalyzer *sa, DataType dest, DataTy
 				}
 			}
 			if (!safe_conversion)
-				error_add(sa->errors, ERROR_SEMANTIC, ERROR_LEVEL_WARNING, 
-					sa->filename, node->line, node->column, 
+				error_add_at(sa->errors, ERROR_SEMANTIC, ERROR_LEVEL_WARNING,
+					sa->file, offset,
 					"implicit conversion from '%s' to '%s' may lose precision",
 					type_name(src), type_name(dest));
 		}
 		return (true);
 	}
-	error_semantic(sa->errors, sa->filename, node->line, node->column,
+	error_semantic(sa->errors, sa->file, offset,
 			"incompatible types: cannot assign '%s' to '%s'",
 			type_name(src), type_name(dest));
 	return (false);
 }
 
-static bool analyze_expression(SemanticAnalyzer *sa, ASTNode *node)
+/* Checks what a call needs before its arguments are looked at */
+static bool	enter_call(SemanticAnalyzer *sa, NodeId id)
 {
-	if (!node)
-		return (true);
+	const ASTNode	*node = ast_node(sa->ast, id);
+	StringView		name = ast_name(sa->ast, node->lhs);
+	uint32_t		arg_count;
+
+	ast_call_args(sa->ast, id, &arg_count);
+	if (!visible_has(sa->visible, node->lhs))
+	{
+		error_semantic(sa->errors, sa->file, node->offset,
+				"implicit declaration of function '%.*s' is invalid in tinyCompile",
+				(int)name.len, name.start);
+		return (false);
+	}
+
+	FunctionInfo *func = semantic_global_lookup_function(
+			sa->global, node->lhs);
+	if (!func)
+	{
+		error_semantic(sa->errors, sa->file, node->offset,
+				"call to undefined function '%.*s'", 
+				(int)name.len, name.start);
+		return (false);
+	}
+
+	if (arg_count != func->param_count)
+	{
+		error_semantic(sa->errors, sa->file, node->offset,
+				"function '%.*s' expects %zu arguments, got %zu",
+				(int)name.len, name.start,
+				func->param_count, (size_t)arg_count);
+		return (false);
+	}
+	return (true);
+}
+
+/**
+ * @brief Checks of node id that come before its children
+ *
+ * Names are resolved here, so a variable's slot is known before anything
+ * uses it. A false return means id failed and its children are not to be
+ * looked at; semantic_leave is not called for it either.
+ */
+bool	semantic_enter(SemanticAnalyzer *sa, NodeId id)
+{
+	Ast		*ast = sa->ast;
+	ASTNode	*node = ast_node(ast, id);
+
 	switch (node->type)
 	{
-		case AST_NUMBER:
-		{
-			int64_t	val = sv_to_int64(sa->arena, node->number.value);
-			if (val >= INT_MIN && val <= INT_MAX)
-				node->value_type = TYPE_INT;
-			else
-				node->value_type = TYPE_INT64;
-			// TODO: In the future, check if the token text ends with
-			// 'L' or 'U' to override this logic. (needs lexer changes)
-			return (true);
-		}
 		case AST_IDENTIFIER:
 		{
-			VarInfo *var = semantic_scope_lookup(sa->current, node->identifier.name);
+			VarInfo *var = semantic_scope_lookup(sa, node->lhs);
 			if (!var)
 			{
-				error_semantic(sa->errors, sa->filename, node->line, node->column,
+				StringView name = ast_name(ast, node->lhs);
+				error_semantic(sa->errors, sa->file, node->offset,
 						"use of undeclared identifier '%.*s'",
-						(int)node->identifier.name.len, node->identifier.name.start);
+						(int)name.len, name.start);
 				return (false);
 			}
 			node->value_type = var->type;
+			node->rhs = var->index;
 			return (true);
 		}
 		case AST_CALL:
+			return (enter_call(sa, id));
+		case AST_EQUAL:
+		case AST_GREATER:
+		case AST_GREATER_EQUAL:
+		case AST_LESS_EQUAL:
+		case AST_LESS:
+		case AST_NOT_EQUAL:
+		case AST_LOGICAL_AND:
+		case AST_LOGICAL_OR:
+		case AST_NOT:
+			// TODO Comparisons and logical operators return bool,
+			//		represented as int64 for now
+			node->value_type = TYPE_INT64;
+			return (true);
+		case AST_ASSIGNMENT:
 		{
-			bool is_visible = false;
-			for (size_t i = 0; i < sa->visible_count; ++i)
-			{
-				if (sv_eq(sa->visible_funcs[i], node->call.function_name))
-				{
-					is_visible = true;
-					break;
-				}
-			}
-
-			if (!is_visible)
+			ASTNode	*name = ast_node(ast, node->lhs);
+			VarInfo	*var = semantic_scope_lookup(sa, name->lhs);
+			if (!var)
 			{
-				error_semantic(sa->errors, sa->filename, node->line, node->column,
-						"implicit declaration of function '%.*s' is invalid in tinyCompile",
-						(int)node->call.function_name.len, node->call.function_name.start);
+				StringView text = ast_name(ast, name->lhs);
+				error_semantic(sa->errors, sa->file, node->offset,
+						"assignment to undeclared variable '%.*s'",
+						(int)text.len, text.start);
 				return (false);
 			}
-
-			FunctionInfo *func = semantic_global_lookup_function(
-					sa->global, node->call.function_name);
-			if (!func)
+			name->value_type = var->type;
+			name->rhs = var->index;
+			return (true);
+		}
+		case AST_RETURN:
+			if (node->lhs != NODE_NONE && sa->current_return_type == TYPE_VOID)
 			{
-				error_semantic(sa->errors, sa->filename, node->line, node->column,
-						"call to undefined function '%.*s'", 
-						(int)node->call.function_name.len, node->call.function_name.start);
+				error_semantic(sa->errors, sa->file, node->offset,
+						"void function should not return a value");
 				return (false);
 			}
-
-			if (node->call.arg_count != func->param_count)
+			if (node->lhs == NODE_NONE && sa->current_return_type != TYPE_VOID)
 			{
-				error_semantic(sa->errors, sa->filename, node->line, node->column,
-						"function '%.*s' expects %zu arguments, got %zu",
-						(int)node->call.function_name.len, node->call.function_name.start,
-						func->param_count, node->call.arg_count);
+				error_semantic(sa->errors, sa->file, node->offset,
+						"non-void function must return a value");
 				return (false);
 			}
+			return (true);
+		case AST_BLOCK:
+			semantic_scope_enter(sa);
+			return (true);
+		default:
+			return (true);
+	}
+}
 
-			bool all_ok = true;
-			for (size_t i = 0; i < node->call.arg_count; ++i)
-			{
-				if (!analyze_expression(sa, node->call.args[i]))
-					all_ok = false;
-				if (!check_type_compatibility(sa, func->params[i].type,
-							node->call.args[i]->value_type, node->call.args[i]))
-					all_ok = false;
-			}
-			node->value_type = func->return_type;
-			return (all_ok);
-		}
+/**
+ * @brief Checks argument index of call, once the argument is analyzed
+ */
+bool	semantic_check_argument(SemanticAnalyzer *sa, NodeId call, uint32_t index)
+{
+	uint32_t		arg_count;
+	const NodeId	*args = ast_call_args(sa->ast, call, &arg_count);
+	FunctionInfo	*func = semantic_global_lookup_function(sa->global,
+			ast_node(sa->ast, call)->lhs);
+
+	return (check_type_compatibility(sa, func->params[index].type,
+				ast_value_type(sa->ast, args[index]), args[index]));
+}
+
+/**
+ * @brief Checks of node id once its children are analyzed, children_ok
+ * telling whether they all passed
+ *
+ * Types id, declares what it declares and closes the scope it opened.
+ * Returns whether id and its subtree passed.
+ */
+bool	semantic_leave(SemanticAnalyzer *sa, NodeId id, bool children_ok)
+{
+	Ast		*ast = sa->ast;
+	ASTNode	*node = ast_node(ast, id);
+
+	switch (node->type)
+	{
+		case AST_CALL:
+			node->value_type = semantic_global_lookup_function(sa->global,
+					node->lhs)->return_type;
+			return (children_ok);
 		case AST_ADD:
 		case AST_SUB:
 		case AST_MUL:
 		case AST_DIV:
 		{
-			bool left_ok = analyze_expression(sa, node->binary.left);
-			bool right_ok = analyze_expression(sa, node->binary.right);
-			if (!left_ok || !right_ok)
+			if (!children_ok)
 				return (false);
-			DataType left_type = node->binary.left->value_type;
-			DataType right_type = node->binary.right->value_type;
+			DataType left_type = ast_value_type(ast, node->lhs);
+			DataType right_type = ast_value_type(ast, node->rhs);
 			// TODO	Proper type promotion rules - for now, just use the larger
 			if (type_size(left_type) >= type_size(right_type))
 				node->value_type = left_type;
@@ -339,190 +413,284 @@ static bool analyze_expression(SemanticAnalyzer *sa, ASTNode *node)
 				node->value_type = right_type;
 			return (true);
 		}
-		case AST_EQUAL:
-		case AST_GREATER_EQUAL:
-		case AST_LESS_EQUAL:
-		case AST_LESS:
-		case AST_NOT_EQUAL:
-		{
-			bool left_ok = analyze_expression(sa, node->binary.left);
-			bool right_ok = analyze_expression(sa, node->binary.right);
-			node->value_type = TYPE_INT64;	// TODO Comparisons always return bool
-											//		Represented as int64 for now
-			return (left_ok && right_ok);
-		}
 		case AST_NEGATE:
-		{
-			bool ok = analyze_expression(sa, node->unary.operand);
-			if (ok)
-				node->value_type = node->unary.operand->value_type;
-			return (ok);
-		}
-		case AST_NOT:
-		{
-			 bool ok = analyze_expression(sa, node->unary.operand);
-			 // TODO Logical not returns TYPE_BOOL (implement later)
-			 node->value_type = TYPE_INT64;
-			 return (ok);
-		}
 		case AST_BIT_NOT:
-		{
-			bool ok = analyze_expression(sa, node->unary.operand);
-			if (ok)
-				node->value_type = node->unary.operand->value_type;
-			return (ok);
-		}
+			if (children_ok)
+				node->value_type = ast_value_type(ast, node->lhs);
+			return (children_ok);
 		case AST_BIT_AND:
 		case AST_BIT_OR:
 		case AST_BIT_XOR:
 		case AST_LSHIFT:
 		case AST_RSHIFT:
 		{
-			bool left_ok = analyze_expression(sa, node->binary.left);
-			bool right_ok = analyze_expression(sa, node->binary.right);
-			if (!left_ok || !right_ok)
+			if (!children_ok)
 				return (false);
 
-			DataType type = node->binary.left->value_type;
+			DataType type = ast_value_type(ast, node->lhs);
 			if (type_size(type) < type_size(TYPE_INT))
 				type = TYPE_INT;
 
 			node->value_type = type;
 			return (true);
 		}
-		default:
-			return (true);
-	}
-}
-
-static bool analyze_statement(SemanticAnalyzer *sa, ASTNode *node)
-{
-	if (!node)
-		return (true);
-
-	switch (node->type)
-	{
 		case AST_VAR_DECL:
 		{
-			bool init_ok = true;
-			if (node->var_decl.initializer)
-			{
-				init_ok = analyze_expression(sa, node->var_decl.initializer);
-				if (init_ok && !check_type_compatibility(sa, node->var_decl.var_type,
-							node->var_decl.initializer->value_type, node->var_decl.initializer))
-					init_ok = false;
-			}
-			bool decl_ok = semantic_scope_declare(sa, node->var_decl.var_name,
-					node->var_decl.var_type, node->line);
-			return (init_ok && decl_ok);
+			DataType var_type = ast_value_type(ast, id);
+			bool init_ok = children_ok;
+			if (node->rhs != NODE_NONE && init_ok
+					&& !check_type_compatibility(sa, var_type,
+						ast_value_type(ast, node->rhs), node->rhs))
+				init_ok = false;
+			ASTNode	*name = ast_node(ast, node->lhs);
+			VarInfo	*var = semantic_scope_declare(sa, ast_name(ast, name->lhs),
+					name->lhs, var_type, node->offset);
+			if (!var)
+				return (false);
+			name->value_type = var_type;
+			name->rhs = var->index;
+			return (init_ok);
 		}
 		case AST_ASSIGNMENT:
 		{
-			VarInfo *var = semantic_scope_lookup(sa->current, node->assignment.var_name);
-			if (!var)
-			{
-				error_semantic(sa->errors, sa->filename, node->line, node->column,
-						"assignment to undeclared variable '%.*s'",
-						(int)node->assignment.var_name.len,
-						node->assignment.var_name.start);
+			DataType var_type = ast_value_type(ast, node->lhs);
+			node->value_type = var_type;
+			if (children_ok && !check_type_compatibility(sa, var_type, 
+						ast_value_type(ast, node->rhs), node->rhs))
 				return (false);
-			}
-			bool ok = analyze_expression(sa, node->assignment.value);
-			node->value_type = var->type;
-			if (ok && !check_type_compatibility(sa, var->type, 
-						node->assignment.value->value_type, node->assignment.value))
-				ok = false;
-			return (ok);
+			return (children_ok);
 		}
 		case AST_RETURN:
-		{
-			if (node->return_stmt.expression)
-			{
-				if (sa->current_return_type == TYPE_VOID)
-				{
-					error_semantic(sa->errors, sa->filename,
-							node->line, node->column,
-							"void function should not return a value");
-					return (false);
-				}
-				bool ok = analyze_expression(sa, node->return_stmt.expression);
-				node->value_type = sa->current_return_type;
-				if (ok && !check_type_compatibility(sa, sa->current_return_type, 
-							node->return_stmt.expression->value_type, 
-							node->return_stmt.expression))
-					ok = false;
-				return (ok);
-			}
-			else
-			{
-				if (sa->current_return_type != TYPE_VOID)
-				{
-					error_semantic(sa->errors, sa->filename,
-							node->line, node->column,
-							"non-void function must return a value");
-					return (false);
-				}
+			if (node->lhs == NODE_NONE)
 				return (true);
-			}
-		}
+			node->value_type = sa->current_return_type;
+			if (children_ok && !check_type_compatibility(sa,
+						sa->current_return_type,
+						ast_value_type(ast, node->lhs), node->lhs))
+				return (false);
+			return (children_ok);
+		case AST_BLOCK:
+			semantic_scope_exit(sa);
+			return (children_ok);
+		default:
+			return (children_ok);
+	}
+}
+
+/*
+*	A node of the walk in analyze whose children are being analyzed. The
+*	stack starts on the C stack and moves into the arena when a tree is
+*	deeper than that, so nesting is only bounded by memory.
+*/
+typedef struct {
+	NodeId		id;
+	uint32_t	next;	// children started so far
+	bool		ok;		// whether those children passed
+} AnalyzeFrame;
+
+typedef struct {
+	AnalyzeFrame	*frames;
+	uint32_t		count;
+	uint32_t		capacity;
+} AnalyzeStack;
+
+/*
+ * The child index of id, which may be NODE_NONE for an absent one, in the
+ * order the checks expect. Returns false once id has no more.
+ */
+static bool	child_at(const Ast *ast, NodeId id, uint32_t index, NodeId *child)
+{
+	const ASTNode	*node = ast_node(ast, id);
+	uint32_t		count;
+	const NodeId	*list;
+
+	switch (node->type)
+	{
+		case AST_CALL:
+			list = ast_call_args(ast, id, &count);
+			break;
+		case AST_BLOCK:
+			list = ast_list(ast, id, &count);
+			break;
 		case AST_IF:
 		{
-			bool cond_ok = analyze_expression(sa, node->if_stmt.condition);
-			bool then_ok = analyze_statement(sa, node->if_stmt.then_branch);
-			bool else_ok = true;
-			if (node->if_stmt.else_branch)
-				else_ok = analyze_statement(sa, node->if_stmt.else_branch);
-			return (cond_ok && then_ok && else_ok);
+			NodeId parts[3] = { node->lhs, ast_if_then(ast, id), ast_if_else(ast, id) };
+			if (index >= 3)
+				return (false);
+			*child = parts[index];
+			return (true);
 		}
-		case AST_WHILE:
+		case AST_NEGATE:
+		case AST_NOT:
+		case AST_BIT_NOT:
+		case AST_RETURN:
+			*child = node->lhs;
+			return (index == 0);
+		case AST_VAR_DECL:
+		case AST_ASSIGNMENT:
+			*child = node->rhs;
+			return (index == 0);
+		case AST_NUMBER:
+		case AST_IDENTIFIER:
+		case AST_FUNCTION:
+		case AST_TRANSLATION_UNIT:
+			return (false);
+		default:
+			*child = index == 0 ? node->lhs : node->rhs;
+			return (index < 2);
+	}
+	if (index >= count)
+		return (false);
+	*child = list[index];
+	return (true);
+}
+
+static bool	push_frame(SemanticAnalyzer *sa, AnalyzeStack *stack, NodeId id)
+{
+	if (stack->count == stack->capacity)
+	{
+		uint32_t		capacity = stack->capacity * 2;
+		AnalyzeFrame	*frames = arena_alloc(sa->arena,
+				capacity * sizeof(AnalyzeFrame));
+
+		if (!frames)
 		{
-			bool cond_ok = analyze_expression(sa, node->while_stmt.condition);
-			bool body_ok = analyze_statement(sa, node->while_stmt.body);
-			return (cond_ok && body_ok);
+			error_fatal(sa->errors, sa->file->name, 0, 0,
+					"failed to allocate the semantic walk");
+			return (false);
 		}
-		case AST_BLOCK:
+		memcpy(frames, stack->frames, stack->count * sizeof(AnalyzeFrame));
+		stack->frames = frames;
+		stack->capacity = capacity;
+	}
+	stack->frames[stack->count++] = (AnalyzeFrame){ .id = id, .ok = true };
+	return (true);
+}
+
+/* Records into frame how its latest child, which passed or not, went */
+static void	child_done(SemanticAnalyzer *sa, AnalyzeFrame *frame, bool ok)
+{
+	if (!ok)
+		frame->ok = false;
+	if (ast_type(sa->ast, frame->id) == AST_CALL
+			&& !semantic_check_argument(sa, frame->id, frame->next - 1))
+		frame->ok = false;
+}
+
+/**
+ * @brief Analyzes the whole subtree at root
+ *
+ * The two-pass walk: semantic_enter, the children, all of them even once
+ * one has failed, and semantic_leave. Returns whether root passed.
+ */
+bool	semantic_analyze_tree(SemanticAnalyzer *sa, NodeId root)
+{
+	AnalyzeFrame	local[WALK_STACK_SIZE];
+	AnalyzeStack	stack = { .frames = local, .capacity = WALK_STACK_SIZE };
+	NodeId			child;
+
+	if (root == NODE_NONE)
+		return (true);
+	if (!semantic_enter(sa, root) || !push_frame(sa, &stack, root))
+		return (false);
+	while (true)
+	{
+		AnalyzeFrame *top = &stack.frames[stack.count - 1];
+		if (child_at(sa->ast, top->id, top->next, &child))
 		{
-			semantic_scope_enter(sa);
-			bool all_ok = true;
-			for (size_t i = 0; i < node->block.count; ++i)
-			{
-				if (!analyze_statement(sa, node->block.statements[i]))
-					all_ok = false;
-			}
-			semantic_scope_exit(sa);
-			return (all_ok);
+			top->next++;
+			if (child == NODE_NONE)
+				child_done(sa, top, true);
+			else if (!semantic_enter(sa, child))
+				child_done(sa, top, false);
+			else if (!push_frame(sa, &stack, child))
+				return (false);
+			continue;
 		}
-		default:
-			return (analyze_expression(sa, node));
+		bool ok = semantic_leave(sa, top->id, top->ok);
+		if (--stack.count == 0)
+			return (ok);
+		child_done(sa, &stack.frames[stack.count - 1], ok);
 	}
 }
 
+/* Slot of name in the function index, or the empty slot it would take */
+static uint32_t	*global_probe(const GlobalScope *global, Atom name)
+{
+	uint32_t	mask = global->slot_capacity - 1;
+	uint32_t	curr = atom_slot(name, mask);
+
+	while (global->slots[curr] != 0
+			&& global->functions[global->slots[curr] - 1].atom != name)
+		curr = (curr + 1) & mask;
+	return (&global->slots[curr]);
+}
+
+/* Makes room for one more function, keeping the index at most half full */
+static bool	global_reserve(GlobalScope *global)
+{
+	if (global->function_count == global->function_capacity)
+	{
+		size_t			capacity = global->function_capacity
+			? global->function_capacity * 2 : FUNCTION_TABLE_SIZE;
+		FunctionInfo	*functions;
+
+		if (capacity > UINT32_MAX / 4)
+			return (false);
+		functions = arena_alloc(global->arena, capacity * sizeof(FunctionInfo));
+		if (!functions)
+			return (false);
+		if (global->function_count > 0)
+			memcpy(functions, global->functions,
+					global->function_count * sizeof(FunctionInfo));
+		global->functions = functions;
+		global->function_capacity = capacity;
+	}
+	if ((global->function_count + 1) * 2 > global->slot_capacity)
+	{
+		uint32_t	capacity = global->slot_capacity
+			? global->slot_capacity * 2 : FUNCTION_TABLE_SIZE * 2;
+		uint32_t	*slots = arena_alloc_zeroed(global->arena,
+				capacity * sizeof(uint32_t));
+
+		if (!slots)
+			return (false);
+		global->slots = slots;
+		global->slot_capacity = capacity;
+		for (uint32_t i = 0; i < global->function_count; ++i)
+			*global_probe(global, global->functions[i].atom) = i + 1;
+	}
+	return (true);
+}
+
 bool	semantic_global_declare_function(GlobalScope *global, ErrorContext *errors, 
-			ASTNode *func_node, const char *filename)
+			const Ast *ast, NodeId func_node, FileMap *file)
 {
-	if (!func_node || func_node->type != AST_FUNCTION)
+	if (func_node == NODE_NONE || ast_type(ast, func_node) != AST_FUNCTION)
 		return (false);
 
-	StringView	name = func_node->function.name;
-	Parameter	*params = func_node->function.params;
-	size_t		param_count = func_node->function.param_count;
-	int			line = func_node->line;
-	DataType	return_type = func_node->function.return_type;
-	bool		is_prototype = func_node->function.is_prototype;
+	ASTFunction	func = ast_function(ast, func_node);
+	StringView	name = ast_name(ast, func.atom);
+	Parameter	*params = func.params;
+	size_t		param_count = func.param_count;
+	uint32_t	offset = ast_node(ast, func_node)->offset;
+	DataType	return_type = func.return_type;
+	bool		is_prototype = func.is_prototype;
 
 	if (param_count > MAX_PARAMS_PER_FUNCTION)
 	{
-		error_semantic(errors, filename, line, 0,
+		error_semantic(errors, file, offset,
 				"too many parameters (max %d)", MAX_PARAMS_PER_FUNCTION);
 		return (false);
 	}
 
-	FunctionInfo *existing = semantic_global_lookup_function(global, name);
+	FunctionInfo *existing = semantic_global_lookup_function(global,
+			func.atom);
 	if (existing)
 	{
 		if (existing->return_type != return_type)
 		{
-			error_semantic(errors, filename, line, 0,
+			error_semantic(errors, file, offset,
 					"conflicting return types for function '%.*s' "
 					"(previous: %s, now: %s)",
 					(int)name.len, name.start,
@@ -532,11 +700,13 @@ bool	semantic_global_declare_function(GlobalScope *global, ErrorContext *errors,
 		}
 		if (existing->param_count != param_count)
 		{
-			error_semantic(errors, filename, line, 0,
+			error_semantic(errors, file, offset,
 					"conflicting types for function '%.*s' "
 					"(previous declaration at %s:%d had %zu parameters)",
-					(int)name.len, name.start, existing->filename,
-					existing->line, existing->param_count);
+					(int)name.len, name.start, existing->file->name,
+					file_map_position(existing->file, errors->arena,
+						existing->offset).line,
+					existing->param_count);
 			return (false);
 		}
 
@@ -548,8 +718,9 @@ bool	semantic_global_declare_function(GlobalScope *global, ErrorContext *errors,
 			if (!is_prototype)
 			{
 				existing->is_prototype = false;
-				existing->line = line;
-				existing->filename = filename;
+				existing->file = file;
+				existing->offset = offset;
+				existing->node = func_node;
 				existing->params = params;
 				return (true);
 			}
@@ -562,123 +733,221 @@ bool	semantic_global_declare_function(GlobalScope *global, ErrorContext *errors,
 			// If new one is also definition, it is an error
 			if (!is_prototype)
 			{
-				error_semantic(errors, filename, line, 0,
+				error_semantic(errors, file, offset,
 						"redefinition of function '%.*s' (previous definition at %s:%d)",
-						(int)name.len, name.start, existing->filename, existing->line);
+						(int)name.len, name.start, existing->file->name,
+						file_map_position(existing->file, errors->arena,
+							existing->offset).line);
 				return (false);
 			}
 			return (true);
 		}
 	}
 
-	if (global->function_count >= MAX_FUNCTION_COUNT)
+	if (!global_reserve(global))
 	{
-		error_semantic(errors, filename, line, 0,
-				"too many functions (max %d)", MAX_FUNCTION_COUNT);
+		error_fatal(errors, file->name, 0, 0,
+				"failed to allocate the function table");
 		return (false);
 	}
 
 	global->functions[global->function_count] = (FunctionInfo){
 		.name = name,
+		.atom = func.atom,
 		.return_type = return_type,
 		.params = params,
 		.param_count = param_count,
-		.line = line,
-		.filename = filename,
+		.file = file,
+		.offset = offset,
+		.node = func_node,
 		.is_prototype = is_prototype
 	};
-	global->function_count++;
+	*global_probe(global, func.atom) = ++global->function_count;
 
 	return (true);
 }
 
-FunctionInfo *semantic_global_lookup_function(GlobalScope *global, StringView name)
+FunctionInfo *semantic_global_lookup_function(GlobalScope *global, Atom name)
 {
-	for (size_t i = 0; i < global->function_count; ++i)
-	{
-		if (sv_eq(global->functions[i].name, name))
-			return (&global->functions[i]);
-	}
-	return (NULL);
+	uint32_t	index;
+
+	if (global->slot_capacity == 0)
+		return (NULL);
+	index = *global_probe(global, name);
+	if (index == 0)
+		return (NULL);
+	return (&global->functions[index - 1]);
 }
 
-static bool analyze_node(SemanticAnalyzer *sa, ASTNode *node)
+/**
+ * @brief Opens the scope of function func and declares its parameters
+ *
+ * The body's statements are analyzed in that scope, not one of their own,
+ * so a local cannot redeclare a parameter. semantic_end_function closes it.
+ */
+bool	semantic_begin_function(SemanticAnalyzer *sa, NodeId func)
 {
-	if (node->type != AST_FUNCTION)
-		return (false);
-	if (node->function.is_prototype)
-		return (true);
-	sa->current_return_type = node->function.return_type;
+	ASTFunction	decl = ast_function(sa->ast, func);
+	bool		params_ok = true;
+
+	sa->current_return_type = decl.return_type;
+	sa->scopes.declared = 0;
 	semantic_scope_enter(sa);
-	bool params_ok = true;
-	for (size_t i = 0; i < node->function.param_count; ++i)
+	for (size_t i = 0; i < decl.param_count; ++i)
 	{
-		Parameter *param = &node->function.params[i];
-		if (!semantic_scope_declare(sa, param->name, 
-					param->type, node->line))
+		Parameter *param = &decl.params[i];
+		if (!semantic_scope_declare(sa, ast_name(sa->ast, param->atom),
+					param->atom, param->type, ast_node(sa->ast, func)->offset))
 			params_ok = false;
 	}
+	return (params_ok);
+}
+
+void	semantic_end_function(SemanticAnalyzer *sa)
+{
+	semantic_scope_exit(sa);
+}
+
+static bool analyze_node(SemanticAnalyzer *sa, NodeId id)
+{
+	if (ast_type(sa->ast, id) != AST_FUNCTION)
+		return (false);
+	ASTFunction func = ast_function(sa->ast, id);
+	// Lazy bodies still unparsed are never called, see jit_compile_pass
+	if (func.is_prototype || func.is_lazy)
+		return (true);
+	bool params_ok = semantic_begin_function(sa, id);
 
 	bool body_ok = true;
-	ASTNode *body = node->function.body;
-	if (body && body->type == AST_BLOCK)
+	if (func.body != NODE_NONE && ast_type(sa->ast, func.body) == AST_BLOCK)
 	{
-		for (size_t i = 0; i < body->block.count; ++i)
+		uint32_t		count;
+		const NodeId	*stmts = ast_list(sa->ast, func.body, &count);
+		for (size_t i = 0; i < count; ++i)
 		{
-			if (!analyze_statement(sa, body->block.statements[i]))
+			if (!semantic_analyze_tree(sa, stmts[i]))
 				body_ok = false;
 		}
 	}
-	semantic_scope_exit(sa);
+	semantic_end_function(sa);
 	return (params_ok && body_ok);
 }
 
-bool semantic_analyze(Arena *a, CompilationUnit *unit, ErrorContext *errors, GlobalScope *global)
+/*
+ * Makes every function the unit declares callable from its bodies. The
+ * set is built on the unit's first analysis, in the arena of the global
+ * table since lazy bodies are analyzed in regions that do not outlive it.
+ */
+static bool	make_visible(CompilationUnit *unit, ErrorContext *errors,
+				GlobalScope *global)
 {
-	SemanticAnalyzer sa = {
+	VisibleSet		*set = &unit->visible;
+	uint32_t		count;
+	const NodeId	*decls = ast_list(&unit->ast, unit->ast.root, &count);
+	uint32_t		capacity = FUNCTION_TABLE_SIZE;
+
+	if (set->capacity != 0)
+		return (true);
+	while (capacity < UINT32_MAX / 2 && capacity / 2 < count)
+		capacity *= 2;
+	set->atoms = arena_alloc_zeroed(global->arena, capacity * sizeof(Atom));
+	if (!set->atoms)
+	{
+		error_fatal(errors, unit->file.name, 0, 0,
+				"failed to allocate the visible functions");
+		return (false);
+	}
+	set->capacity = capacity;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const ASTNode *node = ast_node(&unit->ast, decls[i]);
+
+		if (node->type == AST_FUNCTION)
+			*visible_probe(set, node->lhs) = node->lhs;
+	}
+	return (true);
+}
+
+/**
+ * @brief Builds up front what analyzing unit's bodies would on first use
+ *
+ * That is the unit's visible functions and the line index of its file,
+ * which diagnostics read. Afterwards semantic_analyze_function only writes
+ * to the nodes of the function it is given, its arena, scopes and errors,
+ * so calls for different functions may run concurrently.
+ */
+bool	semantic_prepare_unit(CompilationUnit *unit, ErrorContext *errors,
+			GlobalScope *global)
+{
+	if (!make_visible(unit, errors, global))
+		return (false);
+	if (!file_map_index_lines(&unit->file, global->arena))
+	{
+		error_fatal(errors, unit->file.name, 0, 0,
+				"failed to index the lines of the file");
+		return (false);
+	}
+	return (true);
+}
+
+/**
+ * @brief Sets sa up to analyze functions of unit that live in ast
+ *
+ * Whole functions go through semantic_analyze_function, or node by node
+ * through semantic_begin_function, semantic_enter, semantic_leave and
+ * semantic_end_function, the way ir_gen_fused drives them.
+ */
+bool	semantic_init(SemanticAnalyzer *sa, Arena *a, CompilationUnit *unit,
+			Ast *ast, ErrorContext *errors, GlobalScope *global)
+{
+	*sa = (SemanticAnalyzer){
 		.arena = a,
 		.errors = errors,
-		.filename = unit->file.name,
+		.file = &unit->file,
+		.ast = ast,
 		.global = global,
-		.current = NULL,
 		.current_return_type = TYPE_INT64,
+		.visible = &unit->visible,
 	};
+	return (make_visible(unit, errors, global));
+}
 
-	bool all_ok = true;
-
-	for (size_t i = 0; i < unit->ast->translation_unit.count; ++i)
-	{
-		ASTNode *node = unit->ast->translation_unit.declarations[i];
-
-		if (node->type == AST_FUNCTION)
-		{
-			bool already_visible = false;
-			for (size_t j = 0; j < sa.visible_count; ++j)
-			{
-				if (sv_eq(sa.visible_funcs[j], node->function.name))
-				{
-					already_visible = true;
-					break;
-				}
-			}
-			if (!already_visible)
-			{
-				if (sa.visible_count >= MAX_FUNCTION_COUNT)
-				{
-					error_semantic(errors, unit->file.name, node->line, 0,
-							"too many functions");
-					return (false);
-				}
-				sa.visible_funcs[sa.visible_count++] = node->function.name;
-			}
-		}
-	}
+bool semantic_analyze(Arena *a, CompilationUnit *unit, ErrorContext *errors, GlobalScope *global)
+{
+	SemanticAnalyzer	sa;
+	bool				all_ok = true;
+	uint32_t			count;
+	const NodeId		*decls = ast_list(&unit->ast, unit->ast.root, &count);
 
-	for (size_t i = 0; i < unit->ast->translation_unit.count; ++i)
+	if (!semantic_init(&sa, a, unit, &unit->ast, errors, global))
+		return (false);
+	for (size_t i = 0; i < count; ++i)
 	{
-		ASTNode *node = unit->ast->translation_unit.declarations[i];
-		if (!analyze_node(&sa, node))
+		if (!analyze_node(&sa, decls[i]))
 			all_ok = false;
 	}
 	return (all_ok);
 }
+
+/**
+ * @brief Analyzes one function of unit, func in ast
+ *
+ * ast is unit->ast or one holding only func and its parsed body; the names
+ * it may call are the ones unit->ast declares. scopes is the table to
+ * analyze with, empty on entry and on return, so that one can serve a
+ * whole run of calls; its storage comes from a.
+ */
+bool	semantic_analyze_function(Arena *a, ScopeTable *scopes,
+			CompilationUnit *unit, Ast *ast, NodeId func, ErrorContext *errors,
+			GlobalScope *global)
+{
+	SemanticAnalyzer	sa;
+	bool				ok;
+
+	if (!semantic_init(&sa, a, unit, ast, errors, global))
+		return (false);
+	sa.scopes = *scopes;
+	ok = analyze_node(&sa, func);
+	*scopes = sa.scopes;
+	return (ok);
+}
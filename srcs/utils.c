@@ -38,55 +38,128 @@ FileMap map_input(int fd)
 	return (res);
 }
 
-void print_ast(ASTNode *node, int indent)
+/**
+ * @brief Builds the newline-offset index of a file
+ *
+ * Two memchr passes (libc vectorizes these): one to count the lines, one to
+ * record where each of them starts. Only diagnostics need this, so it runs
+ * the first time a position is asked for rather than while lexing.
+ */
+bool	file_map_index_lines(FileMap *file, Arena *a)
 {
-	if (!node) return;
+	const char	*end = file->data + file->length;
+	const char	*p = file->data;
+	const char	*nl;
+	size_t		count = 1;
+
+	if (file->line_offsets)
+		return (true);
+	while (p < end && (nl = memchr(p, '\n', end - p)) != NULL)
+	{
+		count++;
+		p = nl + 1;
+	}
+	uint32_t *offsets = arena_alloc(a, count * sizeof(uint32_t));
+	if (!offsets)
+		return (false);
+	offsets[0] = 0;
+	count = 1;
+	p = file->data;
+	while (p < end && (nl = memchr(p, '\n', end - p)) != NULL)
+	{
+		offsets[count++] = (uint32_t)(nl - file->data) + 1;
+		p = nl + 1;
+	}
+	file->line_offsets = offsets;
+	file->line_count = count;
+	return (true);
+}
+
+/**
+ * @brief Resolves a byte offset into a 1-based line and column
+ */
+SourcePos	file_map_position(FileMap *file, Arena *a, uint32_t offset)
+{
+	if (!file_map_index_lines(file, a))
+		return ((SourcePos){0, 0});
+
+	size_t lo = 0;
+	size_t hi = file->line_count;
+	while (hi - lo > 1)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+		if (file->line_offsets[mid] <= offset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return ((SourcePos){
+		.line = (int)lo + 1,
+		.column = (int)(offset - file->line_offsets[lo]) + 1
+	});
+}
+
+void print_ast(const Ast *ast, NodeId id, int indent)
+{
+	if (id == NODE_NONE) return;
 	for (int i = 0; i < indent; ++i) printf("  ");
 
+	const ASTNode	*node = ast_node(ast, id);
+	StringView		name = {0};
+	uint32_t		count;
+	const NodeId	*children;
+	// These kinds keep an atom in lhs
+	if (node->type == AST_FUNCTION || node->type == AST_IDENTIFIER
+			|| node->type == AST_CALL)
+		name = ast_name(ast, node->lhs);
+	// and these name theirs through an identifier
+	else if (node->type == AST_VAR_DECL || node->type == AST_ASSIGNMENT)
+		name = ast_name(ast, ast_node(ast, node->lhs)->lhs);
 	switch (node->type)
 	{
 		case AST_FUNCTION:
-			printf("Function: %.*s\n", (int)node->function.name.len, node->function.name.start);
-			print_ast(node->function.body, indent + 1);
+			printf("Function: %.*s\n", (int)name.len, name.start);
+			print_ast(ast, ast_function(ast, id).body, indent + 1);
 			break;
 		case AST_BLOCK:
 			printf("Block\n");
-			for (size_t i = 0; i < node->block.count; ++i)
-				print_ast(node->block.statements[i], indent + 1);
+			children = ast_list(ast, id, &count);
+			for (size_t i = 0; i < count; ++i)
+				print_ast(ast, children[i], indent + 1);
 			break;
 		case AST_VAR_DECL:
-			printf("VarDecl: %.*s\n", (int)node->var_decl.var_name.len, node->var_decl.var_name.start);
-			if (node->var_decl.initializer)
-				print_ast(node->var_decl.initializer, indent + 2);
+			printf("VarDecl: %.*s\n", (int)name.len, name.start);
+			print_ast(ast, node->rhs, indent + 2);
 			break;
 		case AST_ASSIGNMENT:
-			printf("Assign: %.*s\n", (int)node->assignment.var_name.len, node->assignment.var_name.start);
-			print_ast(node->assignment.value, indent + 1);
+			printf("Assign: %.*s\n", (int)name.len, name.start);
+			print_ast(ast, node->rhs, indent + 1);
 			break;
 		case AST_RETURN:
 			printf("Return\n");
-			print_ast(node->return_stmt.expression, indent + 1);
+			print_ast(ast, node->lhs, indent + 1);
 			break;
 		case AST_IDENTIFIER:
-			printf("ID: %.*s\n", (int)node->identifier.name.len, node->identifier.name.start);
+			printf("ID: %.*s\n", (int)name.len, name.start);
 			break;
 		case AST_NUMBER:
-			printf("Int: %.*s\n", (int)node->number.value.len, node->number.value.start);
+			printf("Int: %lld\n", (long long)ast_number(node));
 			break;
 		case AST_ADD:	printf("Op: +\n"); break;
 		case AST_SUB:	printf("Op: -\n"); break;
 		case AST_MUL:	printf("Op: *\n"); break;
 		case AST_DIV:	printf("Op: /\n"); break;
 		case AST_CALL:
-			printf("Call: %.*s(", (int)node->call.function_name.len, node->call.function_name.start);
-			for (size_t i = 0; i < node->call.arg_count; i++)
+			printf("Call: %.*s(", (int)name.len, name.start);
+			children = ast_call_args(ast, id, &count);
+			for (size_t i = 0; i < count; i++)
 			{
 				if (i > 0) printf(", ");
 				printf("arg%zu", i);
 			}
 			printf(")\n");
-			for (size_t i = 0; i < node->call.arg_count; i++) {
-				print_ast(node->call.args[i], indent + 1);
+			for (size_t i = 0; i < count; i++) {
+				print_ast(ast, children[i], indent + 1);
 			}
 			break;
 		default:		printf("Unknown node\n"); break;
@@ -94,8 +167,8 @@ void print_ast(ASTNode *node, int indent)
 
 	if (node->type >= AST_ADD && node->type <= AST_DIV)
 	{
-		print_ast(node->binary.left, indent + 1);
-		print_ast(node->binary.right, indent + 1);
+		print_ast(ast, node->lhs, indent + 1);
+		print_ast(ast, node->rhs, indent + 1);
 	}
 }
 
@@ -8,9 +8,8 @@
 #include <stdlib.h>
 #include <unistd.h>
 
-#define MAX_SOURCE_FILE_SIZE (10 * 1024 * 1024)
-
-bool	validate_source_file(const char *filepath, FileValidation *out, ErrorContext *errors)
+bool	validate_source_file(const char *filepath, FileValidation *out,
+			size_t max_size, ErrorContext *errors)
 {
 	memset(out, 0, sizeof(*out));
 	bool	valid = true;
@@ -52,7 +51,7 @@ bool	validate_source_file(const char *filepath, FileValidation *out, ErrorContex
 		return (false);
 	}
 	out->readable = true;
-	if (!validate_file_size(out->size, MAX_SOURCE_FILE_SIZE, filepath, errors))
+	if (!validate_file_size(out->size, max_size, filepath, errors))
 		valid = false;
 	if (!validate_file_extension(filepath, ".c"))
 	{
@@ -92,16 +91,16 @@ bool	validate_file_size(size_t size, size_t max_size, const char *filepath,
 }
 
 bool	validate_identifier(const char *name, size_t len, ErrorContext *errors,
-			const char *filename, int line)
+			FileMap *file, uint32_t offset)
 {
 	if (len == 0)
 	{
-		error_semantic(errors, filename, line, 0, "empty identifier");
+		error_semantic(errors, file, offset, "empty identifier");
 		return (false);
 	}
 	if (!isalpha(name[0]) && name[0] != '_')
 	{
-		error_semantic(errors, filename, line, 0,
+		error_semantic(errors, file, offset,
 				"identifiers must start with letter or underscore");
 		return (false);
 	}
@@ -110,7 +109,7 @@ bool	validate_identifier(const char *name, size_t len, ErrorContext *errors,
 	{
 		if (!isalnum(name[i]) && name[i] != '_')
 		{
-			error_semantic(errors, filename, line, 0,
+			error_semantic(errors, file, offset,
 					"invalid character '%c' in identifier", name[i]);
 			return (false);
 		}
@@ -128,30 +127,30 @@ bool	validate_identifier(const char *name, size_t len, ErrorContext *errors,
 	{
 		if (strncmp(name, reserved[i], len) == 0 && reserved[i][len] == '\0')
 		{
-			error_semantic(errors, filename, line, 0,
+			error_semantic(errors, file, offset,
 					"'%.*s' is a reserved keyword", (int)len, name);
 			return (false);
 		}
 	}
 	if (len > 255)
 	{
-		error_semantic(errors, filename, line, 0,
+		error_semantic(errors, file, offset,
 				"identifier too long (max 255 characters)");
 		return (false);
 	}
 	return (true);
 }
 
-bool	validate_integer_literal(const char *text, size_t len, int64_t *out_value, ErrorContext *errors, const char *filename, int line)
+bool	validate_integer_literal(const char *text, size_t len, int64_t *out_value, ErrorContext *errors, FileMap *file, uint32_t offset)
 {
 	if (len == 0)
 	{
-		error_lexer(errors, filename, line, 0, "empty number literal");
+		error_lexer(errors, file, offset, "empty number literal");
 		return (false);
 	}
 	if (len > 1 && text[0] == '0' && isdigit(text[1]))
 	{
-		error_lexer(errors, filename, line, 0,
+		error_lexer(errors, file, offset,
 				"octal literals not supported (leading zero)");
 		return (false);
 	}
@@ -160,13 +159,13 @@ bool	validate_integer_literal(const char *text, size_t len, int64_t *out_value,
 	long long	value = strtoll(text, &endptr, 10);
 	if (errno == ERANGE)
 	{
-		error_lexer(errors, filename, line, 0,
+		error_lexer(errors, file, offset,
 				"integer literal out of range: %.*s", (int)len, text);
 		return (false);
 	}
 	if (endptr != text + len)
 	{
-		error_lexer(errors, filename, line, 0,
+		error_lexer(errors, file, offset,
 				"invalid integer literal: %.*s", (int)len, text);
 		return (false);
 	}
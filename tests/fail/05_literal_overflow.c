@@ -0,0 +1,3 @@
+int main() {
+	return 99999999999999999999;	// ERROR: integer literal is too large
+}
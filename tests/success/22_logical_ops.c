@@ -0,0 +1,34 @@
+int main() {
+	int zero = 0;
+	int five = 5;
+
+	// 1. Results are always 0 or 1
+	int a = five && 7;			// 1
+	int b = five && zero;		// 0
+	int c = zero || five;		// 1
+	int d = zero || zero;		// 0
+
+	// 2. Short-circuit: the division by zero must never run
+	int e = (zero != 0) && (10 / zero > 1);		// 0
+	int f = (five == 5) || (10 / zero > 1);		// 1
+
+	// 3. && binds tighter than ||
+	// Should be: 1 || (0 && 0) => 1
+	// If wrong:  (1 || 0) && 0 => 0
+	int g = 1 || zero && zero;
+
+	// 4. Compound assignment
+	int h = 3;
+	h += 4;			// 7
+	h *= 6;			// 42
+	h -= 2;			// 40
+	h /= 5;			// 8
+	h <<= 2;		// 32
+	h >>= 1;		// 16
+	h |= 3;			// 19
+	h &= 14;		// 2
+	h ^= 7;			// 5
+
+	// Sum: 1 + 0 + 1 + 0 + 0 + 1 + 1 + 5 = 9
+	return a + b + c + d + e + f + g + h;
+}
@@ -0,0 +1,8 @@
+int main() {
+	int a = (2 + 3) * 4 - 6 / 2;		// 17
+	int b = -(1 << 4) + ~0;				// -17
+	int c = (7 > 3) + (2 == 2) + !0;	// 3
+	int d = (0u - 1u) >> 28;			// 15, unsigned arithmetic wraps
+	
+	return a + b + c + d;  // 18
+}
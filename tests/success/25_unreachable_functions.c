@@ -0,0 +1,21 @@
+int never_called(int a) {
+	// { a brace in a comment must not end the body early }
+	return never_called(a - 1) * 2;
+}
+
+int twice(int a) {
+	/* } */
+	return a * 2;
+}
+
+int add_twice(int a, int b) {
+	return twice(a) + twice(b);
+}
+
+int also_never_called() {
+	return add_twice(1, 2);
+}
+
+int main() {
+	return add_twice(3, 4);  // 14, compiles 3 of 5 bodies, parsing only those under --lazy
+}
@@ -0,0 +1,163 @@
+// More variables in one scope than the 128 the scope table used to hold
+int main() {
+	int v0 = 0;
+	int v1 = 1;
+	int v2 = 2;
+	int v3 = 3;
+	int v4 = 4;
+	int v5 = 5;
+	int v6 = 6;
+	int v7 = 7;
+	int v8 = 8;
+	int v9 = 9;
+	int v10 = 0;
+	int v11 = 1;
+	int v12 = 2;
+	int v13 = 3;
+	int v14 = 4;
+	int v15 = 5;
+	int v16 = 6;
+	int v17 = 7;
+	int v18 = 8;
+	int v19 = 9;
+	int v20 = 0;
+	int v21 = 1;
+	int v22 = 2;
+	int v23 = 3;
+	int v24 = 4;
+	int v25 = 5;
+	int v26 = 6;
+	int v27 = 7;
+	int v28 = 8;
+	int v29 = 9;
+	int v30 = 0;
+	int v31 = 1;
+	int v32 = 2;
+	int v33 = 3;
+	int v34 = 4;
+	int v35 = 5;
+	int v36 = 6;
+	int v37 = 7;
+	int v38 = 8;
+	int v39 = 9;
+	int v40 = 0;
+	int v41 = 1;
+	int v42 = 2;
+	int v43 = 3;
+	int v44 = 4;
+	int v45 = 5;
+	int v46 = 6;
+	int v47 = 7;
+	int v48 = 8;
+	int v49 = 9;
+	int v50 = 0;
+	int v51 = 1;
+	int v52 = 2;
+	int v53 = 3;
+	int v54 = 4;
+	int v55 = 5;
+	int v56 = 6;
+	int v57 = 7;
+	int v58 = 8;
+	int v59 = 9;
+	int v60 = 0;
+	int v61 = 1;
+	int v62 = 2;
+	int v63 = 3;
+	int v64 = 4;
+	int v65 = 5;
+	int v66 = 6;
+	int v67 = 7;
+	int v68 = 8;
+	int v69 = 9;
+	int v70 = 0;
+	int v71 = 1;
+	int v72 = 2;
+	int v73 = 3;
+	int v74 = 4;
+	int v75 = 5;
+	int v76 = 6;
+	int v77 = 7;
+	int v78 = 8;
+	int v79 = 9;
+	int v80 = 0;
+	int v81 = 1;
+	int v82 = 2;
+	int v83 = 3;
+	int v84 = 4;
+	int v85 = 5;
+	int v86 = 6;
+	int v87 = 7;
+	int v88 = 8;
+	int v89 = 9;
+	int v90 = 0;
+	int v91 = 1;
+	int v92 = 2;
+	int v93 = 3;
+	int v94 = 4;
+	int v95 = 5;
+	int v96 = 6;
+	int v97 = 7;
+	int v98 = 8;
+	int v99 = 9;
+	int v100 = 0;
+	int v101 = 1;
+	int v102 = 2;
+	int v103 = 3;
+	int v104 = 4;
+	int v105 = 5;
+	int v106 = 6;
+	int v107 = 7;
+	int v108 = 8;
+	int v109 = 9;
+	int v110 = 0;
+	int v111 = 1;
+	int v112 = 2;
+	int v113 = 3;
+	int v114 = 4;
+	int v115 = 5;
+	int v116 = 6;
+	int v117 = 7;
+	int v118 = 8;
+	int v119 = 9;
+	int v120 = 0;
+	int v121 = 1;
+	int v122 = 2;
+	int v123 = 3;
+	int v124 = 4;
+	int v125 = 5;
+	int v126 = 6;
+	int v127 = 7;
+	int v128 = 8;
+	int v129 = 9;
+	int v130 = 0;
+	int v131 = 1;
+	int v132 = 2;
+	int v133 = 3;
+	int v134 = 4;
+	int v135 = 5;
+	int v136 = 6;
+	int v137 = 7;
+	int v138 = 8;
+	int v139 = 9;
+	int v140 = 0;
+	int v141 = 1;
+	int v142 = 2;
+	int v143 = 3;
+	int v144 = 4;
+	int v145 = 5;
+	int v146 = 6;
+	int v147 = 7;
+	int v148 = 8;
+	int v149 = 9;
+	{
+		int v7 = 100;
+		v0 = v7;
+	}
+	{
+		int v0 = 5;
+		v1 = v0;
+	}
+	// v0 = 100, v1 = 5, v7 = 7, v149 = 9: 121
+	return v0 + v1 + v7 + v149;
+}
@@ -0,0 +1,305 @@
+// More functions than the 256 the global function table used to hold
+int f0(int x) { return x + 1; }
+int f1(int x) { return f0(x) + 1; }
+int f2(int x) { return f1(x) + 1; }
+int f3(int x) { return f2(x) + 1; }
+int f4(int x) { return f3(x) + 1; }
+int f5(int x) { return f4(x) + 1; }
+int f6(int x) { return f5(x) + 1; }
+int f7(int x) { return f6(x) + 1; }
+int f8(int x) { return f7(x) + 1; }
+int f9(int x) { return f8(x) + 1; }
+int f10(int x) { return f9(x) + 1; }
+int f11(int x) { return f10(x) + 1; }
+int f12(int x) { return f11(x) + 1; }
+int f13(int x) { return f12(x) + 1; }
+int f14(int x) { return f13(x) + 1; }
+int f15(int x) { return f14(x) + 1; }
+int f16(int x) { return f15(x) + 1; }
+int f17(int x) { return f16(x) + 1; }
+int f18(int x) { return f17(x) + 1; }
+int f19(int x) { return f18(x) + 1; }
+int f20(int x) { return f19(x) + 1; }
+int f21(int x) { return f20(x) + 1; }
+int f22(int x) { return f21(x) + 1; }
+int f23(int x) { return f22(x) + 1; }
+int f24(int x) { return f23(x) + 1; }
+int f25(int x) { return f24(x) + 1; }
+int f26(int x) { return f25(x) + 1; }
+int f27(int x) { return f26(x) + 1; }
+int f28(int x) { return f27(x) + 1; }
+int f29(int x) { return f28(x) + 1; }
+int f30(int x) { return f29(x) + 1; }
+int f31(int x) { return f30(x) + 1; }
+int f32(int x) { return f31(x) + 1; }
+int f33(int x) { return f32(x) + 1; }
+int f34(int x) { return f33(x) + 1; }
+int f35(int x) { return f34(x) + 1; }
+int f36(int x) { return f35(x) + 1; }
+int f37(int x) { return f36(x) + 1; }
+int f38(int x) { return f37(x) + 1; }
+int f39(int x) { return f38(x) + 1; }
+int f40(int x) { return f39(x) + 1; }
+int f41(int x) { return f40(x) + 1; }
+int f42(int x) { return f41(x) + 1; }
+int f43(int x) { return f42(x) + 1; }
+int f44(int x) { return f43(x) + 1; }
+int f45(int x) { return f44(x) + 1; }
+int f46(int x) { return f45(x) + 1; }
+int f47(int x) { return f46(x) + 1; }
+int f48(int x) { return f47(x) + 1; }
+int f49(int x) { return f48(x) + 1; }
+int f50(int x) { return f49(x) + 1; }
+int f51(int x) { return f50(x) + 1; }
+int f52(int x) { return f51(x) + 1; }
+int f53(int x) { return f52(x) + 1; }
+int f54(int x) { return f53(x) + 1; }
+int f55(int x) { return f54(x) + 1; }
+int f56(int x) { return f55(x) + 1; }
+int f57(int x) { return f56(x) + 1; }
+int f58(int x) { return f57(x) + 1; }
+int f59(int x) { return f58(x) + 1; }
+int f60(int x) { return f59(x) + 1; }
+int f61(int x) { return f60(x) + 1; }
+int f62(int x) { return f61(x) + 1; }
+int f63(int x) { return f62(x) + 1; }
+int f64(int x) { return f63(x) + 1; }
+int f65(int x) { return f64(x) + 1; }
+int f66(int x) { return f65(x) + 1; }
+int f67(int x) { return f66(x) + 1; }
+int f68(int x) { return f67(x) + 1; }
+int f69(int x) { return f68(x) + 1; }
+int f70(int x) { return f69(x) + 1; }
+int f71(int x) { return f70(x) + 1; }
+int f72(int x) { return f71(x) + 1; }
+int f73(int x) { return f72(x) + 1; }
+int f74(int x) { return f73(x) + 1; }
+int f75(int x) { return f74(x) + 1; }
+int f76(int x) { return f75(x) + 1; }
+int f77(int x) { return f76(x) + 1; }
+int f78(int x) { return f77(x) + 1; }
+int f79(int x) { return f78(x) + 1; }
+int f80(int x) { return f79(x) + 1; }
+int f81(int x) { return f80(x) + 1; }
+int f82(int x) { return f81(x) + 1; }
+int f83(int x) { return f82(x) + 1; }
+int f84(int x) { return f83(x) + 1; }
+int f85(int x) { return f84(x) + 1; }
+int f86(int x) { return f85(x) + 1; }
+int f87(int x) { return f86(x) + 1; }
+int f88(int x) { return f87(x) + 1; }
+int f89(int x) { return f88(x) + 1; }
+int f90(int x) { return f89(x) + 1; }
+int f91(int x) { return f90(x) + 1; }
+int f92(int x) { return f91(x) + 1; }
+int f93(int x) { return f92(x) + 1; }
+int f94(int x) { return f93(x) + 1; }
+int f95(int x) { return f94(x) + 1; }
+int f96(int x) { return f95(x) + 1; }
+int f97(int x) { return f96(x) + 1; }
+int f98(int x) { return f97(x) + 1; }
+int f99(int x) { return f98(x) + 1; }
+int f100(int x) { return f99(x) + 1; }
+int f101(int x) { return f100(x) + 1; }
+int f102(int x) { return f101(x) + 1; }
+int f103(int x) { return f102(x) + 1; }
+int f104(int x) { return f103(x) + 1; }
+int f105(int x) { return f104(x) + 1; }
+int f106(int x) { return f105(x) + 1; }
+int f107(int x) { return f106(x) + 1; }
+int f108(int x) { return f107(x) + 1; }
+int f109(int x) { return f108(x) + 1; }
+int f110(int x) { return f109(x) + 1; }
+int f111(int x) { return f110(x) + 1; }
+int f112(int x) { return f111(x) + 1; }
+int f113(int x) { return f112(x) + 1; }
+int f114(int x) { return f113(x) + 1; }
+int f115(int x) { return f114(x) + 1; }
+int f116(int x) { return f115(x) + 1; }
+int f117(int x) { return f116(x) + 1; }
+int f118(int x) { return f117(x) + 1; }
+int f119(int x) { return f118(x) + 1; }
+int f120(int x) { return f119(x) + 1; }
+int f121(int x) { return f120(x) + 1; }
+int f122(int x) { return f121(x) + 1; }
+int f123(int x) { return f122(x) + 1; }
+int f124(int x) { return f123(x) + 1; }
+int f125(int x) { return f124(x) + 1; }
+int f126(int x) { return f125(x) + 1; }
+int f127(int x) { return f126(x) + 1; }
+int f128(int x) { return f127(x) + 1; }
+int f129(int x) { return f128(x) + 1; }
+int f130(int x) { return f129(x) + 1; }
+int f131(int x) { return f130(x) + 1; }
+int f132(int x) { return f131(x) + 1; }
+int f133(int x) { return f132(x) + 1; }
+int f134(int x) { return f133(x) + 1; }
+int f135(int x) { return f134(x) + 1; }
+int f136(int x) { return f135(x) + 1; }
+int f137(int x) { return f136(x) + 1; }
+int f138(int x) { return f137(x) + 1; }
+int f139(int x) { return f138(x) + 1; }
+int f140(int x) { return f139(x) + 1; }
+int f141(int x) { return f140(x) + 1; }
+int f142(int x) { return f141(x) + 1; }
+int f143(int x) { return f142(x) + 1; }
+int f144(int x) { return f143(x) + 1; }
+int f145(int x) { return f144(x) + 1; }
+int f146(int x) { return f145(x) + 1; }
+int f147(int x) { return f146(x) + 1; }
+int f148(int x) { return f147(x) + 1; }
+int f149(int x) { return f148(x) + 1; }
+int f150(int x) { return f149(x) + 1; }
+int f151(int x) { return f150(x) + 1; }
+int f152(int x) { return f151(x) + 1; }
+int f153(int x) { return f152(x) + 1; }
+int f154(int x) { return f153(x) + 1; }
+int f155(int x) { return f154(x) + 1; }
+int f156(int x) { return f155(x) + 1; }
+int f157(int x) { return f156(x) + 1; }
+int f158(int x) { return f157(x) + 1; }
+int f159(int x) { return f158(x) + 1; }
+int f160(int x) { return f159(x) + 1; }
+int f161(int x) { return f160(x) + 1; }
+int f162(int x) { return f161(x) + 1; }
+int f163(int x) { return f162(x) + 1; }
+int f164(int x) { return f163(x) + 1; }
+int f165(int x) { return f164(x) + 1; }
+int f166(int x) { return f165(x) + 1; }
+int f167(int x) { return f166(x) + 1; }
+int f168(int x) { return f167(x) + 1; }
+int f169(int x) { return f168(x) + 1; }
+int f170(int x) { return f169(x) + 1; }
+int f171(int x) { return f170(x) + 1; }
+int f172(int x) { return f171(x) + 1; }
+int f173(int x) { return f172(x) + 1; }
+int f174(int x) { return f173(x) + 1; }
+int f175(int x) { return f174(x) + 1; }
+int f176(int x) { return f175(x) + 1; }
+int f177(int x) { return f176(x) + 1; }
+int f178(int x) { return f177(x) + 1; }
+int f179(int x) { return f178(x) + 1; }
+int f180(int x) { return f179(x) + 1; }
+int f181(int x) { return f180(x) + 1; }
+int f182(int x) { return f181(x) + 1; }
+int f183(int x) { return f182(x) + 1; }
+int f184(int x) { return f183(x) + 1; }
+int f185(int x) { return f184(x) + 1; }
+int f186(int x) { return f185(x) + 1; }
+int f187(int x) { return f186(x) + 1; }
+int f188(int x) { return f187(x) + 1; }
+int f189(int x) { return f188(x) + 1; }
+int f190(int x) { return f189(x) + 1; }
+int f191(int x) { return f190(x) + 1; }
+int f192(int x) { return f191(x) + 1; }
+int f193(int x) { return f192(x) + 1; }
+int f194(int x) { return f193(x) + 1; }
+int f195(int x) { return f194(x) + 1; }
+int f196(int x) { return f195(x) + 1; }
+int f197(int x) { return f196(x) + 1; }
+int f198(int x) { return f197(x) + 1; }
+int f199(int x) { return f198(x) + 1; }
+int f200(int x) { return f199(x) + 1; }
+int f201(int x) { return f200(x) + 1; }
+int f202(int x) { return f201(x) + 1; }
+int f203(int x) { return f202(x) + 1; }
+int f204(int x) { return f203(x) + 1; }
+int f205(int x) { return f204(x) + 1; }
+int f206(int x) { return f205(x) + 1; }
+int f207(int x) { return f206(x) + 1; }
+int f208(int x) { return f207(x) + 1; }
+int f209(int x) { return f208(x) + 1; }
+int f210(int x) { return f209(x) + 1; }
+int f211(int x) { return f210(x) + 1; }
+int f212(int x) { return f211(x) + 1; }
+int f213(int x) { return f212(x) + 1; }
+int f214(int x) { return f213(x) + 1; }
+int f215(int x) { return f214(x) + 1; }
+int f216(int x) { return f215(x) + 1; }
+int f217(int x) { return f216(x) + 1; }
+int f218(int x) { return f217(x) + 1; }
+int f219(int x) { return f218(x) + 1; }
+int f220(int x) { return f219(x) + 1; }
+int f221(int x) { return f220(x) + 1; }
+int f222(int x) { return f221(x) + 1; }
+int f223(int x) { return f222(x) + 1; }
+int f224(int x) { return f223(x) + 1; }
+int f225(int x) { return f224(x) + 1; }
+int f226(int x) { return f225(x) + 1; }
+int f227(int x) { return f226(x) + 1; }
+int f228(int x) { return f227(x) + 1; }
+int f229(int x) { return f228(x) + 1; }
+int f230(int x) { return f229(x) + 1; }
+int f231(int x) { return f230(x) + 1; }
+int f232(int x) { return f231(x) + 1; }
+int f233(int x) { return f232(x) + 1; }
+int f234(int x) { return f233(x) + 1; }
+int f235(int x) { return f234(x) + 1; }
+int f236(int x) { return f235(x) + 1; }
+int f237(int x) { return f236(x) + 1; }
+int f238(int x) { return f237(x) + 1; }
+int f239(int x) { return f238(x) + 1; }
+int f240(int x) { return f239(x) + 1; }
+int f241(int x) { return f240(x) + 1; }
+int f242(int x) { return f241(x) + 1; }
+int f243(int x) { return f242(x) + 1; }
+int f244(int x) { return f243(x) + 1; }
+int f245(int x) { return f244(x) + 1; }
+int f246(int x) { return f245(x) + 1; }
+int f247(int x) { return f246(x) + 1; }
+int f248(int x) { return f247(x) + 1; }
+int f249(int x) { return f248(x) + 1; }
+int f250(int x) { return f249(x) + 1; }
+int f251(int x) { return f250(x) + 1; }
+int f252(int x) { return f251(x) + 1; }
+int f253(int x) { return f252(x) + 1; }
+int f254(int x) { return f253(x) + 1; }
+int f255(int x) { return f254(x) + 1; }
+int f256(int x) { return f255(x) + 1; }
+int f257(int x) { return f256(x) + 1; }
+int f258(int x) { return f257(x) + 1; }
+int f259(int x) { return f258(x) + 1; }
+int f260(int x) { return f259(x) + 1; }
+int f261(int x) { return f260(x) + 1; }
+int f262(int x) { return f261(x) + 1; }
+int f263(int x) { return f262(x) + 1; }
+int f264(int x) { return f263(x) + 1; }
+int f265(int x) { return f264(x) + 1; }
+int f266(int x) { return f265(x) + 1; }
+int f267(int x) { return f266(x) + 1; }
+int f268(int x) { return f267(x) + 1; }
+int f269(int x) { return f268(x) + 1; }
+int f270(int x) { return f269(x) + 1; }
+int f271(int x) { return f270(x) + 1; }
+int f272(int x) { return f271(x) + 1; }
+int f273(int x) { return f272(x) + 1; }
+int f274(int x) { return f273(x) + 1; }
+int f275(int x) { return f274(x) + 1; }
+int f276(int x) { return f275(x) + 1; }
+int f277(int x) { return f276(x) + 1; }
+int f278(int x) { return f277(x) + 1; }
+int f279(int x) { return f278(x) + 1; }
+int f280(int x) { return f279(x) + 1; }
+int f281(int x) { return f280(x) + 1; }
+int f282(int x) { return f281(x) + 1; }
+int f283(int x) { return f282(x) + 1; }
+int f284(int x) { return f283(x) + 1; }
+int f285(int x) { return f284(x) + 1; }
+int f286(int x) { return f285(x) + 1; }
+int f287(int x) { return f286(x) + 1; }
+int f288(int x) { return f287(x) + 1; }
+int f289(int x) { return f288(x) + 1; }
+int f290(int x) { return f289(x) + 1; }
+int f291(int x) { return f290(x) + 1; }
+int f292(int x) { return f291(x) + 1; }
+int f293(int x) { return f292(x) + 1; }
+int f294(int x) { return f293(x) + 1; }
+int f295(int x) { return f294(x) + 1; }
+int f296(int x) { return f295(x) + 1; }
+int f297(int x) { return f296(x) + 1; }
+int f298(int x) { return f297(x) + 1; }
+int f299(int x) { return f298(x) + 1; }
+
+int main() {
+	return f299(0) - 200;
+}
@@ -0,0 +1,29 @@
+int square(int x) {
+	return x * x;
+}
+
+int halve(int x) {
+	return x / 2;
+}
+
+int countdown(int n) {
+	while (n > 0) {
+		n = n - 1;
+	}
+	return n;
+}
+
+int main() {
+	int a = 3;
+	int sum = 0;
+	int i = 0;
+
+	square(a);			// unused, removed
+	countdown(5);		// unused, but kept: it loops
+	int b = square(a) + square(a);	// reuses the first call, 18
+	while (i < 4) {
+		sum = sum + square(a + 1) + halve(a);	// both hoisted, 17 per pass
+		i = i + 1;
+	}
+	return b + sum;  // 86
+}
@@ -0,0 +1,25 @@
+// Unsigned arithmetic wraps the same folded and at run time
+uint32 sub(uint32 a, uint32 b) { return (a - b) >> 28; }
+uint32 add(uint32 a, uint32 b) { return (a + b) >> 1; }
+uint32 mul(uint32 a, uint32 b) { return (a * b) >> 16; }
+uint32 shl(uint32 a, uint32 b) { return (a << b) >> 24; }
+uint32 neg(uint32 a) { return -a >> 28; }
+uint32 bnot(uint32 a) { return ~a / 16; }
+
+int main() {
+	int fails = 0;
+
+	if (sub(0u, 1u) != (0u - 1u) >> 28)						// 15
+		fails = fails + 1;
+	if (add(4294967295u, 3u) != (4294967295u + 3u) >> 1)	// 1
+		fails = fails + 1;
+	if (mul(65536u, 65537u) != (65536u * 65537u) >> 16)		// 1
+		fails = fails + 1;
+	if (shl(255u, 28u) != (255u << 28u) >> 24)				// 240
+		fails = fails + 1;
+	if (neg(1u) != -1u >> 28)								// 15
+		fails = fails + 1;
+	if (bnot(0u) != ~0u / 16u)								// 268435455
+		fails = fails + 1;
+	return fails;	// 0
+}